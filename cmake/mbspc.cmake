@@ -2,6 +2,7 @@
 # mbspc
 
 find_package(Math)
+find_package(Threads REQUIRED)
 
 add_executable(mbspc
 	${PROJECT_SOURCE_DIR}/tools/mbspc/botlib/be_aas_bspq3.c
@@ -64,7 +65,7 @@ add_executable(mbspc
 	${PROJECT_SOURCE_DIR}/tools/mbspc/qcommon/md4.c
 	${PROJECT_SOURCE_DIR}/tools/mbspc/qcommon/unzip.c
 )
-target_link_libraries(mbspc PRIVATE $<TARGET_NAME_IF_EXISTS:Math::Math>)
+target_link_libraries(mbspc PRIVATE $<TARGET_NAME_IF_EXISTS:Math::Math> Threads::Threads)
 target_include_directories(mbspc PRIVATE
 	${PROJECT_SOURCE_DIR}/libs
 	${PROJECT_SOURCE_DIR}/tools/mbspc
@@ -10,6 +10,7 @@ add_executable(q3map2
 	${PROJECT_SOURCE_DIR}/tools/quake3/common/polylib.cpp
 	${PROJECT_SOURCE_DIR}/tools/quake3/common/scriplib.cpp
 	${PROJECT_SOURCE_DIR}/tools/quake3/common/threads.cpp
+	${PROJECT_SOURCE_DIR}/tools/quake3/common/profile.cpp
 	${PROJECT_SOURCE_DIR}/tools/quake3/common/unzip.cpp
 	${PROJECT_SOURCE_DIR}/tools/quake3/common/vfs.cpp
 	${PROJECT_SOURCE_DIR}/tools/quake3/common/miniz.cpp
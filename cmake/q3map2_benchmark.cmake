@@ -0,0 +1,38 @@
+set(Q3MAP2_BENCHMARK_THREADS "1;4" CACHE STRING "Thread counts to run each q3map2 benchmark map with")
+set(Q3MAP2_BENCHMARK_THRESHOLD 10 CACHE STRING "Allowed slowdown/memory growth against the baseline, in percent")
+set(Q3MAP2_BENCHMARK_SLACK 50 CACHE STRING "Allowed slowdown against the baseline on top of the threshold, in milliseconds")
+set(Q3MAP2_BENCHMARK_LIGHT_ARGS "-fast;-samples;2" CACHE STRING "Arguments for the -light stage of the q3map2 benchmarks")
+set(Q3MAP2_BENCHMARK_MAPS "" CACHE STRING "Extra .map files to benchmark besides regression_tests/q3map2")
+set(Q3MAP2_BENCHMARK_BASELINE_DIR ${CMAKE_BINARY_DIR}/q3map2_benchmark/baseline CACHE PATH "Where q3map2 benchmark time and memory baselines are recorded")
+
+file(GLOB Q3MAP2_REGRESSION_MAPS ${PROJECT_SOURCE_DIR}/regression_tests/q3map2/*/maps/*.map)
+
+enable_testing()
+
+foreach(map ${Q3MAP2_REGRESSION_MAPS} ${Q3MAP2_BENCHMARK_MAPS})
+	get_filename_component(name ${map} NAME_WE)
+	# golden lump checksums of the regression maps are committed next to them
+	if(map IN_LIST Q3MAP2_REGRESSION_MAPS)
+		get_filename_component(mapDir ${map} DIRECTORY)
+		get_filename_component(golden ${mapDir}/../${name}.lumps.cmake ABSOLUTE)
+	else()
+		set(golden ${Q3MAP2_BENCHMARK_BASELINE_DIR}/${name}.lumps.cmake)
+	endif()
+	foreach(threads ${Q3MAP2_BENCHMARK_THREADS})
+		add_test(NAME q3map2/${name}/t${threads}
+			COMMAND ${CMAKE_COMMAND}
+				-DQ3MAP2=$<TARGET_FILE:q3map2>
+				-DMAP=${map}
+				-DTHREADS=${threads}
+				-DTHRESHOLD=${Q3MAP2_BENCHMARK_THRESHOLD}
+				-DSLACK=${Q3MAP2_BENCHMARK_SLACK}
+				"-DLIGHT_ARGS=${Q3MAP2_BENCHMARK_LIGHT_ARGS}"
+				-DWORK_DIR=${CMAKE_BINARY_DIR}/q3map2_benchmark/${name}.t${threads}
+				-DGOLDEN=${golden}
+				-DBASELINE=${Q3MAP2_BENCHMARK_BASELINE_DIR}/${name}.t${threads}.cmake
+				-P ${PROJECT_SOURCE_DIR}/regression_tests/q3map2/benchmark.cmake
+		)
+		# timings are only comparable without other tests competing for cores
+		set_tests_properties(q3map2/${name}/t${threads} PROPERTIES LABELS "q3map2;benchmark" RUN_SERIAL TRUE)
+	endforeach()
+endforeach()
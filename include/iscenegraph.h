@@ -56,6 +56,7 @@ const TypeId INSTANCETYPEID_MAX = 64;
 const TypeId INSTANCETYPEID_NONE = INSTANCETYPEID_MAX;
 
 class Layer;
+class AABB;
 
 namespace scene
 {
@@ -84,6 +85,13 @@ public:
 		}
 	};
 
+	class BoundsTest
+	{
+	public:
+		/// \brief Returns false if nothing inside the world-space box 'aabb' is of interest to a culled traversal.
+		virtual bool test( const AABB& aabb ) const = 0;
+	};
+
 	/// \brief Returns the root-node of the graph.
 	virtual Node& root() = 0;
 	/// \brief Sets the root-node of the graph to be 'node'.
@@ -96,6 +104,9 @@ public:
 	virtual void traverse( const Walker& walker ) = 0;
 	/// \brief Traverses all nodes in the graph depth-first, starting from 'start'.
 	virtual void traverse_subgraph( const Walker& walker, const Path& start ) = 0;
+	/// \brief Traverses the graph like traverse(), but skips every instance whose world bounds fail 'test', together with its subgraph.
+	/// Skipped instances are not passed to 'walker' at all. Uses a spatial index of the instance bounds.
+	virtual void traverse_culled( const Walker& walker, const BoundsTest& test ) = 0;
 	/// \brief Returns the instance at the location identified by 'path', or 0 if it does not exist.
 	virtual scene::Instance* find( const Path& path ) = 0;
 
@@ -109,6 +120,8 @@ public:
 	/// \brief Invokes all bounds-changed callbacks. Called when the bounds of any instance in the scene change.
 	/// \todo Move to a separate class.
 	virtual void boundsChanged() = 0;
+	/// \brief Called when the world bounds of 'instance' may have changed.
+	virtual void instanceBoundsChanged( Instance& instance ) = 0;
 	/// \brief Add a \p callback to be invoked when the bounds of any instance in the scene change.
 	virtual SignalHandlerId addBoundsChangedCallback( const SignalHandler& boundsChanged ) = 0;
 	/// \brief Remove a \p callback to be invoked when the bounds of any instance in the scene change.
@@ -147,6 +147,8 @@ public:
 	virtual IShader* getShaderForName( const char* name ) = 0;
 
 	virtual void foreachShaderName( const ShaderNameCallback& callback ) = 0;
+// calls \p callback with the name of the texture image shader \p name is shown with, without activating the shader
+	virtual void getShaderTextureName( const char* name, const ShaderNameCallback& callback ) = 0;
 
 // iterate over the list of active shaders
 	virtual void beginActiveShadersIterator() = 0;
@@ -32,6 +32,8 @@ class UndoMemento
 {
 public:
 	virtual void release() = 0;
+	/// \brief Returns the approximate memory held by the memento in bytes, for the undo memory limit.
+	virtual std::size_t size() const = 0;
 };
 
 class Undoable
@@ -0,0 +1,380 @@
+/*
+   This file is part of GtkRadiant.
+
+   GtkRadiant is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   GtkRadiant is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GtkRadiant; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#pragma once
+
+#include "math/aabb.h"
+#include "debugging/debugging.h"
+#include <vector>
+#include <algorithm>
+#include <iterator>
+
+/// \brief A dynamic bounding volume hierarchy of AABBs, each carrying a \p Value.
+///
+/// - Leaves store their box enlarged by a margin, so small movements do not restructure the tree.
+/// - Insertion picks the sibling with the least surface area increase, rotations keep the tree height balanced.
+/// - Querying is O(log n + k) for k overlapping leaves.
+/// - Proxies stay valid until erased.
+template<typename Value>
+class AABBTree
+{
+public:
+	typedef int Proxy;
+	static constexpr Proxy null_proxy = -1;
+
+private:
+	struct Node
+	{
+		AABB aabb;
+		Proxy parent; // next free node, while on the free list
+		Proxy child1;
+		Proxy child2;
+		int height; // 0 for leaves
+		Value value;
+
+		bool isLeaf() const {
+			return child1 == null_proxy;
+		}
+	};
+
+	std::vector<Node> m_nodes;
+	Proxy m_root = null_proxy;
+	Proxy m_free = null_proxy;
+	std::size_t m_size = 0;
+	float m_margin;
+
+	static AABB combined( const AABB& a, const AABB& b ){
+		Vector3 mins, maxs;
+		for ( std::size_t i = 0; i < 3; ++i )
+		{
+			mins[i] = std::min( a.origin[i] - a.extents[i], b.origin[i] - b.extents[i] );
+			maxs[i] = std::max( a.origin[i] + a.extents[i], b.origin[i] + b.extents[i] );
+		}
+		return aabb_for_minmax( mins, maxs );
+	}
+	static float area( const AABB& aabb ){
+		return aabb.extents[0] * aabb.extents[1] + aabb.extents[1] * aabb.extents[2] + aabb.extents[2] * aabb.extents[0];
+	}
+	static bool contains( const AABB& aabb, const AABB& other ){
+		for ( std::size_t i = 0; i < 3; ++i )
+		{
+			if ( std::fabs( other.origin[i] - aabb.origin[i] ) + other.extents[i] > aabb.extents[i] ) {
+				return false;
+			}
+		}
+		return true;
+	}
+	/// \brief True if the fattened \p aabb has grown well beyond \p other, e.g. after a brush was made smaller.
+	bool tooFat( const AABB& aabb, const AABB& other ) const {
+		for ( std::size_t i = 0; i < 3; ++i )
+		{
+			if ( aabb.extents[i] > other.extents[i] + 4 * m_margin ) {
+				return true;
+			}
+		}
+		return false;
+	}
+	AABB fattened( const AABB& aabb ) const {
+		return AABB( aabb.origin, Vector3( aabb.extents[0] + m_margin, aabb.extents[1] + m_margin, aabb.extents[2] + m_margin ) );
+	}
+
+	Proxy allocate(){
+		Proxy proxy;
+		if ( m_free != null_proxy ) {
+			proxy = m_free;
+			m_free = m_nodes[proxy].parent;
+		}
+		else
+		{
+			proxy = static_cast<Proxy>( m_nodes.size() );
+			m_nodes.emplace_back();
+		}
+		Node& node = m_nodes[proxy];
+		node.parent = node.child1 = node.child2 = null_proxy;
+		node.height = 0;
+		return proxy;
+	}
+	void release( Proxy proxy ){
+		Node& node = m_nodes[proxy];
+		node.parent = m_free;
+		node.height = -1;
+		node.value = Value();
+		m_free = proxy;
+	}
+
+	void replaceChild( Proxy parent, Proxy child, Proxy replacement ){
+		if ( parent == null_proxy ) {
+			m_root = replacement;
+		}
+		else if ( m_nodes[parent].child1 == child ) {
+			m_nodes[parent].child1 = replacement;
+		}
+		else
+		{
+			m_nodes[parent].child2 = replacement;
+		}
+	}
+	void refit( Proxy proxy ){
+		while ( proxy != null_proxy )
+		{
+			proxy = balance( proxy );
+			Node& node = m_nodes[proxy];
+			const Node& child1 = m_nodes[node.child1];
+			const Node& child2 = m_nodes[node.child2];
+			node.height = 1 + std::max( child1.height, child2.height );
+			node.aabb = combined( child1.aabb, child2.aabb );
+			proxy = node.parent;
+		}
+	}
+
+	void insertLeaf( Proxy leaf ){
+		if ( m_root == null_proxy ) {
+			m_root = leaf;
+			m_nodes[leaf].parent = null_proxy;
+			return;
+		}
+
+		// find the cheapest sibling
+		const AABB leafAABB = m_nodes[leaf].aabb;
+		Proxy index = m_root;
+		while ( !m_nodes[index].isLeaf() )
+		{
+			const Node& node = m_nodes[index];
+			const float nodeArea = area( node.aabb );
+			const float combinedArea = area( combined( node.aabb, leafAABB ) );
+
+			// cost of making a new parent for this node and the leaf
+			const float cost = 2 * combinedArea;
+			// minimum cost of pushing the leaf further down the tree
+			const float inheritanceCost = 2 * ( combinedArea - nodeArea );
+
+			const auto descendCost = [&]( const Node& child ){
+				const float childArea = area( combined( leafAABB, child.aabb ) );
+				return child.isLeaf()
+				       ? childArea + inheritanceCost
+				       : childArea - area( child.aabb ) + inheritanceCost;
+			};
+			const float cost1 = descendCost( m_nodes[node.child1] );
+			const float cost2 = descendCost( m_nodes[node.child2] );
+
+			if ( cost < cost1 && cost < cost2 ) {
+				break;
+			}
+			index = ( cost1 < cost2 ) ? node.child1 : node.child2;
+		}
+
+		const Proxy sibling = index;
+		const Proxy newParent = allocate();
+		const Proxy oldParent = m_nodes[sibling].parent;
+		Node& parent = m_nodes[newParent];
+		parent.parent = oldParent;
+		parent.aabb = combined( leafAABB, m_nodes[sibling].aabb );
+		parent.height = m_nodes[sibling].height + 1;
+		parent.child1 = sibling;
+		parent.child2 = leaf;
+		replaceChild( oldParent, sibling, newParent );
+		m_nodes[sibling].parent = newParent;
+		m_nodes[leaf].parent = newParent;
+
+		refit( m_nodes[leaf].parent );
+	}
+	void removeLeaf( Proxy leaf ){
+		if ( leaf == m_root ) {
+			m_root = null_proxy;
+			return;
+		}
+
+		const Proxy parent = m_nodes[leaf].parent;
+		const Proxy grandParent = m_nodes[parent].parent;
+		const Proxy sibling = ( m_nodes[parent].child1 == leaf ) ? m_nodes[parent].child2 : m_nodes[parent].child1;
+
+		replaceChild( grandParent, parent, sibling );
+		m_nodes[sibling].parent = grandParent;
+		release( parent );
+
+		refit( grandParent );
+	}
+
+	/// \brief Performs a left or right rotation if node \p iA is imbalanced. Returns the new root of the subtree.
+	Proxy balance( Proxy iA ){
+		Node* A = &m_nodes[iA];
+		if ( A->isLeaf() || A->height < 2 ) {
+			return iA;
+		}
+
+		const Proxy iB = A->child1;
+		const Proxy iC = A->child2;
+		Node* B = &m_nodes[iB];
+		Node* C = &m_nodes[iC];
+
+		const int imbalance = C->height - B->height;
+
+		// rotate C up
+		if ( imbalance > 1 ) {
+			const Proxy iF = C->child1;
+			const Proxy iG = C->child2;
+			Node* F = &m_nodes[iF];
+			Node* G = &m_nodes[iG];
+
+			C->child1 = iA;
+			C->parent = A->parent;
+			A->parent = iC;
+			replaceChild( C->parent, iA, iC );
+
+			if ( F->height > G->height ) {
+				C->child2 = iF;
+				A->child2 = iG;
+				G->parent = iA;
+				A->aabb = combined( B->aabb, G->aabb );
+				C->aabb = combined( A->aabb, F->aabb );
+				A->height = 1 + std::max( B->height, G->height );
+				C->height = 1 + std::max( A->height, F->height );
+			}
+			else
+			{
+				C->child2 = iG;
+				A->child2 = iF;
+				F->parent = iA;
+				A->aabb = combined( B->aabb, F->aabb );
+				C->aabb = combined( A->aabb, G->aabb );
+				A->height = 1 + std::max( B->height, F->height );
+				C->height = 1 + std::max( A->height, G->height );
+			}
+			return iC;
+		}
+
+		// rotate B up
+		if ( imbalance < -1 ) {
+			const Proxy iD = B->child1;
+			const Proxy iE = B->child2;
+			Node* D = &m_nodes[iD];
+			Node* E = &m_nodes[iE];
+
+			B->child1 = iA;
+			B->parent = A->parent;
+			A->parent = iB;
+			replaceChild( B->parent, iA, iB );
+
+			if ( D->height > E->height ) {
+				B->child2 = iD;
+				A->child1 = iE;
+				E->parent = iA;
+				A->aabb = combined( C->aabb, E->aabb );
+				B->aabb = combined( A->aabb, D->aabb );
+				A->height = 1 + std::max( C->height, E->height );
+				B->height = 1 + std::max( A->height, D->height );
+			}
+			else
+			{
+				B->child2 = iE;
+				A->child1 = iD;
+				D->parent = iA;
+				A->aabb = combined( C->aabb, D->aabb );
+				B->aabb = combined( A->aabb, E->aabb );
+				A->height = 1 + std::max( C->height, D->height );
+				B->height = 1 + std::max( A->height, E->height );
+			}
+			return iB;
+		}
+
+		return iA;
+	}
+
+public:
+	/// \param margin: How far each leaf box is enlarged on every side.
+	explicit AABBTree( float margin = 8 ) : m_margin( margin ){
+	}
+
+	bool empty() const {
+		return m_size == 0;
+	}
+	std::size_t size() const {
+		return m_size;
+	}
+
+	/// \brief Inserts a leaf for \p aabb, which must be valid and finite.
+	Proxy insert( const AABB& aabb, const Value& value ){
+		ASSERT_MESSAGE( aabb_valid( aabb ), "AABBTree::insert: invalid aabb" );
+		const Proxy proxy = allocate();
+		m_nodes[proxy].aabb = fattened( aabb );
+		m_nodes[proxy].value = value;
+		insertLeaf( proxy );
+		++m_size;
+		return proxy;
+	}
+	void erase( Proxy proxy ){
+		ASSERT_MESSAGE( m_nodes[proxy].isLeaf(), "AABBTree::erase: not a leaf" );
+		removeLeaf( proxy );
+		release( proxy );
+		--m_size;
+	}
+	/// \brief Moves the leaf \p proxy to \p aabb. The tree is only restructured if \p aabb left the leaf's enlarged box.
+	void update( Proxy proxy, const AABB& aabb ){
+		ASSERT_MESSAGE( aabb_valid( aabb ), "AABBTree::update: invalid aabb" );
+		Node& node = m_nodes[proxy];
+		if ( contains( node.aabb, aabb ) && !tooFat( node.aabb, aabb ) ) {
+			return;
+		}
+		removeLeaf( proxy );
+		m_nodes[proxy].aabb = fattened( aabb );
+		insertLeaf( proxy );
+	}
+
+	const Value& value( Proxy proxy ) const {
+		return m_nodes[proxy].value;
+	}
+	/// \brief Returns the enlarged box stored for leaf \p proxy.
+	const AABB& aabb( Proxy proxy ) const {
+		return m_nodes[proxy].aabb;
+	}
+
+	/// \brief Calls \p functor with the value of each leaf for which \p test returns true.
+	/// \p test is also called on inner nodes, it must return true for every box containing a box it accepts.
+	template<typename Test, typename Functor>
+	void query( const Test& test, const Functor& functor ) const {
+		if ( m_root != null_proxy ) {
+			query( m_root, test, functor );
+		}
+	}
+
+private:
+	template<typename Test, typename Functor>
+	void query( Proxy root, const Test& test, const Functor& functor ) const {
+		Proxy stack[256];
+		std::size_t count = 0;
+		stack[count++] = root;
+		while ( count != 0 )
+		{
+			const Node& node = m_nodes[stack[--count]];
+			if ( test( node.aabb ) ) {
+				if ( node.isLeaf() ) {
+					functor( node.value );
+				}
+				else if ( count + 2 <= std::size( stack ) ) {
+					stack[count++] = node.child2;
+					stack[count++] = node.child1;
+				}
+				else // deeper than the stack, only if the tree is badly unbalanced
+				{
+					query( node.child1, test, functor );
+					query( node.child2, test, functor );
+				}
+			}
+		}
+	}
+};
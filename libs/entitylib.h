@@ -380,6 +380,18 @@ public:
 	typedef MemberCaller<KeyValue, void(const CopiedString&), &KeyValue::importState> UndoImportCaller;
 };
 
+/// \brief Counts the list nodes, key values and value strings of an undo state of EntityKeyValues.
+/// Key values may be shared with other states, so this is an upper bound.
+template<typename Key>
+inline std::size_t undo_heap_size( const UnsortedMap<Key, SmartPointer<KeyValue>>& keyValues ){
+	std::size_t size = 0;
+	for ( const auto& [ key, value ] : keyValues )
+	{
+		size += 2 * sizeof( void* ) + sizeof( std::pair<Key, SmartPointer<KeyValue>> ) + sizeof( KeyValue ) + string_length( value->c_str() ) + 1;
+	}
+	return size;
+}
+
 /// \brief An unsorted list of key/value pairs.
 ///
 /// - Notifies observers when a pair is inserted or removed.
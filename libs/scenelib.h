@@ -663,6 +663,7 @@ public:
 		m_boundsChanged = true;
 		m_childBoundsChanged = true;
 		m_transformChangedCallback();
+		GlobalSceneGraph().instanceBoundsChanged( *this );
 	}
 	void transformChanged(){
 		GlobalSceneGraph().traverse_subgraph( TransformChangedWalker(), m_path );
@@ -684,6 +685,7 @@ public:
 	void boundsChanged(){
 		m_boundsChanged = true;
 		m_childBoundsChanged = true;
+		GlobalSceneGraph().instanceBoundsChanged( *this );
 		if ( m_parent != 0 ) {
 			m_parent->boundsChanged();
 		}
@@ -165,6 +165,10 @@ public:
 		std::swap( m_children, other.m_children );
 		std::swap( m_observer, other.m_observer );
 	}
+	/// \brief Counts the list nodes of the children held by an undo state.
+	friend std::size_t undo_heap_size( const TraversableNodeSet& set ){
+		return std::distance( set.m_children.begin(), set.m_children.end() ) * ( 2 * sizeof( void* ) + sizeof( NodeSmartReference ) );
+	}
 
 	void attach( Observer* observer ){
 		ASSERT_MESSAGE( m_observer == 0, "TraversableNodeSet::attach: observer cannot be attached" );
@@ -24,6 +24,17 @@
 #include "iundo.h"
 #include "mapfile.h"
 #include "generic/callback.h"
+#include "string/string.h"
+
+/// \brief Returns the heap memory owned by an undo state, which is not part of its sizeof.
+/// Overload it for states owning heap data, so that the undo memory limit accounts for them.
+template<typename Copyable>
+inline std::size_t undo_heap_size( const Copyable& ){
+	return 0;
+}
+inline std::size_t undo_heap_size( const CopiedString& string ){
+	return string_length( string.c_str() ) + 1;
+}
 
 template<typename Copyable>
 class BasicUndoMemento final : public UndoMemento
@@ -37,6 +48,9 @@ public:
 	void release() override {
 		delete this;
 	}
+	std::size_t size() const override {
+		return sizeof( *this ) + undo_heap_size( m_data );
+	}
 
 	const Copyable& get() const {
 		return m_data;
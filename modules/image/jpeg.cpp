@@ -250,7 +250,7 @@ static void jpeg_buffer_src( j_decompress_ptr cinfo, void* buffer, int bufsize )
 
 // =============================================================================
 
-static char errormsg[JMSG_LENGTH_MAX];
+static thread_local char errormsg[JMSG_LENGTH_MAX];
 
 typedef struct my_jpeg_error_mgr
 {
@@ -743,8 +743,8 @@ BlendFunc evaluateBlendFunc( const BlendFuncExpression& blendFunc, const ShaderP
 	return BlendFunc( BLEND_ONE, BLEND_ZERO );
 }
 
-qtexture_t* evaluateTexture( const TextureExpression& texture, const ShaderParameters& params, const ShaderArguments& args, const LoadImageCallback& loader = GlobalTexturesCache().defaultLoader() ){
-	StringOutputStream result( 64 );
+/// \brief Writes \p texture with the shader parameters replaced by their arguments to \p result.
+void evaluateTextureName( StringOutputStream& result, const TextureExpression& texture, const ShaderParameters& params, const ShaderArguments& args ){
 	const char* expression = texture.c_str();
 	const char* end = expression + string_length( expression );
 	if ( !string_empty( expression ) ) {
@@ -775,6 +775,11 @@ qtexture_t* evaluateTexture( const TextureExpression& texture, const ShaderParam
 		}
 		result << expression;
 	}
+}
+
+qtexture_t* evaluateTexture( const TextureExpression& texture, const ShaderParameters& params, const ShaderArguments& args, const LoadImageCallback& loader = GlobalTexturesCache().defaultLoader() ){
+	StringOutputStream result( 64 );
+	evaluateTextureName( result, texture, params, args );
 	return GlobalTexturesCache().capture( loader, result );
 }
 
@@ -1843,6 +1848,25 @@ public:
 		}
 	}
 
+	void getShaderTextureName( const char* name, const ShaderNameCallback& callback ) override {
+		const auto i = g_shaderDefinitions.find( name );
+		if ( i == g_shaderDefinitions.end() ) {
+			// a default shader would be created
+			if ( g_enableDefaultShaders ) {
+				callback( name );
+			}
+		}
+		else
+		{
+			const ShaderDefinition& definition = i->second;
+			StringOutputStream result( 64 );
+			evaluateTextureName( result, definition.shaderTemplate->m_textureName, definition.shaderTemplate->m_params, definition.args );
+			if ( !string_empty( result ) ) {
+				callback( result );
+			}
+		}
+	}
+
 	void beginActiveShadersIterator() override {
 		ActiveShaders_IteratorBegin();
 	}
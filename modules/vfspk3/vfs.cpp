@@ -60,6 +60,7 @@ ArchiveModules& FileSystemQ3API_getArchiveModules();
 #include "filematch.h"
 #include <list>
 #include <filesystem>
+#include <mutex>
 
 
 
@@ -82,6 +83,9 @@ static constexpr bool g_bUsePak = true;
 
 ModuleObservers g_observers;
 
+// archives seek a shared stream to open a file, textures are opened from decode threads too
+static std::mutex g_openFileMutex;
+
 using StrList = std::vector<CopiedString>;
 
 // =============================================================================
@@ -333,6 +337,7 @@ int GetFileCount( const char *filename, int flag ){
 
 ArchiveFile* OpenFile( const char* filename ){
 	ASSERT_MESSAGE( strchr( filename, '\\' ) == 0, "path contains invalid separator '\\': " << Quoted( filename ) );
+	const std::lock_guard lock( g_openFileMutex );
 	for ( archive_entry_t& arch : g_archives )
 	{
 		ArchiveFile* file = arch.archive->openFile( filename );
@@ -346,6 +351,7 @@ ArchiveFile* OpenFile( const char* filename ){
 
 ArchiveTextFile* OpenTextFile( const char* filename ){
 	ASSERT_MESSAGE( strchr( filename, '\\' ) == 0, "path contains invalid separator '\\': " << Quoted( filename ) );
+	const std::lock_guard lock( g_openFileMutex );
 	for ( archive_entry_t& arch : g_archives )
 	{
 		ArchiveTextFile* file = arch.archive->openTextFile( filename );
@@ -25,6 +25,7 @@
 #include "os/path.h"
 #include "commandlib.h"
 #include "stream/stringstream.h"
+#include "stream/textfilestream.h"
 #include "gtkutil/messagebox.h"
 #include "scenelib.h"
 #include "mapfile.h"
@@ -33,6 +34,10 @@
 #include "mainframe.h"
 #include "qe3.h"
 #include "preferences.h"
+#include "timer.h"
+
+#include <atomic>
+#include <thread>
 
 
 #if defined( WIN32 )
@@ -48,6 +53,88 @@ bool DoesFileExist( const char* name, std::size_t& size ){
 	return false;
 }
 
+/// \brief Writes autosaves on a worker thread.
+/// The map is serialized into memory on the main thread, so the worker never touches the scene;
+/// the scene nodes are live and not copyable, so formatting stays here and its time is reported with each write.
+/// The file is written next to its target and renamed over it, so an interrupted write keeps the previous autosave.
+class AutosaveWriter
+{
+	std::thread m_thread;
+	std::atomic<bool> m_done = true;
+	bool m_success = false;
+	int m_formatMsec = 0;
+	StringOutputStream m_data;
+	CopiedString m_filename;
+
+	void write(){
+		const auto temporary = StringStream( m_filename, ".tmp" );
+		const std::size_t size = m_data.cend() - m_data.cbegin();
+		{
+			TextFileOutputStream file( temporary );
+			m_success = !file.failed() && file.write( m_data.c_str(), size ) == size;
+		}
+		m_success = m_success && file_move( temporary, m_filename.c_str() );
+		if ( !m_success ) {
+			file_remove( temporary );
+		}
+		m_done = true;
+	}
+public:
+	~AutosaveWriter(){
+		if ( m_thread.joinable() ) {
+			m_thread.join();
+		}
+	}
+	/// \brief Reports a finished write, must be called on the main thread.
+	void collect(){
+		if ( m_thread.joinable() && m_done ) {
+			wait();
+		}
+	}
+	/// \brief Waits for the write in progress and reports it.
+	void wait(){
+		if ( m_thread.joinable() ) {
+			m_thread.join();
+			if ( m_success ) {
+				globalOutputStream() << "Autosaved " << m_filename << ", " << ( ( m_data.cend() - m_data.cbegin() ) >> 10 ) << " KB formatted in " << m_formatMsec << " msec\n";
+			}
+			else{
+				globalErrorStream() << "Autosave to " << Quoted( m_filename ) << " failed\n";
+			}
+			m_data = StringOutputStream();
+		}
+	}
+	/// \brief Captures the map and starts writing it to \p filename.
+	/// \return The size of the captured map or 0 if the previous autosave is still being written.
+	std::size_t save( const char* filename ){
+		collect();
+		if ( !m_done ) {
+			globalOutputStream() << "Autosave skipped, the previous one is still being written\n";
+			return 0;
+		}
+		Timer timer;
+		Map_ExportFile( m_data, filename );
+		m_formatMsec = timer.elapsed_msec();
+		m_filename = filename;
+		m_done = false;
+		m_thread = std::thread( &AutosaveWriter::write, this );
+		return m_data.cend() - m_data.cbegin();
+	}
+};
+
+AutosaveWriter g_autosaveWriter;
+
+/// \brief Next free snapshot slot and total size of the snapshots of a map,
+/// so the snapshots directory is only scanned on the first snapshot of each map.
+struct SnapshotIndex
+{
+	CopiedString m_mapname;
+	int m_count = 0;
+	std::size_t m_size = 0;
+};
+
+SnapshotIndex g_snapshotIndex;
+
 void Map_Snapshot(){
 	// we need to do the following
 	// 1. make sure the snapshot directory exists (create it if it doesn't)
@@ -57,26 +144,34 @@ void Map_Snapshot(){
 	const auto snapshotsDir = StringStream( PathFilenameless( mapname ), "snapshots" );
 
 	if ( file_exists( snapshotsDir ) || Q_mkdir( snapshotsDir ) ) {
-		std::size_t lSize = 0;
 		const auto strNewPath = StringStream( snapshotsDir, '/', path_get_filename_start( mapname ) );
 		const char* ext = path_get_filename_base_end( strNewPath );
 
+		SnapshotIndex& index = g_snapshotIndex;
+		if ( !string_equal( index.m_mapname.c_str(), mapname ) ) {
+			index = SnapshotIndex{ mapname };
+		}
+
 		StringOutputStream snapshotFilename( 256 );
-		for ( int nCount = 0; ; ++nCount )
+		for ( ; ; ++index.m_count )
 		{
 			// The original map's filename is "<path>/<name>.<ext>"
 			// The snapshot's filename will be "<path>/snapshots/<name>.<count>.<ext>"
-			snapshotFilename( StringRange( strNewPath.c_str(), ext ), '.', nCount, ext );
+			snapshotFilename( StringRange( strNewPath.c_str(), ext ), '.', index.m_count, ext );
 
-			if ( !DoesFileExist( snapshotFilename, lSize ) ) {
+			if ( !DoesFileExist( snapshotFilename, index.m_size ) ) {
 				break;
 			}
 		}
 
-		// save in the next available slot
-		Map_SaveFile( snapshotFilename );
+		// save in the next available slot, snapshots before compiling must not be skipped
+		g_autosaveWriter.wait();
+		if ( const std::size_t size = g_autosaveWriter.save( snapshotFilename ) ) {
+			++index.m_count;
+			index.m_size += size;
+		}
 
-		if ( lSize > 50 * 1024 * 1024 ) { // total size of saves > 50 mb
+		if ( index.m_size > 50 * 1024 * 1024 ) { // total size of saves > 50 mb
 			globalOutputStream() << "The snapshot files in " << snapshotsDir << " total more than 50 megabytes. You might consider cleaning up.";
 		}
 	}
@@ -114,6 +209,8 @@ scene::Node& Map_Node(){
 }
 
 void QE_CheckAutoSave(){
+	g_autosaveWriter.collect();
+
 	if ( !Map_Valid( g_map ) || !ScreenUpdates_Enabled() ) {
 		return;
 	}
@@ -144,14 +241,14 @@ void QE_CheckAutoSave(){
 					auto autosave = StringStream( g_qeglobals.m_userGamePath, "maps/" );
 					Q_mkdir( autosave );
 					autosave << "autosave" << getMapExtension();
-					Map_SaveFile( autosave );
+					g_autosaveWriter.save( autosave );
 				}
 				else
 				{
 					const char* name = Map_Name( g_map );
 					const char* extension = path_get_filename_base_end( name );
 					const auto autosave = StringStream( StringRange( name, extension ), ".autosave", extension );
-					Map_SaveFile( autosave );
+					g_autosaveWriter.save( autosave );
 				}
 			}
 		}
@@ -190,4 +287,5 @@ void Autosave_Construct(){
 }
 
 void Autosave_Destroy(){
+	g_autosaveWriter.wait();
 }
@@ -62,6 +62,9 @@
 #include "winding.h"
 #include "brush_primit.h"
 
+#include <cstring>
+#include <memory>
+
 const unsigned int BRUSH_DETAIL_FLAG = 27;
 const unsigned int BRUSH_DETAIL_MASK = ( 1 << BRUSH_DETAIL_FLAG );
 
@@ -890,25 +893,59 @@ class Face final :
 {
 	std::size_t m_refcount;
 
-	class SavedState final : public UndoMemento
+	/// \brief The saved texture and shader of a face.
+	/// Shared by the saved states of the face while they don't change, so moving brushes only stores new planes.
+	class SavedSurface
 	{
 	public:
-		FacePlane::SavedState m_planeState;
 		FaceTexdef::SavedState m_texdefState;
 		FaceShader::SavedState m_shaderState;
 
-		SavedState( const Face& face ) : m_planeState( face.getPlane() ), m_texdefState( face.getTexdef() ), m_shaderState( face.getShader() ){
+		SavedSurface( const Face& face ) : m_texdefState( face.getTexdef() ), m_shaderState( face.getShader() ){
+		}
+
+		bool equal( const Face& face ) const {
+			return std::memcmp( &m_texdefState.m_projection, &face.getTexdef().m_projection, sizeof( TextureProjection ) ) == 0
+			    && m_shaderState.m_flags.m_surfaceFlags == face.getShader().m_flags.m_surfaceFlags
+			    && m_shaderState.m_flags.m_contentFlags == face.getShader().m_flags.m_contentFlags
+			    && m_shaderState.m_flags.m_value == face.getShader().m_flags.m_value
+			    && m_shaderState.m_flags.m_specified == face.getShader().m_flags.m_specified
+			    && string_equal( m_shaderState.m_shader.c_str(), face.getShader().getShader() );
+		}
+		std::size_t size() const {
+			return sizeof( *this ) + string_length( m_shaderState.m_shader.c_str() ) + 1;
+		}
+	};
+
+	class SavedState final : public UndoMemento
+	{
+	public:
+		FacePlane::SavedState m_planeState;
+		std::shared_ptr<const SavedSurface> m_surface;
+		bool m_sharedSurface;
+
+		SavedState( const Face& face ) : m_planeState( face.getPlane() ){
+			m_surface = face.m_savedSurface.lock();
+			m_sharedSurface = m_surface && m_surface->equal( face );
+			if ( !m_sharedSurface ) {
+				m_surface.reset( new SavedSurface( face ) );
+				face.m_savedSurface = m_surface;
+			}
 		}
 
 		void exportState( Face& face ) const {
 			m_planeState.exportState( face.getPlane() );
-			m_shaderState.exportState( face.getShader() );
-			m_texdefState.exportState( face.getTexdef() );
+			m_surface->m_shaderState.exportState( face.getShader() );
+			m_surface->m_texdefState.exportState( face.getTexdef() );
 		}
 
 		void release() override {
 			delete this;
 		}
+		std::size_t size() const override {
+			// shared surfaces are counted by the state that saved them first
+			return m_sharedSurface? sizeof( *this ) : sizeof( *this ) + m_surface->size();
+		}
 	};
 
 public:
@@ -932,6 +969,7 @@ private:
 	FaceObserver* m_observer;
 	UndoObserver* m_undoable_observer;
 	MapFile* m_map;
+	mutable std::weak_ptr<const SavedSurface> m_savedSurface; ///< last saved texture and shader, reused while unchanged
 
 public:
 
@@ -1938,6 +1976,9 @@ public:
 		void release() override {
 			delete this;
 		}
+		std::size_t size() const override {
+			return sizeof( *this ) + sizeof( FaceSmartPointer ) * m_faces.capacity();
+		}
 
 		Faces m_faces;
 	};
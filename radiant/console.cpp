@@ -22,6 +22,9 @@
 #include "console.h"
 
 #include <ctime>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include "gtkutil/accelerator.h"
 #include "gtkutil/messagebox.h"
@@ -142,7 +145,7 @@ public:
 
 //#pragma GCC pop_options
 
-std::size_t Sys_Print( int level, const char* buf, std::size_t length ){
+static std::size_t Sys_PrintMainThread( int level, const char* buf, std::size_t length ){
 	const bool contains_newline = std::find( buf, buf + length, '\n' ) != buf + length;
 
 	if ( level == SYS_ERR ) {
@@ -215,6 +218,29 @@ std::size_t Sys_Print( int level, const char* buf, std::size_t length ){
 }
 
 
+// the console is only written by the main thread, messages of other threads wait for its next message
+static const std::thread::id g_mainThread = std::this_thread::get_id();
+static std::mutex g_threadMessagesMutex;
+static std::vector<std::pair<int, CopiedString>> g_threadMessages;
+
+std::size_t Sys_Print( int level, const char* buf, std::size_t length ){
+	if ( std::this_thread::get_id() != g_mainThread ) {
+		const std::lock_guard lock( g_threadMessagesMutex );
+		g_threadMessages.emplace_back( level, StringRange( buf, length ) );
+		return length;
+	}
+
+	std::vector<std::pair<int, CopiedString>> messages;
+	{
+		const std::lock_guard lock( g_threadMessagesMutex );
+		messages.swap( g_threadMessages );
+	}
+	for ( const auto& [ messageLevel, message ] : messages )
+		Sys_PrintMainThread( messageLevel, message.c_str(), string_length( message.c_str() ) );
+
+	return Sys_PrintMainThread( level, buf, length );
+}
+
 template<int level>
 class SysPrintStream : public TextOutputStream
 {
@@ -24,6 +24,7 @@
 #include "debugging/debugging.h"
 
 #include <list>
+#include <unordered_map>
 
 #include "map.h"
 #include "brushmanip.h"
@@ -543,7 +544,9 @@ brushsplit_t Brush_classifyPlane( const Brush& brush, const Plane3& plane ){
 }
 
 bool Brush_subtract( const Brush& brush, const Brush& other, const std::vector<const Face *>& otherfaces, brush_vector_t& ret_fragments ){
-	if ( aabb_intersects_aabb( brush.localAABB(), other.localAABB() ) ) {
+	if ( aabb_intersects_aabb( brush.localAABB(), other.localAABB() )
+	  // brush entirely in front of some face of other: skip copying it, clipping would find the same
+	  && std::ranges::none_of( otherfaces, [&brush]( const Face* face ){ return Brush_classifyPlane( brush, face->plane3() ).counts[ePlaneBack] == 0; } ) ) {
 		brush_vector_t fragments;
 		fragments.reserve( other.size() );
 		Brush back( brush );
@@ -571,9 +574,78 @@ bool Brush_subtract( const Brush& brush, const Brush& other, const std::vector<c
 	return false;
 }
 
+/// \brief Uniform XY grid over brush bounds, finds the brushes overlapping given bounds without testing them all.
+class BrushBroadphase
+{
+	static constexpr int c_maxBrushCells = 64; // brushes spanning more cells are tested against every query
+	std::vector<AABB> m_bounds;
+	std::vector<std::size_t> m_large;
+	std::unordered_map<std::uint64_t, std::vector<std::size_t>> m_cells;
+	double m_cellSize = 64;
+
+	struct CellRange{ std::int64_t mins[2], maxs[2]; };
+	CellRange cellRange( const AABB& aabb ) const {
+		CellRange range;
+		for( int i = 0; i < 2; ++i ){
+			range.mins[i] = std::floor( ( aabb.origin[i] - aabb.extents[i] ) / m_cellSize );
+			range.maxs[i] = std::floor( ( aabb.origin[i] + aabb.extents[i] ) / m_cellSize );
+		}
+		return range;
+	}
+	static std::int64_t cellCount( const CellRange& range ){
+		return ( range.maxs[0] - range.mins[0] + 1 ) * ( range.maxs[1] - range.mins[1] + 1 );
+	}
+	static std::uint64_t cellKey( std::int64_t x, std::int64_t y ){
+		return ( static_cast<std::uint64_t>( x ) << 32 ) ^ static_cast<std::uint32_t>( y );
+	}
+public:
+	explicit BrushBroadphase( const brush_vector_t& brushes ){
+		m_bounds.reserve( brushes.size() );
+		double size = 0;
+		for( const Brush* brush : brushes ){
+			const AABB& aabb = m_bounds.emplace_back( brush->localAABB() );
+			size += std::max( aabb.extents[0], aabb.extents[1] ) * 2;
+		}
+		if( !brushes.empty() )
+			m_cellSize = std::max( m_cellSize, size / brushes.size() );
+
+		for( std::size_t i = 0; i < m_bounds.size(); ++i ){
+			const CellRange range = cellRange( m_bounds[i] );
+			if( cellCount( range ) > c_maxBrushCells ){
+				m_large.push_back( i );
+				continue;
+			}
+			for( std::int64_t x = range.mins[0]; x <= range.maxs[0]; ++x )
+				for( std::int64_t y = range.mins[1]; y <= range.maxs[1]; ++y )
+					m_cells[cellKey( x, y )].push_back( i );
+		}
+	}
+	/// \brief Fills \p indices with ascending indices of the brushes, whose bounds intersect \p aabb.
+	void query( const AABB& aabb, std::vector<std::size_t>& indices ) const {
+		indices.clear();
+		const CellRange range = cellRange( aabb );
+		if( cellCount( range ) > static_cast<std::int64_t>( m_cells.size() ) ){ // cheaper to check all
+			for( std::size_t i = 0; i < m_bounds.size(); ++i )
+				indices.push_back( i );
+		}
+		else{
+			indices = m_large;
+			for( std::int64_t x = range.mins[0]; x <= range.maxs[0]; ++x )
+				for( std::int64_t y = range.mins[1]; y <= range.maxs[1]; ++y )
+					if( const auto cell = m_cells.find( cellKey( x, y ) ); cell != m_cells.cend() )
+						indices.insert( indices.end(), cell->second.cbegin(), cell->second.cend() );
+			std::ranges::sort( indices );
+			indices.erase( std::unique( indices.begin(), indices.end() ), indices.end() );
+		}
+		std::erase_if( indices, [&]( std::size_t i ){ return !aabb_intersects_aabb( aabb, m_bounds[i] ); } );
+	}
+};
+
 class SubtractBrushesFromUnselected : public scene::Graph::Walker
 {
 	const brush_vector_t& m_brushlist;
+	const BrushBroadphase m_broadphase;
+	mutable std::vector<std::size_t> m_candidates;
 	std::vector<std::vector<const Face *>> m_brushfaces; // m_brushfaces.size() == m_brushlist.size()
 	std::size_t& m_before;
 	std::size_t& m_after;
@@ -581,7 +653,7 @@ class SubtractBrushesFromUnselected : public scene::Graph::Walker
 	scene::Node* m_world = Map_FindWorldspawn( g_map );
 public:
 	SubtractBrushesFromUnselected( const brush_vector_t& brushlist, std::size_t& before, std::size_t& after )
-		: m_brushlist( brushlist ), m_before( before ), m_after( after )
+		: m_brushlist( brushlist ), m_broadphase( brushlist ), m_before( before ), m_after( after )
 	{
 		std::vector<ProjectionAxis> doneProjections;
 		doneProjections.reserve( 3 );
@@ -647,15 +719,13 @@ public:
 	void post( const scene::Path& path, scene::Instance& instance ) const override {
 		if ( Brush* thebrush = Node_getBrush( path.top() ) ) {
 			if ( path.top().get().visible() && !Instance_isSelected( instance )
-			  && std::ranges::any_of( m_brushlist, [thebrush]( const Brush *b ){
-					return aabb_intersects_aabb( thebrush->localAABB(), b->localAABB() );
-			} ) ) {
+			  && ( m_broadphase.query( thebrush->localAABB(), m_candidates ), !m_candidates.empty() ) ) {
 				brush_vector_t buffer[2];
 				bool swap = false;
 				auto *original = new Brush( *thebrush );
 				buffer[swap].push_back( original );
 
-				for ( size_t i = 0; i < m_brushlist.size(); ++i )
+				for ( const size_t i : m_candidates ) // fragments are inside of thebrush, others can't intersect them
 				{
 					for ( Brush *brush : buffer[swap] )
 					{
@@ -1640,6 +1640,10 @@ bool Map_SaveFile( const char* filename ){
 	return MapResource_saveFile( MapFormat_forFile( filename ), GlobalSceneGraph().root(), Map_Traverse, filename );
 }
 
+void Map_ExportFile( TextOutputStream& out, const char* filename ){
+	MapFormat_forFile( filename ).writeGraph( GlobalSceneGraph().root(), Map_Traverse, out );
+}
+
 //
 //===========
 //Map_SaveSelected
@@ -100,6 +100,8 @@ const float g_MinWorldCoord = -64 * 1024;
 
 void Map_LoadFile( const char* filename );
 bool Map_SaveFile( const char* filename );
+/// \brief Writes the whole map to \p out in the format for \p filename.
+void Map_ExportFile( class TextOutputStream& out, const char* filename );
 
 void Map_New();
 void Map_Free();
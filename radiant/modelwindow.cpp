@@ -122,6 +122,9 @@ public:
 	void boundsChanged() override {
 		ASSERT_MESSAGE( 0, "Reached unreachable: boundsChanged()" );
 	}
+	void instanceBoundsChanged( scene::Instance& instance ) override {
+		ASSERT_MESSAGE( 0, "Reached unreachable: instanceBoundsChanged()" );
+	}
 
 	void traverse( const Walker& walker ) override {
 		ASSERT_MESSAGE( 0, "Reached unreachable: traverse()" );
@@ -131,6 +134,10 @@ public:
 		ASSERT_MESSAGE( 0, "Reached unreachable: traverse_subgraph()" );
 	}
 
+	void traverse_culled( const Walker& walker, const BoundsTest& test ) override {
+		ASSERT_MESSAGE( 0, "Reached unreachable: traverse_culled()" );
+	}
+
 	scene::Instance* find( const scene::Path& path ) override {
 		ASSERT_MESSAGE( 0, "Reached unreachable: find()" );
 		return nullptr;
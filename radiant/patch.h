@@ -379,6 +379,9 @@ class Patch final :
 		void release() override {
 			delete this;
 		}
+		std::size_t size() const override {
+			return sizeof( *this ) + sizeof( PatchControl ) * m_ctrl.size() + string_length( m_shader.c_str() ) + 1;
+		}
 
 		std::size_t m_width, m_height;
 		CopiedString m_shader;
@@ -105,9 +105,20 @@ public:
 	}
 };
 
+class VolumeBoundsTest : public scene::Graph::BoundsTest
+{
+	const VolumeTest& m_volume;
+public:
+	VolumeBoundsTest( const VolumeTest& volume ) : m_volume( volume ){
+	}
+	bool test( const AABB& aabb ) const override {
+		return m_volume.TestAABB( aabb ) != c_volumeOutside;
+	}
+};
+
 template<typename Functor>
 inline void Scene_forEachVisible( scene::Graph& graph, const VolumeTest& volume, const Functor& functor ){
-	graph.traverse( ForEachVisible< CullingWalker<Functor> >( volume, CullingWalker<Functor>( volume, functor ) ) );
+	graph.traverse_culled( ForEachVisible< CullingWalker<Functor> >( volume, CullingWalker<Functor>( volume, functor ) ), VolumeBoundsTest( volume ) );
 }
 
 class RenderHighlighted
@@ -166,6 +177,6 @@ public:
 };
 
 inline void Scene_Render( Renderer& renderer, const VolumeTest& volume ){
-	GlobalSceneGraph().traverse( ForEachVisible<RenderHighlighted>( volume, RenderHighlighted( renderer, volume ) ) );
+	GlobalSceneGraph().traverse_culled( ForEachVisible<RenderHighlighted>( volume, RenderHighlighted( renderer, volume ) ), VolumeBoundsTest( volume ) );
 	GlobalShaderCache().forEachRenderable( RenderHighlighted::RenderCaller( RenderHighlighted( renderer, volume ) ) );
 }
@@ -54,6 +54,7 @@
 #include "camwindow.h"
 
 #include "files.h"
+#include "textures.h"
 
 
 
@@ -1963,6 +1964,14 @@ void OpenGLShader::construct( const char* name ){
 	default:
 		// construction from IShader
 		m_shader = QERApp_Shader_ForName( name );
+		// the texture browser may have loaded thumbnails only, of any image the shader references
+		for ( qtexture_t* texture : { m_shader->getTexture(), m_shader->getDiffuse(), m_shader->getBump(), m_shader->getSpecular(),
+		                              m_shader->lightFalloffImage(), m_shader->firstLayer() != 0 ? m_shader->firstLayer()->texture() : nullptr } )
+		{
+			if ( texture != 0 ) {
+				Textures_loadFullResolution( *texture );
+			}
+		}
 
 		if ( g_ShaderCache->lightingEnabled() && m_shader->getBump() != 0 && m_shader->getBump()->texture_number != 0 ) { // is a bump shader
 			state.m_state = RENDER_FILL | RENDER_CULLFACE | RENDER_TEXTURE | RENDER_DEPTHTEST | RENDER_DEPTHWRITE | RENDER_COLOURWRITE | RENDER_PROGRAM;
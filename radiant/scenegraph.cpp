@@ -24,6 +24,9 @@
 #include "debugging/debugging.h"
 
 #include <map>
+#include <unordered_map>
+#include <vector>
+#include <algorithm>
 
 #include "string/string.h"
 #include "signal/signal.h"
@@ -31,6 +34,7 @@
 #include "instancelib.h"
 #include "treemodel.h"
 #include "layers.h"
+#include "container/aabbtree.h"
 
 template<std::size_t SIZE>
 class TypeIdMap
@@ -53,11 +57,45 @@ public:
 	}
 };
 
+/// \brief Instances with bounds beyond this are kept out of the spatial index and never culled.
+const float c_spatialIndexMaxExtent = 1 << 20;
+
+inline bool aabb_spatially_indexable( const AABB& aabb ){
+	return aabb_valid( aabb )
+	    && aabb.extents[0] < c_spatialIndexMaxExtent
+	    && aabb.extents[1] < c_spatialIndexMaxExtent
+	    && aabb.extents[2] < c_spatialIndexMaxExtent;
+}
+
 class CompiledGraph final : public scene::Graph, public scene::Instantiable::Observer
 {
 	typedef std::map<PathConstReference, scene::Instance*> InstanceMap;
 
+	struct SpatialEntry;
+	typedef AABBTree<SpatialEntry*> ChildTree;
+	/// \brief World bounds of the child instances of one parent instance.
+	struct ChildIndex
+	{
+		ChildTree tree;
+		/// not yet evaluated, empty or huge bounds; always visited
+		std::vector<SpatialEntry*> unbounded;
+	};
+	struct SpatialEntry
+	{
+		InstanceMap::iterator instance;
+		ChildIndex* owner = 0; // index of the parent instance, 0 for the root
+		ChildTree::Proxy proxy = ChildTree::null_proxy;
+		std::size_t unbounded = 0; // position in owner->unbounded while proxy is null
+		const scene::Node* node = 0; // last node of the path, siblings are ordered by it in m_instances
+		bool dirty = true;
+	};
+	typedef std::unordered_map<scene::Instance*, SpatialEntry> SpatialEntries;
+	typedef std::unordered_map<scene::Instance*, ChildIndex> ChildIndices;
+
 	InstanceMap m_instances;
+	SpatialEntries m_spatialEntries;
+	ChildIndices m_childIndices;
+	std::vector<scene::Instance*> m_spatialDirty;
 	scene::Instantiable::Observer* m_observer;
 	Signal0 m_boundsChanged;
 	scene::Path m_rootpath;
@@ -119,6 +157,13 @@ public:
 	void boundsChanged() override {
 		m_boundsChanged();
 	}
+	void instanceBoundsChanged( scene::Instance& instance ) override {
+		SpatialEntries::iterator i = m_spatialEntries.find( &instance );
+		if ( i != m_spatialEntries.end() && !i->second.dirty && i->second.owner != 0 ) {
+			i->second.dirty = true;
+			m_spatialDirty.push_back( &instance );
+		}
+	}
 
 	void traverse( const Walker& walker ) override {
 		traverse_subgraph( walker, m_instances.begin() );
@@ -130,6 +175,13 @@ public:
 		}
 	}
 
+	void traverse_culled( const Walker& walker, const BoundsTest& test ) override {
+		if ( !m_instances.empty() ) {
+			spatial_update();
+			traverse_culled( walker, test, m_instances.begin() );
+		}
+	}
+
 	scene::Instance* find( const scene::Path& path ) override {
 		InstanceMap::iterator i = m_instances.find( PathConstReference( path ) );
 		if ( i == m_instances.end() ) {
@@ -139,13 +191,15 @@ public:
 	}
 
 	void insert( scene::Instance* instance ) override {
-		m_instances.insert( InstanceMap::value_type( PathConstReference( instance->path() ), instance ) );
+		const InstanceMap::iterator i = m_instances.insert( InstanceMap::value_type( PathConstReference( instance->path() ), instance ) ).first;
+		spatial_insert( instance, i );
 
 		m_observer->insert( instance );
 	}
 	void erase( scene::Instance* instance ) override {
 		m_observer->erase( instance );
 
+		spatial_erase( instance );
 		m_instances.erase( PathConstReference( instance->path() ) );
 	}
 
@@ -174,6 +228,103 @@ private:
 		walker.post( i->first, *i->second );
 	}
 
+	void traverse_culled( const Walker& walker, const BoundsTest& test, InstanceMap::iterator i ){
+		if ( pre( walker, i ) ) {
+			ChildIndices::iterator index = m_childIndices.find( i->second );
+			if ( index != m_childIndices.end() ) {
+				std::vector<const SpatialEntry*> children;
+				index->second.tree.query(
+				    [&test]( const AABB& aabb ){ return test.test( aabb ); },
+				    [&children]( const SpatialEntry* entry ){ children.push_back( entry ); }
+				);
+				children.insert( children.end(), index->second.unbounded.begin(), index->second.unbounded.end() );
+				// visit in the same order as traverse(); sibling paths only differ in their last node
+				std::sort( children.begin(), children.end(), []( const SpatialEntry* a, const SpatialEntry* b ){
+					return std::less<const scene::Node*>()( a->node, b->node );
+				} );
+				for ( const SpatialEntry* child : children )
+					traverse_culled( walker, test, child->instance );
+			}
+		}
+		post( walker, i );
+	}
+
+	void unbounded_insert( SpatialEntry& entry ){
+		entry.proxy = ChildTree::null_proxy;
+		entry.unbounded = entry.owner->unbounded.size();
+		entry.owner->unbounded.push_back( &entry );
+	}
+	void unbounded_erase( SpatialEntry& entry ){
+		std::vector<SpatialEntry*>& unbounded = entry.owner->unbounded;
+		unbounded[entry.unbounded] = unbounded.back();
+		unbounded[entry.unbounded]->unbounded = entry.unbounded;
+		unbounded.pop_back();
+	}
+	void spatial_insert( scene::Instance* instance, InstanceMap::iterator i ){
+		SpatialEntry& entry = m_spatialEntries[instance];
+		entry.instance = i;
+		entry.node = &instance->path().top().get();
+		if ( instance->parent() != 0 ) {
+			// bounds are evaluated lazily, the subgraph of the instance is not instantiated yet
+			entry.owner = &m_childIndices[instance->parent()];
+			unbounded_insert( entry );
+			m_spatialDirty.push_back( instance );
+		}
+	}
+	void spatial_erase( scene::Instance* instance ){
+		ASSERT_MESSAGE( m_childIndices.find( instance ) == m_childIndices.end(), "instance erased before its children" );
+		SpatialEntries::iterator i = m_spatialEntries.find( instance );
+		if ( i != m_spatialEntries.end() ) {
+			SpatialEntry& entry = i->second;
+			if ( entry.owner != 0 ) {
+				if ( entry.proxy != ChildTree::null_proxy ) {
+					entry.owner->tree.erase( entry.proxy );
+				}
+				else
+				{
+					unbounded_erase( entry );
+				}
+				if ( entry.owner->tree.empty() && entry.owner->unbounded.empty() ) {
+					m_childIndices.erase( instance->parent() );
+				}
+			}
+			m_spatialEntries.erase( i );
+		}
+	}
+	/// \brief Moves the instances whose bounds changed since the last culled traversal.
+	void spatial_update(){
+		while ( !m_spatialDirty.empty() )
+		{
+			std::vector<scene::Instance*> dirty;
+			dirty.swap( m_spatialDirty );
+			for ( scene::Instance* instance : dirty )
+			{
+				SpatialEntries::iterator i = m_spatialEntries.find( instance );
+				if ( i == m_spatialEntries.end() || !i->second.dirty ) {
+					continue; // erased since
+				}
+				SpatialEntry& entry = i->second;
+				entry.dirty = false;
+
+				const AABB& aabb = instance->worldAABB();
+				if ( aabb_spatially_indexable( aabb ) ) {
+					if ( entry.proxy == ChildTree::null_proxy ) {
+						unbounded_erase( entry );
+						entry.proxy = entry.owner->tree.insert( aabb, &entry );
+					}
+					else
+					{
+						entry.owner->tree.update( entry.proxy, aabb );
+					}
+				}
+				else if ( entry.proxy != ChildTree::null_proxy ) {
+					entry.owner->tree.erase( entry.proxy );
+					unbounded_insert( entry );
+				}
+			}
+		}
+	}
+
 	void traverse_subgraph( const Walker& walker, InstanceMap::iterator i ){
 		Stack<InstanceMap::iterator> stack;
 		if ( i != m_instances.end() ) {
@@ -28,6 +28,7 @@
 #include "iundo.h"
 
 #include <vector>
+#include <algorithm>
 
 #include "stream/stringstream.h"
 #include "signal/isignal.h"
@@ -93,6 +94,23 @@ public:
 	}
 };
 
+/// \brief Culls the instances which touch none of the selection aabbs, neither they nor their children can be selected by bounds.
+class TouchingBoundsTest : public scene::Graph::BoundsTest
+{
+	const AABB* m_aabbs;
+	Unsigned m_count;
+public:
+	TouchingBoundsTest( const AABB* aabbs, Unsigned count ) : m_aabbs( aabbs ), m_count( count ){
+	}
+	bool test( const AABB& aabb ) const override {
+		return std::any_of( m_aabbs, m_aabbs + m_count, [&aabb]( const AABB& box ){
+			return std::fabs( box.origin[0] - aabb.origin[0] ) <= box.extents[0] + aabb.extents[0]
+			    && std::fabs( box.origin[1] - aabb.origin[1] ) <= box.extents[1] + aabb.extents[1]
+			    && std::fabs( box.origin[2] - aabb.origin[2] ) <= box.extents[2] + aabb.extents[2];
+		} );
+	}
+};
+
 /**
    Selects all objects that intersect one of the bounding AABBs.
    The exact intersection-method is specified through TSelectionPolicy
@@ -167,7 +185,7 @@ public:
 			}
 
 			// select objects with bounds
-			GlobalSceneGraph().traverse( SelectByBounds<TSelectionPolicy>( aabbs, count ) );
+			GlobalSceneGraph().traverse_culled( SelectByBounds<TSelectionPolicy>( aabbs, count ), TouchingBoundsTest( aabbs, count ) );
 
 			SceneChangeNotify();
 			delete[] aabbs;
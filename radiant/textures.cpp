@@ -39,6 +39,22 @@
 #include "texmanip.h"
 #include "preferences.h"
 
+#include "ifilesystem.h"
+#include "iimage.h"
+#include "modulesystem.h"
+#include "os/file.h"
+#include "os/path.h"
+#include "stream/filestream.h"
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <zlib.h>
+
 
 
 enum ETexturesMode
@@ -150,20 +166,20 @@ void ResampleGamma( float fGamma ){
 int max_tex_size = 0;
 int g_Textures_mipLevel = 0;
 
-/// \brief This function does the actual processing of raw RGBA data into a GL texture.
-/// It will also resample to power-of-two dimensions, generate the mipmaps and adjust gamma.
-void LoadTextureRGBA( qtexture_t* q, unsigned char* pPixels, int nWidth, int nHeight ){
+/// \brief Updates the gamma table for the current gamma setting, must be called on the main thread.
+void Textures_updateGammaTable(){
 	static float fGamma = -1;
-	float total[3];
-	int nCount = nWidth * nHeight;
-
 	if ( fGamma != g_texture_globals.fGamma ) {
 		fGamma = g_texture_globals.fGamma;
 		ResampleGamma( fGamma );
 	}
+}
 
-	q->width = nWidth;
-	q->height = nHeight;
+/// \brief Applies the gamma table to raw RGBA data and returns its average colour.
+/// Does not touch GL, so it can run on a decode thread.
+Colour3 ResampleTextureGamma( unsigned char* pPixels, int nWidth, int nHeight ){
+	float total[3];
+	int nCount = nWidth * nHeight;
 
 	total[0] = total[1] = total[2] = 0;
 
@@ -178,11 +194,18 @@ void LoadTextureRGBA( qtexture_t* q, unsigned char* pPixels, int nWidth, int nHe
 		}
 	}
 
-	q->color[0] = total[0] / ( nCount * 255 );
-	q->color[1] = total[1] / ( nCount * 255 );
-	q->color[2] = total[2] / ( nCount * 255 );
+	return Colour3( total[0] / ( nCount * 255 ), total[1] / ( nCount * 255 ), total[2] / ( nCount * 255 ) );
+}
+
+/// \brief Uploads gamma corrected RGBA data to the GL texture of \p q, which is created if \p q has none yet.
+/// Must be called on the main thread.
+void UploadTextureRGBA( qtexture_t* q, unsigned char* pPixels, int nWidth, int nHeight, int mipLevel = g_Textures_mipLevel ){
+	q->width = nWidth;
+	q->height = nHeight;
 
-	gl().glGenTextures( 1, &q->texture_number );
+	if ( q->texture_number == 0 ) {
+		gl().glGenTextures( 1, &q->texture_number );
+	}
 
 	gl().glBindTexture( GL_TEXTURE_2D, q->texture_number );
 
@@ -192,7 +215,7 @@ void LoadTextureRGBA( qtexture_t* q, unsigned char* pPixels, int nWidth, int nHe
 	gl().glTexParameteri( GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_TRUE );
 	gl().glTexImage2D( GL_TEXTURE_2D, 0, g_texture_globals.texture_components, nWidth, nHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, pPixels );
 
-	gl().glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, std::min( g_Textures_mipLevel, static_cast<int>( log2( static_cast<float>( std::max( nWidth, nHeight ) ) ) ) ) );
+	gl().glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, std::min( mipLevel, static_cast<int>( log2( static_cast<float>( std::max( nWidth, nHeight ) ) ) ) ) );
 
 	gl().glBindTexture( GL_TEXTURE_2D, 0 );
 #else
@@ -216,8 +239,8 @@ void LoadTextureRGBA( qtexture_t* q, unsigned char* pPixels, int nWidth, int nHe
 		outpixels = pPixels;
 	}
 
-	const int target_width = std::max( std::min( gl_width >> g_Textures_mipLevel, max_tex_size ), 1 );
-	const int target_height = std::max( std::min( gl_height >> g_Textures_mipLevel, max_tex_size ), 1 );
+	const int target_width = std::max( std::min( gl_width >> mipLevel, max_tex_size ), 1 );
+	const int target_height = std::max( std::min( gl_height >> mipLevel, max_tex_size ), 1 );
 
 	while ( gl_width > target_width || gl_height > target_height )
 	{
@@ -254,6 +277,15 @@ void LoadTextureRGBA( qtexture_t* q, unsigned char* pPixels, int nWidth, int nHe
 #endif
 }
 
+/// \brief This function does the actual processing of raw RGBA data into a GL texture.
+/// It will also resample to power-of-two dimensions, generate the mipmaps and adjust gamma.
+void LoadTextureRGBA( qtexture_t* q, unsigned char* pPixels, int nWidth, int nHeight ){
+	q->texture_number = 0;
+	Textures_updateGammaTable();
+	q->color = ResampleTextureGamma( pPixels, nWidth, nHeight );
+	UploadTextureRGBA( q, pPixels, nWidth, nHeight );
+}
+
 #if 0
 /*
    ==============
@@ -323,16 +355,334 @@ const TestHashtable g_testhashtable;
 
 typedef std::pair<LoadImageCallback, CopiedString> TextureKey;
 
+/// \brief An image loaded and gamma corrected ahead of its GL upload.
+struct DecodedTexture
+{
+	Image* image = nullptr;
+	Colour3 color;
+};
+
+/// \brief Loads the image of \p key and applies gamma, may run on a decode thread.
+void DecodeTexture( DecodedTexture& decoded, const TextureKey& key ){
+	decoded.image = key.first.loadImage( key.second.c_str() );
+	if ( decoded.image != nullptr ) {
+		decoded.color = ResampleTextureGamma( decoded.image->getRGBAPixels(), decoded.image->getWidth(), decoded.image->getHeight() );
+	}
+}
+
+bool TextureDecoder_take( const TextureKey& key, DecodedTexture& decoded );
+
+ImageModules& Textures_getImageModules();
+
+/// \brief A downscaled texture with the properties of its full image, kept on disk by TextureThumbnailCache.
+struct TextureThumbnail
+{
+	CopiedString source;    // image file, or the pak containing it
+	std::uint64_t sourceSize;
+	std::int64_t sourceTime;
+	std::uint32_t width, height;
+	std::int32_t surfaceFlags, contentFlags, value;
+	Colour3 color;
+	std::uint32_t thumbnailWidth, thumbnailHeight;
+	std::vector<byte> pixels; // gamma corrected RGBA, zlib compressed
+};
+
+/// \brief Thumbnails of the textures of one texture browser directory, stored in a single file.
+/// A thumbnail is valid while the image it was made from keeps its path, size and modification time.
+class TextureThumbnailCache
+{
+	static constexpr char c_magic[4] = { 'R', 'T', 'H', 'M' };
+	static constexpr std::uint32_t c_version = 1;
+	static constexpr std::uint32_t c_thumbnailSize = 128;
+
+	struct Source
+	{
+		CopiedString path;
+		std::uint64_t size = 0;
+		std::int64_t time = 0;
+	};
+
+	CopiedString m_filename;
+	std::map<CopiedString, TextureThumbnail> m_stored;
+	std::map<CopiedString, TextureThumbnail> m_used;
+	std::map<CopiedString, Source> m_sources;
+	bool m_changed = false;
+
+	/// \brief Finds the file QERApp_LoadImage loads \p name from.
+	const Source& source( const char* name ){
+		auto [ i, inserted ] = m_sources.try_emplace( name );
+		if ( inserted ) {
+			class FindImageVisitor : public ImageModules::Visitor
+			{
+				const char* m_name;
+				Source& m_source;
+			public:
+				FindImageVisitor( const char* name, Source& source ) : m_name( name ), m_source( source ){
+				}
+				void visit( const char* name, const _QERPlugImageTable& table ) const override {
+					if ( m_source.path.empty() ) {
+						const auto file = StringStream( m_name, '.', name );
+						const char* root = GlobalFileSystem().findFile( file );
+						if ( !string_empty( root ) ) {
+							m_source.path = file_is_directory( root )
+							                ? StringStream( root, path_separator( root[string_length( root ) - 1] ) ? "" : "/", file ).c_str()
+							                : root;
+							m_source.size = file_size( m_source.path.c_str() );
+							m_source.time = file_modified( m_source.path.c_str() );
+						}
+					}
+				}
+			};
+			Textures_getImageModules().foreachModule( FindImageVisitor( name, i->second ) );
+		}
+		return i->second;
+	}
+
+	template<typename T>
+	static bool read( const byte*& data, const byte* end, T& value ){
+		if ( std::size_t( end - data ) < sizeof( T ) ) {
+			return false;
+		}
+		memcpy( &value, data, sizeof( T ) );
+		data += sizeof( T );
+		return true;
+	}
+	static bool read( const byte*& data, const byte* end, std::vector<byte>& bytes ){
+		std::uint32_t size;
+		if ( !read( data, end, size ) || std::size_t( end - data ) < size ) {
+			return false;
+		}
+		bytes.assign( data, data + size );
+		data += size;
+		return true;
+	}
+	static bool read( const byte*& data, const byte* end, CopiedString& string ){
+		std::vector<byte> bytes;
+		if ( !read( data, end, bytes ) ) {
+			return false;
+		}
+		string = StringRange( reinterpret_cast<const char*>( bytes.data() ), bytes.size() );
+		return true;
+	}
+	template<typename T>
+	static void write( std::vector<byte>& out, const T& value ){
+		const auto *bytes = reinterpret_cast<const byte*>( &value );
+		out.insert( out.end(), bytes, bytes + sizeof( T ) );
+	}
+	static void write( std::vector<byte>& out, const byte* bytes, std::uint32_t size ){
+		write( out, size );
+		out.insert( out.end(), bytes, bytes + size );
+	}
+
+	void load(){
+		std::vector<byte> file;
+		{
+			FileInputStream stream( m_filename.c_str() );
+			if ( stream.failed() ) {
+				return;
+			}
+			stream.seek( 0, FileInputStream::end );
+			file.resize( stream.tell() );
+			stream.seek( 0 );
+			if ( stream.read( file.data(), file.size() ) != file.size() ) {
+				return;
+			}
+		}
+
+		const byte *data = file.data(), *end = file.data() + file.size();
+		char magic[4];
+		std::uint32_t version, thumbnailSize, count;
+		float gamma;
+		if ( !read( data, end, magic ) || memcmp( magic, c_magic, sizeof( magic ) ) != 0
+		  || !read( data, end, version ) || version != c_version
+		  || !read( data, end, thumbnailSize ) || thumbnailSize != c_thumbnailSize
+		  || !read( data, end, gamma ) || gamma != g_texture_globals.fGamma
+		  || !read( data, end, count ) ) {
+			return;
+		}
+		for ( std::uint32_t i = 0; i < count; ++i )
+		{
+			CopiedString name;
+			TextureThumbnail t;
+			if ( !read( data, end, name ) || !read( data, end, t.source ) || !read( data, end, t.sourceSize ) || !read( data, end, t.sourceTime )
+			  || !read( data, end, t.width ) || !read( data, end, t.height )
+			  || !read( data, end, t.surfaceFlags ) || !read( data, end, t.contentFlags ) || !read( data, end, t.value )
+			  || !read( data, end, t.color ) || !read( data, end, t.thumbnailWidth ) || !read( data, end, t.thumbnailHeight )
+			  || !read( data, end, t.pixels )
+			  || t.width == 0 || t.height == 0
+			  || t.thumbnailWidth == 0 || t.thumbnailWidth > std::min( t.width, c_thumbnailSize )
+			  || t.thumbnailHeight == 0 || t.thumbnailHeight > std::min( t.height, c_thumbnailSize ) ) {
+				m_stored.clear();
+				return;
+			}
+			m_stored.emplace( std::move( name ), std::move( t ) );
+		}
+	}
+	void save(){
+		// thumbnails of textures not shown this time are kept
+		for ( auto& [ name, t ] : m_used )
+			m_stored.insert_or_assign( name, std::move( t ) );
+
+		std::vector<byte> file;
+		file.insert( file.end(), std::begin( c_magic ), std::end( c_magic ) );
+		write( file, c_version );
+		write( file, c_thumbnailSize );
+		write( file, g_texture_globals.fGamma );
+		write( file, std::uint32_t( m_stored.size() ) );
+		for ( const auto& [ name, t ] : m_stored )
+		{
+			write( file, reinterpret_cast<const byte*>( name.c_str() ), string_length( name.c_str() ) );
+			write( file, reinterpret_cast<const byte*>( t.source.c_str() ), string_length( t.source.c_str() ) );
+			write( file, t.sourceSize );
+			write( file, t.sourceTime );
+			write( file, t.width );
+			write( file, t.height );
+			write( file, t.surfaceFlags );
+			write( file, t.contentFlags );
+			write( file, t.value );
+			write( file, t.color );
+			write( file, t.thumbnailWidth );
+			write( file, t.thumbnailHeight );
+			write( file, t.pixels.data(), t.pixels.size() );
+		}
+
+		const auto temporary = StringStream( m_filename, ".tmp" );
+		bool success;
+		{
+			FileOutputStream stream( temporary );
+			success = !stream.failed() && stream.write( file.data(), file.size() ) == file.size();
+		}
+		if ( !success || !file_move( temporary, m_filename.c_str() ) ) {
+			file_remove( temporary );
+			globalWarningStream() << "Failed to write texture thumbnails " << Quoted( m_filename ) << '\n';
+		}
+	}
+
+public:
+	explicit TextureThumbnailCache( const char* filename ) : m_filename( filename ){
+		load();
+	}
+	~TextureThumbnailCache(){
+		if ( m_changed ) {
+			save();
+		}
+	}
+
+	/// \brief Returns the thumbnail of texture \p name, if it is up to date.
+	const TextureThumbnail* find( const char* name ){
+		if ( const auto used = m_used.find( name ); used != m_used.end() ) {
+			return &used->second;
+		}
+		const auto stored = m_stored.find( name );
+		if ( stored == m_stored.end() ) {
+			return nullptr;
+		}
+		const Source& src = source( name );
+		const TextureThumbnail& t = stored->second;
+		if ( src.path.empty() || !string_equal( src.path.c_str(), t.source.c_str() ) || src.size != t.sourceSize || src.time != t.sourceTime ) {
+			return nullptr;
+		}
+		return &m_used.insert_or_assign( stored->first, t ).first->second;
+	}
+
+	/// \brief Makes a thumbnail of the gamma corrected \p image just loaded for \p texture.
+	void insert( const qtexture_t& texture, const Image& image ){
+		const Source& src = source( texture.name );
+		if ( src.path.empty() ) {
+			return;
+		}
+
+		TextureThumbnail t{ src.path, src.size, src.time,
+		                    image.getWidth(), image.getHeight(),
+		                    texture.surfaceFlags, texture.contentFlags, texture.value,
+		                    texture.color,
+		                    image.getWidth(), image.getHeight(), {} };
+		const byte *pixels = image.getRGBAPixels();
+		std::vector<byte> resampled;
+		if ( std::max( t.width, t.height ) > c_thumbnailSize ) {
+			const float scale = float( c_thumbnailSize ) / std::max( t.width, t.height );
+			t.thumbnailWidth = std::max( 1, int( t.width * scale ) );
+			t.thumbnailHeight = std::max( 1, int( t.height * scale ) );
+			resampled.resize( t.thumbnailWidth * t.thumbnailHeight * 4 );
+			R_ResampleTexture( pixels, t.width, t.height, resampled.data(), t.thumbnailWidth, t.thumbnailHeight, 4 );
+			pixels = resampled.data();
+		}
+
+		const uLong size = t.thumbnailWidth * t.thumbnailHeight * 4;
+		uLongf compressedSize = compressBound( size );
+		t.pixels.resize( compressedSize );
+		if ( compress2( t.pixels.data(), &compressedSize, pixels, size, Z_BEST_SPEED ) != Z_OK ) {
+			return;
+		}
+		t.pixels.resize( compressedSize );
+
+		m_used.insert_or_assign( texture.name, std::move( t ) );
+		m_changed = true;
+	}
+};
+
+TextureThumbnailCache* g_textureThumbnailCache = nullptr;
+
+/// \brief Textures loaded from a thumbnail, which are loaded in full by Textures_loadFullResolution().
+std::set<qtexture_t*> g_textureThumbnails;
+
+/// \brief True if \p key may be loaded from its thumbnail, textures with another loader are not cached.
+bool TextureThumbnails_cached( const TextureKey& key ){
+	return g_textureThumbnailCache != nullptr && !key.first.m_skybox && key.first == LoadImageCallback( 0, QERApp_LoadImage );
+}
+
+bool qtexture_realiseThumbnail( qtexture_t& texture, const TextureKey& key ){
+	if ( !TextureThumbnails_cached( key ) ) {
+		return false;
+	}
+	const TextureThumbnail* thumbnail = g_textureThumbnailCache->find( key.second.c_str() );
+	if ( thumbnail == nullptr ) {
+		return false;
+	}
+
+	uLongf size = thumbnail->thumbnailWidth * thumbnail->thumbnailHeight * 4;
+	std::vector<byte> pixels( size );
+	if ( uncompress( pixels.data(), &size, thumbnail->pixels.data(), thumbnail->pixels.size() ) != Z_OK || size != pixels.size() ) {
+		return false;
+	}
+
+	// the thumbnail is already that many mip levels down
+	const int thumbnailLevels = static_cast<int>( log2( static_cast<float>( std::max( thumbnail->width, thumbnail->height ) )
+	                                                    / std::max( thumbnail->thumbnailWidth, thumbnail->thumbnailHeight ) ) );
+	UploadTextureRGBA( &texture, pixels.data(), thumbnail->thumbnailWidth, thumbnail->thumbnailHeight, std::max( 0, g_Textures_mipLevel - thumbnailLevels ) );
+	texture.width = thumbnail->width;
+	texture.height = thumbnail->height;
+	texture.color = thumbnail->color;
+	texture.surfaceFlags = thumbnail->surfaceFlags;
+	texture.contentFlags = thumbnail->contentFlags;
+	texture.value = thumbnail->value;
+	g_textureThumbnails.insert( &texture );
+	globalOutputStream() << "Loaded Texture Thumbnail: " << Quoted( key.second ) << '\n';
+	return true;
+}
+
 void qtexture_realise( qtexture_t& texture, const TextureKey& key ){
 	texture.texture_number = 0;
 	if ( !key.second.empty() ) {
-		if( !key.first.m_skybox ){
-			Image* image = key.first.loadImage( key.second.c_str() );
+		if( qtexture_realiseThumbnail( texture, key ) ){
+			GlobalOpenGL_debugAssertNoErrors();
+		}
+		else if( !key.first.m_skybox ){
+			DecodedTexture decoded;
+			if ( !TextureDecoder_take( key, decoded ) ) {
+				Textures_updateGammaTable();
+				DecodeTexture( decoded, key );
+			}
+			Image* image = decoded.image;
 			if ( image != 0 ) {
-				LoadTextureRGBA( &texture, image->getRGBAPixels(), image->getWidth(), image->getHeight() );
+				texture.color = decoded.color;
+				UploadTextureRGBA( &texture, image->getRGBAPixels(), image->getWidth(), image->getHeight() );
 				texture.surfaceFlags = image->getSurfaceFlags();
 				texture.contentFlags = image->getContentFlags();
 				texture.value = image->getValue();
+				if ( TextureThumbnails_cached( key ) ) {
+					g_textureThumbnailCache->insert( texture, *image );
+				}
 				image->release();
 				globalOutputStream() << "Loaded Texture: " << Quoted( key.second ) << '\n';
 				GlobalOpenGL_debugAssertNoErrors();
@@ -392,6 +742,7 @@ void qtexture_realise( qtexture_t& texture, const TextureKey& key ){
 }
 
 void qtexture_unrealise( qtexture_t& texture ){
+	g_textureThumbnails.erase( &texture );
 	if ( GlobalOpenGL().contextValid && texture.texture_number != 0 ) {
 		gl().glDeleteTextures( 1, &texture.texture_number );
 		GlobalOpenGL_debugAssertNoErrors();
@@ -415,6 +766,157 @@ public:
 	}
 };
 
+/// \brief Decodes the images of a batch of textures on worker threads, in batch order.
+/// qtexture_realise takes the decoded images and uploads them on the main thread, waiting for one still being decoded.
+/// Workers pause while c_maxDecoded images wait for their upload, which bounds the memory of a large batch.
+class TextureDecoder
+{
+	enum class EState
+	{
+		Queued,
+		Decoding,
+		Decoded,
+		Taken,
+	};
+	struct Job
+	{
+		TextureKey key;
+		EState state = EState::Queued;
+		bool dropped = false;       // skipped while decoding, the worker frees the image
+		DecodedTexture decoded;
+	};
+	static constexpr std::size_t c_maxDecoded = 32;
+
+	std::vector<Job> m_jobs;
+	std::unordered_map<TextureKey, std::size_t, TextureKeyHashNoCase, TextureKeyEqualNoCase> m_index;
+	std::size_t m_next = 0;     // next job for a worker
+	std::size_t m_taken = 0;    // jobs before this are taken or dropped
+	std::size_t m_decoded = 0;  // images decoding or decoded, but not taken
+	bool m_stop = false;
+	std::mutex m_mutex;
+	std::condition_variable m_jobDecoded;
+	std::condition_variable m_canDecode;
+	std::vector<std::thread> m_threads;
+
+	/// \brief Frees the image of a job, which was not taken in order.
+	void drop( Job& job ){
+		if ( job.state == EState::Decoding ) {
+			job.dropped = true;
+		}
+		else if ( job.state != EState::Taken ) {
+			release( job );
+		}
+	}
+	/// \brief Frees the image of a decoded or queued job.
+	void release( Job& job ){
+		if ( job.decoded.image != nullptr ) {
+			job.decoded.image->release();
+			job.decoded.image = nullptr;
+			--m_decoded;
+		}
+		job.state = EState::Taken;
+	}
+
+	void work(){
+		std::unique_lock lock( m_mutex );
+		while ( true )
+		{
+			m_canDecode.wait( lock, [this]{ return m_stop || ( m_next != m_jobs.size() && m_decoded < c_maxDecoded ); } );
+			if ( m_stop ) {
+				return;
+			}
+			Job& job = m_jobs[m_next++];
+			if ( job.state != EState::Queued ) { // taken by the main thread before its turn
+				continue;
+			}
+			job.state = EState::Decoding;
+			++m_decoded;
+			lock.unlock();
+			DecodeTexture( job.decoded, job.key );
+			lock.lock();
+			job.state = EState::Decoded;
+			if ( job.decoded.image == nullptr ) { // nothing to hold on to
+				--m_decoded;
+				m_canDecode.notify_all();
+			}
+			else if ( job.dropped ) {
+				release( job );
+				m_canDecode.notify_all();
+			}
+			m_jobDecoded.notify_all();
+		}
+	}
+public:
+	/// \brief Starts decoding \p keys, must be constructed on the main thread.
+	TextureDecoder( const std::vector<TextureKey>& keys ){
+		m_jobs.reserve( keys.size() );
+		for ( const TextureKey& key : keys )
+		{
+			if ( !key.first.m_skybox && m_index.emplace( key, m_jobs.size() ).second ) {
+				m_jobs.push_back( Job{ key } );
+			}
+		}
+
+		Textures_updateGammaTable();
+
+		const std::size_t count = std::min<std::size_t>( std::max( std::thread::hardware_concurrency(), 2u ) - 1, m_jobs.size() );
+		for ( std::size_t i = 0; i != count; ++i )
+			m_threads.emplace_back( &TextureDecoder::work, this );
+	}
+	~TextureDecoder(){
+		{
+			const std::lock_guard lock( m_mutex );
+			m_stop = true;
+		}
+		m_canDecode.notify_all();
+		for ( std::thread& thread : m_threads )
+			thread.join();
+
+		for ( Job& job : m_jobs )
+		{
+			if ( job.decoded.image != nullptr ) {
+				job.decoded.image->release();
+			}
+		}
+	}
+
+	/// \brief Takes the decoded image of \p key, false if the caller has to decode it.
+	bool take( const TextureKey& key, DecodedTexture& decoded ){
+		const auto found = m_index.find( key );
+		if ( found == m_index.end() ) {
+			return false;
+		}
+		Job& job = m_jobs[found->second];
+
+		std::unique_lock lock( m_mutex );
+		// textures are captured in batch order, so skipped decoded images are not going to be used, free their slots
+		for ( ; m_taken < found->second; ++m_taken )
+		{
+			drop( m_jobs[m_taken] );
+		}
+		if ( job.state == EState::Queued || job.state == EState::Taken ) { // not started yet or dropped, faster to decode right away
+			job.state = EState::Taken;
+			m_canDecode.notify_all();
+			return false;
+		}
+		job.dropped = false; // wanted after all
+		m_jobDecoded.wait( lock, [&job]{ return job.state == EState::Decoded; } );
+		decoded = std::exchange( job.decoded, DecodedTexture() );
+		job.state = EState::Taken;
+		if ( decoded.image != nullptr ) {
+			--m_decoded;
+		}
+		m_canDecode.notify_all();
+		return true;
+	}
+};
+
+TextureDecoder* g_textureDecoder = nullptr;
+
+bool TextureDecoder_take( const TextureKey& key, DecodedTexture& decoded ){
+	return g_textureDecoder != nullptr && g_textureDecoder->take( key, decoded );
+}
+
 #define DEBUG_TEXTURES 0
 
 class TexturesMap final : public TexturesCache
@@ -457,6 +959,9 @@ public:
 	iterator end(){
 		return m_qtextures.end();
 	}
+	iterator find( const TextureKey& key ){
+		return m_qtextures.find( key );
+	}
 
 	LoadImageCallback defaultLoader() const override {
 		return LoadImageCallback( 0, QERApp_LoadImage );
@@ -541,10 +1046,27 @@ public:
 				max_tex_size = 1024;
 			}
 
-			for ( auto& tex : m_qtextures )
 			{
-				if ( !tex.value.empty() ) {
-					qtexture_realise( *tex.value, tex.key );
+				std::vector<TextureKey> keys;
+				for ( auto& tex : m_qtextures )
+				{
+					if ( !tex.value.empty() ) {
+						keys.push_back( tex.key );
+					}
+				}
+				std::optional<TextureDecoder> decoder;
+				if ( g_textureDecoder == nullptr ) {
+					g_textureDecoder = &decoder.emplace( keys );
+				}
+
+				for ( auto& tex : m_qtextures )
+				{
+					if ( !tex.value.empty() ) {
+						qtexture_realise( *tex.value, tex.key );
+					}
+				}
+				if ( decoder ) {
+					g_textureDecoder = nullptr;
 				}
 			}
 			if ( m_observer != 0 ) {
@@ -576,6 +1098,55 @@ TexturesCache& GetTexturesCache(){
 	return *g_texturesmap;
 }
 
+TexturesPrefetch::TexturesPrefetch( const std::vector<CopiedString>& names ){
+	if ( g_textureDecoder == nullptr && g_texturesmap->realised() ) {
+		std::vector<TextureKey> keys;
+		keys.reserve( names.size() );
+		for ( const CopiedString& name : names )
+		{
+			TextureKey key( g_texturesmap->defaultLoader(), name );
+			if ( g_texturesmap->find( key ) == g_texturesmap->end() // already loaded textures are not realised again
+			  && !( TextureThumbnails_cached( key ) && g_textureThumbnailCache->find( name.c_str() ) != nullptr ) ) {
+				keys.push_back( std::move( key ) );
+			}
+		}
+		g_textureDecoder = new TextureDecoder( keys );
+		m_active = true;
+	}
+}
+
+TexturesPrefetch::~TexturesPrefetch(){
+	if ( m_active ) {
+		delete std::exchange( g_textureDecoder, nullptr );
+	}
+}
+
+TexturesThumbnails::TexturesThumbnails( const char* filename ){
+	if ( g_textureThumbnailCache == nullptr && g_texturesmap->realised() ) {
+		g_textureThumbnailCache = new TextureThumbnailCache( filename );
+		m_active = true;
+	}
+}
+
+TexturesThumbnails::~TexturesThumbnails(){
+	if ( m_active ) {
+		delete std::exchange( g_textureThumbnailCache, nullptr );
+	}
+}
+
+void Textures_loadFullResolution( qtexture_t& texture ){
+	if ( g_textureThumbnails.erase( &texture ) != 0 ) {
+		DecodedTexture decoded;
+		Textures_updateGammaTable();
+		DecodeTexture( decoded, TextureKey( texture.load, texture.name ) );
+		if ( decoded.image != nullptr ) {
+			UploadTextureRGBA( &texture, decoded.image->getRGBAPixels(), decoded.image->getWidth(), decoded.image->getHeight() );
+			decoded.image->release();
+			GlobalOpenGL_debugAssertNoErrors();
+		}
+	}
+}
+
 
 void Textures_Realise(){
 	g_texturesmap->realise();
@@ -22,9 +22,41 @@
 #pragma once
 
 #include "generic/callback.h"
+#include "string/string.h"
+#include <vector>
 
 void Textures_Realise();
 void Textures_Unrealise();
 void Textures_sharedContextDestroyed();
 
+/// \brief While it exists, the texture images \p names are decoded on worker threads, in the given order.
+/// Textures captured meanwhile with the default loader use the decoded images, so capture them in the same order.
+/// Shaders capture their texture by its image name, see ShaderSystem::getShaderTextureName().
+class TexturesPrefetch
+{
+	bool m_active = false;
+public:
+	explicit TexturesPrefetch( const std::vector<CopiedString>& names );
+	~TexturesPrefetch();
+	TexturesPrefetch( const TexturesPrefetch& ) = delete;
+	TexturesPrefetch& operator=( const TexturesPrefetch& ) = delete;
+};
+
+/// \brief While it exists, textures realised with the default loader are uploaded from downscaled thumbnails
+/// kept in the file \p filename, which is updated with the thumbnails of textures loaded in full meanwhile.
+/// Textures_loadFullResolution() replaces a thumbnail with its full image.
+class TexturesThumbnails
+{
+	bool m_active = false;
+public:
+	explicit TexturesThumbnails( const char* filename );
+	~TexturesThumbnails();
+	TexturesThumbnails( const TexturesThumbnails& ) = delete;
+	TexturesThumbnails& operator=( const TexturesThumbnails& ) = delete;
+};
+
+struct qtexture_t;
+/// \brief Uploads the full image of \p texture, if it was realised from a thumbnail.
+void Textures_loadFullResolution( qtexture_t& texture );
+
 void Textures_setModeChangedNotify( const Callback<void()>& notify );
@@ -62,6 +62,7 @@
 #include "shaderlib.h"
 #include "os/file.h"
 #include "os/path.h"
+#include "commandlib.h"
 #include "stream/stringstream.h"
 #include "textures.h"
 
@@ -650,33 +651,36 @@ void TextureBrowser_trackRecentFolders( const char *folder ){
 class TextureCategoryLoadShader
 {
 	const char* m_directory;
-	std::size_t& m_count;
+	std::vector<CopiedString>& m_names;
 public:
 	using func = void(const char *);
 
-	TextureCategoryLoadShader( const char* directory, std::size_t& count )
-		: m_directory( directory ), m_count( count ){
-		m_count = 0;
+	TextureCategoryLoadShader( const char* directory, std::vector<CopiedString>& names )
+		: m_directory( directory ), m_names( names ){
 	}
 	void operator()( const char* name ) const {
 		if ( shader_equal_prefix( name, GlobalTexturePrefix_get() )
 		  && shader_equal_prefix( name + string_length( GlobalTexturePrefix_get() ), m_directory ) ) {
-			++m_count;
-			// request the shader, this will load the texture if needed
-			// this Shader_ForName call is a kind of hack
-			IShader *pFoo = QERApp_Shader_ForName( name );
-			pFoo->DecRef();
+			m_names.emplace_back( name );
 		}
 	}
 };
 
-void TexturePath_loadTexture( const char* name ){
+bool TexturePath_validTexture( const char* name ){
 	if ( texture_name_ignore( name ) ) {
-		return;
+		return false;
 	}
 
 	if ( !shader_valid( name ) ) {
 		globalWarningStream() << "Skipping invalid texture name: [" << name << "]\n";
+		return false;
+	}
+
+	return true;
+}
+
+void TexturePath_loadTexture( const char* name ){
+	if ( !TexturePath_validTexture( name ) ) {
 		return;
 	}
 
@@ -684,23 +688,84 @@ void TexturePath_loadTexture( const char* name ){
 	IShader* shader = QERApp_Shader_ForName( name );
 	shader->DecRef();
 }
-void TextureDirectory_loadTexture( const char* directory, const char* texture ){
-	TexturePath_loadTexture( StringStream<64>( directory, PathExtensionless( texture ) ) );
-}
-typedef ConstPointerCaller<char, void(const char*), TextureDirectory_loadTexture> TextureDirectoryLoadTextureCaller;
+
+class TextureDirectoryLoadTexture
+{
+	const char* m_directory;
+	std::vector<CopiedString>& m_names;
+public:
+	using func = void(const char *);
+
+	TextureDirectoryLoadTexture( const char* directory, std::vector<CopiedString>& names )
+		: m_directory( directory ), m_names( names ){
+	}
+	void operator()( const char* texture ) const {
+		const auto name = StringStream<64>( m_directory, PathExtensionless( texture ) );
+		if ( TexturePath_validTexture( name ) ) {
+			m_names.emplace_back( name.c_str() );
+		}
+	}
+};
 
 class LoadTexturesByTypeVisitor : public ImageModules::Visitor
 {
 	const char* m_dirstring;
+	std::vector<CopiedString>& m_names;
 public:
-	LoadTexturesByTypeVisitor( const char* dirstring )
-		: m_dirstring( dirstring ){
+	LoadTexturesByTypeVisitor( const char* dirstring, std::vector<CopiedString>& names )
+		: m_dirstring( dirstring ), m_names( names ){
 	}
 	void visit( const char* minor, const _QERPlugImageTable& table ) const override {
-		GlobalFileSystem().forEachFile( m_dirstring, minor, TextureDirectoryLoadTextureCaller( m_dirstring ) );
+		GlobalFileSystem().forEachFile( m_dirstring, minor, makeCallback( TextureDirectoryLoadTexture( m_dirstring, m_names ) ) );
+	}
+};
+
+class ShaderTextureName
+{
+	std::vector<CopiedString>& m_textures;
+public:
+	using func = void(const char *);
+
+	ShaderTextureName( std::vector<CopiedString>& textures )
+		: m_textures( textures ){
+	}
+	void operator()( const char* name ) const {
+		m_textures.emplace_back( name );
 	}
 };
 
+/// \brief Returns the texture images the valid \p shaders are shown with, in the same order.
+/// The images are resolved without activating the shaders, so they can be prefetched before the shaders are loaded.
+template<typename Shaders>
+std::vector<CopiedString> TextureBrowser_shaderTextures( const Shaders& shaders ){
+	std::vector<CopiedString> textures;
+	textures.reserve( shaders.size() );
+	for ( const CopiedString& shader : shaders )
+	{
+		if ( !texture_name_ignore( shader.c_str() ) && shader_valid( shader.c_str() ) ) {
+			GlobalShaderSystem().getShaderTextureName( shader.c_str(), makeCallback( ShaderTextureName( textures ) ) );
+		}
+	}
+	return textures;
+}
+
+/// \brief Returns the thumbnail cache file of texture \p directory, in the game settings.
+CopiedString TextureBrowser_thumbnailsFile( const char* directory ){
+	const auto path = StringStream( SettingsPath_get(), g_pGameDescription->mGameFile, "/thumbnails/" );
+	if ( !file_exists( path ) ) {
+		Q_mkdir( path );
+	}
+	auto file = StringStream( path, directory );
+	for ( char* c = file.c_str() + string_length( path ); *c != '\0'; ++c )
+	{
+		if ( path_separator( *c ) || *c == ':' ) {
+			*c = '_';
+		}
+	}
+	file << ".bin";
+	return file.c_str();
+}
+
 void TextureBrowser_ShowDirectory( const char* directory ){
 	g_TexBro.m_searchedTags = false;
 	if ( TextureBrowser::wads ) {
@@ -719,13 +784,25 @@ void TextureBrowser_ShowDirectory( const char* directory ){
 	{
 		g_TextureBrowser_currentDirectory = directory;
 
-		std::size_t shaders_count;
-		GlobalShaderSystem().foreachShaderName( makeCallback( TextureCategoryLoadShader( directory, shaders_count ) ) );
-		globalOutputStream() << "Showing " << shaders_count << " shaders.\n";
+		std::vector<CopiedString> names;
+		GlobalShaderSystem().foreachShaderName( makeCallback( TextureCategoryLoadShader( directory, names ) ) );
+		globalOutputStream() << "Showing " << names.size() << " shaders.\n";
 
 		if ( g_pGameDescription->mGameType != "doom3" ) {
 			// load remaining texture files
-			Radiant_getImageModules().foreachModule( LoadTexturesByTypeVisitor( StringStream<64>( GlobalTexturePrefix_get(), directory ) ) );
+			Radiant_getImageModules().foreachModule( LoadTexturesByTypeVisitor( StringStream<64>( GlobalTexturePrefix_get(), directory ), names ) );
+		}
+
+		// upload cached thumbnails, full images are loaded once a texture is rendered in the scene
+		const TexturesThumbnails thumbnails( TextureBrowser_thumbnailsFile( directory ).c_str() );
+		// decode the remaining images on worker threads while requesting the shaders in the same order
+		const TexturesPrefetch prefetch( TextureBrowser_shaderTextures( names ) );
+		for ( const CopiedString& name : names )
+		{
+			// request the shader, this will load the texture if needed
+			// this Shader_ForName call is a kind of hack
+			IShader* shader = QERApp_Shader_ForName( name.c_str() );
+			shader->DecRef();
 		}
 	}
 
@@ -1428,6 +1505,7 @@ void TextureBrowser_searchTags(){
 			globalOutputStream() << "Found " << g_TexBro.m_found_shaders.size() << " textures and shaders with " << tags_searched << '\n';
 			ScopeDisableScreenUpdates disableScreenUpdates( "Searching...", "Loading Textures" );
 
+			const TexturesPrefetch prefetch( TextureBrowser_shaderTextures( g_TexBro.m_found_shaders ) );
 			for ( const CopiedString& shader : g_TexBro.m_found_shaders )
 			{
 				TexturePath_loadTexture( shader.c_str() );
@@ -1459,6 +1537,7 @@ void TextureBrowser_showUntagged(){
 
 		ScopeDisableScreenUpdates disableScreenUpdates( "Searching untagged textures...", "Loading Textures" );
 
+		const TexturesPrefetch prefetch( TextureBrowser_shaderTextures( g_TexBro.m_found_shaders ) );
 		for ( const CopiedString& shader : g_TexBro.m_found_shaders )
 		{
 			TexturePath_loadTexture( shader.c_str() );
@@ -30,9 +30,11 @@
 #include "preferences.h"
 #include "stringio.h"
 
+#include <algorithm>
 #include <list>
 #include <map>
 #include <set>
+#include <vector>
 
 #include "timer.h"
 
@@ -56,6 +58,7 @@ public:
 class RadiantUndoSystem final : public UndoSystem
 {
 	INTEGER_CONSTANT( MAX_UNDO_LEVELS, 4096 );
+	INTEGER_CONSTANT( MAX_UNDO_MEMORY_MB, 65536 );
 
 	class Snapshot
 	{
@@ -76,10 +79,14 @@ class RadiantUndoSystem final : public UndoSystem
 			void release(){
 				m_data->release();
 			}
+			std::size_t memory() const {
+				return sizeof( *this ) + m_data->size();
+			}
 		};
 
-		typedef std::list<StateApplicator> states_t;
+		typedef std::vector<StateApplicator> states_t;
 		states_t m_states;
+		std::size_t m_memory = 0;
 
 	public:
 		bool empty() const {
@@ -88,13 +95,21 @@ class RadiantUndoSystem final : public UndoSystem
 		std::size_t size() const {
 			return m_states.size();
 		}
-		void save( Undoable* undoable ){
-			m_states.push_front( StateApplicator( undoable, undoable->exportState() ) );
+		std::size_t memory() const {
+			return m_memory;
+		}
+		/// \return The memory added to the snapshot.
+		std::size_t save( Undoable* undoable ){
+			m_states.emplace_back( undoable, undoable->exportState() );
+			const std::size_t memory = m_states.back().memory();
+			m_memory += memory;
+			return memory;
 		}
 		void restore(){
-			for ( auto& stateApplicator : m_states )
+			// most recently saved first
+			for ( auto i = m_states.rbegin(); i != m_states.rend(); ++i )
 			{
-				stateApplicator.restore();
+				i->restore();
 			}
 		}
 		void release(){
@@ -126,6 +141,7 @@ class RadiantUndoSystem final : public UndoSystem
 
 		Operations m_stack;
 		Operation* m_pending;
+		std::size_t m_memory = 0;
 
 	public:
 		UndoStack() : m_pending( 0 ){
@@ -139,6 +155,10 @@ class RadiantUndoSystem final : public UndoSystem
 		std::size_t size() const {
 			return m_stack.size();
 		}
+		/// \brief Returns the approximate memory held by the saved states in bytes.
+		std::size_t memory() const {
+			return m_memory;
+		}
 		Operation* back(){
 			return m_stack.back();
 		}
@@ -152,10 +172,12 @@ class RadiantUndoSystem final : public UndoSystem
 			return m_stack.front();
 		}
 		void pop_front(){
+			m_memory -= m_stack.front()->m_snapshot.memory();
 			delete m_stack.front();
 			m_stack.pop_front();
 		}
 		void pop_back(){
+			m_memory -= m_stack.back()->m_snapshot.memory();
 			delete m_stack.back();
 			m_stack.pop_back();
 		}
@@ -167,6 +189,7 @@ class RadiantUndoSystem final : public UndoSystem
 				}
 				m_stack.clear();
 			}
+			m_memory = 0;
 		}
 		void start( const char* command ){
 			if ( m_pending != 0 ) {
@@ -192,7 +215,7 @@ class RadiantUndoSystem final : public UndoSystem
 				m_stack.push_back( m_pending );
 				m_pending = 0;
 			}
-			back()->m_snapshot.save( undoable );
+			m_memory += back()->m_snapshot.save( undoable );
 		}
 	};
 
@@ -231,12 +254,28 @@ class RadiantUndoSystem final : public UndoSystem
 	}
 
 	std::size_t m_undo_levels;
+	std::size_t m_undo_memory_mb;
 
 	typedef std::set<UndoTracker*> Trackers;
 	Trackers m_trackers;
+
+	/// \brief Drops the oldest undo steps while over the memory limit, always keeps the latest one.
+	void limitMemory(){
+		std::size_t dropped = 0;
+		const std::size_t memory = m_undo_stack.memory();
+		while ( m_undo_memory_mb != 0 && m_undo_stack.size() > 1 && m_undo_stack.memory() + m_redo_stack.memory() > std::uint64_t( m_undo_memory_mb ) << 20 )
+		{
+			m_undo_stack.pop_front();
+			++dropped;
+		}
+		if ( dropped != 0 ) {
+			globalOutputStream() << "Undo memory limit " << m_undo_memory_mb << " MB: dropped " << dropped << " oldest undo steps, "
+			                     << ( ( memory - m_undo_stack.memory() ) >> 10 ) << " KB\n";
+		}
+	}
 public:
 	RadiantUndoSystem()
-		: m_undo_levels( 512 ){
+		: m_undo_levels( 512 ), m_undo_memory_mb( 1024 ){
 	}
 	~RadiantUndoSystem(){
 		clear();
@@ -265,6 +304,13 @@ public:
 	std::size_t getLevels() const {
 		return m_undo_levels;
 	}
+	void setMemoryLimit( std::size_t megabytes ){
+		m_undo_memory_mb = std::min( megabytes, static_cast<std::size_t>( MAX_UNDO_MEMORY_MB ) );
+		limitMemory();
+	}
+	std::size_t getMemoryLimit() const {
+		return m_undo_memory_mb;
+	}
 	std::size_t size() const override {
 		return m_undo_stack.size();
 	}
@@ -295,8 +341,16 @@ public:
 		trackersBegin();
 	}
 	void finish( const char* command ) override {
+		Timer timer;
 		if ( finishUndo( command ) ) {
-			globalOutputStream() << command << '\n';
+			const int elapsed = timer.elapsed_msec();
+			globalOutputStream() << command << ": " << elapsed << " msec, " << ( m_undo_stack.back()->m_snapshot.memory() >> 10 ) << " KB, undo total "
+			                     << ( ( m_undo_stack.memory() + m_redo_stack.memory() ) >> 20 ) << " MB";
+			if ( m_undo_memory_mb != 0 ) {
+				globalOutputStream() << " of " << m_undo_memory_mb << " MB";
+			}
+			globalOutputStream() << '\n';
+			limitMemory();
 		}
 	}
 	void undo() override {
@@ -307,12 +361,14 @@ public:
 		{
 			Operation* operation = m_undo_stack.back();
 			globalOutputStream() << "Undo: " << operation->m_command << '\n';
+			DebugScopeTimer timer( "Undo" );
 
 			startRedo();
 			trackersUndo();
 			operation->m_snapshot.restore();
 			finishRedo( operation->m_command.c_str() );
 			m_undo_stack.pop_back();
+			limitMemory();
 		}
 	}
 	void redo() override {
@@ -323,12 +379,14 @@ public:
 		{
 			Operation* operation = m_redo_stack.back();
 			globalOutputStream() << "Redo: " << operation->m_command << '\n';
+			DebugScopeTimer timer( "Redo" );
 
 			startUndo();
 			trackersRedo();
 			operation->m_snapshot.restore();
 			finishUndo( operation->m_command.c_str() );
 			m_redo_stack.pop_back();
+			limitMemory();
 		}
 	}
 	void clear() override {
@@ -395,9 +453,19 @@ void UndoLevelsExport( const RadiantUndoSystem& self, const IntImportCallback& i
 }
 typedef ConstReferenceCaller<RadiantUndoSystem, void(const IntImportCallback&), UndoLevelsExport> UndoLevelsExportCaller;
 
+void UndoMemoryImport( RadiantUndoSystem& self, int value ){
+	self.setMemoryLimit( std::max( value, 0 ) );
+}
+typedef ReferenceCaller<RadiantUndoSystem, void(int), UndoMemoryImport> UndoMemoryImportCaller;
+void UndoMemoryExport( const RadiantUndoSystem& self, const IntImportCallback& importCallback ){
+	importCallback( static_cast<int>( self.getMemoryLimit() ) );
+}
+typedef ConstReferenceCaller<RadiantUndoSystem, void(const IntImportCallback&), UndoMemoryExport> UndoMemoryExportCaller;
+
 
 void Undo_constructPreferences( RadiantUndoSystem& undo, PreferencesPage& page ){
 	page.appendSpinner( "Undo Queue Size", 0, 4096, IntImportCallback( UndoLevelsImportCaller( undo ) ), IntExportCallback( UndoLevelsExportCaller( undo ) ) );
+	page.appendSpinner( "Undo Memory Limit (MB, 0 = unlimited)", 0, 65536, IntImportCallback( UndoMemoryImportCaller( undo ) ), IntExportCallback( UndoMemoryExportCaller( undo ) ) );
 }
 void Undo_constructPage( RadiantUndoSystem& undo, PreferenceGroup& group ){
 	PreferencesPage page( group.createPage( "Undo", "Undo Queue Settings" ) );
@@ -420,6 +488,7 @@ public:
 
 	UndoSystemAPI(){
 		GlobalPreferenceSystem().registerPreference( "UndoLevels", makeIntStringImportCallback( UndoLevelsImportCaller( m_undosystem ) ), makeIntStringExportCallback( UndoLevelsExportCaller( m_undosystem ) ) );
+		GlobalPreferenceSystem().registerPreference( "UndoMemoryMB", makeIntStringImportCallback( UndoMemoryImportCaller( m_undosystem ) ), makeIntStringExportCallback( UndoMemoryExportCaller( m_undosystem ) ) );
 
 		Undo_registerPreferencesPage( m_undosystem );
 	}
@@ -0,0 +1,154 @@
+# Compiles one map through -bsp -meta, -vis and -light, then checks the bsp lumps after
+# every stage against golden checksums and the -profile wall time and peak memory of every
+# stage against a machine local baseline.
+# Run via ctest, see README.txt; the first run (or Q3MAP2_BENCHMARK_UPDATE=1) records missing
+# goldens and the baseline.
+#
+# cmake -DQ3MAP2=<exe> -DMAP=<.map> -DTHREADS=<n> -DTHRESHOLD=<%> -DSLACK=<ms> -DLIGHT_ARGS=<list>
+#       -DWORK_DIR=<dir> -DGOLDEN=<file> -DBASELINE=<file> -P benchmark.cmake
+
+cmake_minimum_required(VERSION 3.21)
+
+get_filename_component(name ${MAP} NAME_WE)
+get_filename_component(mapDir ${MAP} DIRECTORY)
+
+# basepath with the map and its scripts/textures as baseq3
+file(REMOVE_RECURSE ${WORK_DIR})
+get_filename_component(mapDirName ${mapDir} NAME)
+if(mapDirName STREQUAL "maps")
+	get_filename_component(testDir ${mapDir} DIRECTORY)
+	file(COPY ${testDir}/ DESTINATION ${WORK_DIR}/baseq3)
+else()
+	file(COPY ${MAP} DESTINATION ${WORK_DIR}/baseq3/maps)
+endif()
+set(map ${WORK_DIR}/baseq3/maps/${name}.map)
+set(bsp ${WORK_DIR}/baseq3/maps/${name}.bsp)
+
+# ms from a -profile json number
+function(seconds_to_ms seconds out)
+	if(seconds MATCHES "^([0-9]+)\\.?([0-9]*)$")
+		string(SUBSTRING "${CMAKE_MATCH_2}000" 0 3 fraction)
+		math(EXPR ms "${CMAKE_MATCH_1} * 1000 + 1${fraction} - 1000")
+	else()
+		set(ms 0) # tiny values in exponent notation
+	endif()
+	set(${out} ${ms} PARENT_SCOPE)
+endfunction()
+
+# little endian int32 at hex digit offset
+function(hex_int32 hex offset out)
+	set(value "")
+	foreach(i 6 4 2 0)
+		math(EXPR o "${offset} + ${i}")
+		string(SUBSTRING "${hex}" ${o} 2 byte)
+		string(APPEND value ${byte})
+	endforeach()
+	math(EXPR value "0x${value}")
+	set(${out} ${value} PARENT_SCOPE)
+endfunction()
+
+# md5 of every lump listed in the bsp header
+function(bsp_lump_sums out)
+	file(READ ${bsp} header LIMIT 8 HEX)
+	hex_int32(${header} 8 version)
+	if(version EQUAL 46 OR version EQUAL 47)
+		set(numLumps 17) # ibsp
+	else()
+		set(numLumps 18) # rbsp
+	endif()
+	math(EXPR headerSize "8 + ${numLumps} * 8")
+	file(READ ${bsp} header LIMIT ${headerSize} HEX)
+	set(sums "")
+	math(EXPR last "${numLumps} - 1")
+	foreach(lump RANGE ${last})
+		math(EXPR o "16 + ${lump} * 16")
+		hex_int32(${header} ${o} offset)
+		math(EXPR o "${o} + 8")
+		hex_int32(${header} ${o} length)
+		if(length EQUAL 0)
+			list(APPEND sums "-")
+		else()
+			file(READ ${bsp} data OFFSET ${offset} LIMIT ${length} HEX)
+			string(MD5 sum "${data}")
+			string(SUBSTRING ${sum} 0 8 sum)
+			list(APPEND sums ${sum})
+		endif()
+	endforeach()
+	set(${out} "${sums}" PARENT_SCOPE)
+endfunction()
+
+set(results "")
+set(lumps "set(GOLDEN_light_args \"${LIGHT_ARGS}\")\n")
+foreach(stage bsp vis light)
+	if(stage STREQUAL "bsp")
+		set(args -meta)
+	elseif(stage STREQUAL "vis")
+		set(args -vis -saveprt)
+	else()
+		set(args -light ${LIGHT_ARGS})
+	endif()
+
+	execute_process(
+		COMMAND ${Q3MAP2} -fs_basepath ${WORK_DIR} -game quake3 -threads ${THREADS} -profile ${args} ${map}
+		OUTPUT_FILE ${WORK_DIR}/${name}.${stage}.log
+		ERROR_FILE ${WORK_DIR}/${name}.${stage}.log
+		RESULT_VARIABLE result
+	)
+	if(NOT result EQUAL 0 OR NOT EXISTS ${bsp})
+		message(FATAL_ERROR "${name}: -${stage} failed (${result}), see ${WORK_DIR}/${name}.${stage}.log")
+	endif()
+
+	file(READ ${WORK_DIR}/baseq3/maps/${name}.${stage}.profile.json profile)
+	string(JSON wall GET "${profile}" wall)
+	string(JSON peakMemory GET "${profile}" peakMemory)
+	seconds_to_ms(${wall} ${stage}_ms)
+	string(REGEX REPLACE "\\..*" "" ${stage}_memory ${peakMemory})
+	bsp_lump_sums(${stage}_lumps)
+
+	message(STATUS "${name} -${stage}: ${${stage}_ms} ms, ${${stage}_memory} bytes peak")
+	string(APPEND results "set(BASELINE_${stage}_ms ${${stage}_ms})\n")
+	string(APPEND results "set(BASELINE_${stage}_memory ${${stage}_memory})\n")
+	string(APPEND lumps "set(GOLDEN_${stage}_lumps \"${${stage}_lumps}\")\n")
+endforeach()
+
+# the output is deterministic, so lump checksums are kept with the map and committed
+set(failures "")
+if(NOT EXISTS ${GOLDEN} OR "$ENV{Q3MAP2_BENCHMARK_UPDATE}")
+	message(STATUS "${name}: recording golden lump checksums ${GOLDEN}, commit it")
+	file(WRITE ${GOLDEN} "${lumps}")
+else()
+	include(${GOLDEN})
+	foreach(stage bsp vis light)
+		if(stage STREQUAL "light" AND NOT "${LIGHT_ARGS}" STREQUAL "${GOLDEN_light_args}")
+			message(STATUS "${name}: -light lumps not checked, ${GOLDEN} was recorded with -light ${GOLDEN_light_args}")
+		elseif(NOT ${stage}_lumps STREQUAL GOLDEN_${stage}_lumps)
+			string(APPEND failures "\n  -${stage} bsp lumps differ:\n    golden  ${GOLDEN_${stage}_lumps}\n    current ${${stage}_lumps}")
+		endif()
+	endforeach()
+endif()
+
+# time and memory depend on the machine, so their baseline stays in the build directory
+if(NOT EXISTS ${BASELINE} OR "$ENV{Q3MAP2_BENCHMARK_UPDATE}")
+	message(STATUS "${name}: recording baseline ${BASELINE}")
+	file(WRITE ${BASELINE} "${results}")
+	if(failures)
+		message(FATAL_ERROR "${name} output differs from ${GOLDEN}:${failures}")
+	endif()
+	return()
+endif()
+
+include(${BASELINE})
+foreach(stage bsp vis light)
+	math(EXPR limit "${BASELINE_${stage}_ms} * (100 + ${THRESHOLD}) / 100 + ${SLACK}")
+	if(${stage}_ms GREATER limit)
+		string(APPEND failures "\n  -${stage} took ${${stage}_ms} ms, baseline ${BASELINE_${stage}_ms} ms")
+	endif()
+	math(EXPR limit "${BASELINE_${stage}_memory} / 100 * (100 + ${THRESHOLD})")
+	if(${stage}_memory GREATER limit)
+		string(APPEND failures "\n  -${stage} peak memory ${${stage}_memory} bytes, baseline ${BASELINE_${stage}_memory} bytes")
+	endif()
+endforeach()
+
+if(failures)
+	message(FATAL_ERROR "${name} regressed against ${GOLDEN} and ${BASELINE}:${failures}")
+endif()
@@ -45,6 +45,9 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "be_aas_sample.h"
 #include "be_aas_reach.h"
 #include "be_aas_move.h"
+#ifdef BSPC
+#include "../mbspc/l_threads.h"
+#endif //BSPC
 
 void AAS_Error(char *fmt, ...);
 
@@ -110,6 +113,12 @@ aas_lreachability_t *reachabilityheap;	//heap with reachabilities
 aas_lreachability_t *nextreachability;	//next free reachability from the heap
 aas_lreachability_t **areareachability;	//reachability links for every area
 int numlreachabilities;
+//reachability links found ahead in threads for every area, see AAS_FindAreaReachabilities
+aas_lreachability_t **pendingreachability;
+int reachthreaded;						//true while reachability links are allocated in threads
+//areas each area might have a reachability towards, see AAS_SetupReachabilityCandidates
+int *reachcandidates;
+int *firstreachcandidate;				//first candidate of every area, numareas + 1 entries
 
 //===========================================================================
 // returns the surface area of the given face
@@ -497,13 +506,21 @@ aas_lreachability_t *AAS_AllocReachability(void)
 {
 	aas_lreachability_t *r;
 
-	if (!nextreachability) return NULL;
-	//make sure the error message only shows up once
-	if (!nextreachability->next) AAS_Error("AAS_MAX_REACHABILITYSIZE");
-	//
+#ifdef BSPC
+	if (reachthreaded) ThreadLock();
+#endif //BSPC
 	r = nextreachability;
-	nextreachability = nextreachability->next;
-	numlreachabilities++;
+	if (r)
+	{
+		//make sure the error message only shows up once
+		if (!r->next) AAS_Error("AAS_MAX_REACHABILITYSIZE");
+		//
+		nextreachability = r->next;
+		numlreachabilities++;
+	} //end if
+#ifdef BSPC
+	if (reachthreaded) ThreadUnlock();
+#endif //BSPC
 	return r;
 } //end of the function AAS_AllocReachability
 //===========================================================================
@@ -4332,6 +4349,227 @@ void AAS_StoreReachability(void)
 	} //end for
 } //end of the function AAS_StoreReachability
 //===========================================================================
+// qsort compare function for area numbers
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+int AAS_CompareAreaNums(const void *a, const void *b)
+{
+	return *(const int *) a - *(const int *) b;
+} //end of the function AAS_CompareAreaNums
+//===========================================================================
+// returns the range of grid cells overlapped by the given bounds
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void AAS_ReachabilityGridCells(vec3_t gridmins, float cellsize, int *gridsize,
+								vec3_t mins, vec3_t maxs, float expand, int *cellmins, int *cellmaxs)
+{
+	int i;
+
+	for (i = 0; i < 2; i++)
+	{
+		cellmins[i] = (int) ((mins[i] - expand - gridmins[i]) / cellsize);
+		cellmaxs[i] = (int) ((maxs[i] + expand - gridmins[i]) / cellsize);
+		if (cellmins[i] < 0) cellmins[i] = 0;
+		if (cellmaxs[i] >= gridsize[i]) cellmaxs[i] = gridsize[i] - 1;
+	} //end for
+} //end of the function AAS_ReachabilityGridCells
+//===========================================================================
+// stores for every area, in ascending order, the areas close enough in the
+// x-y direction to have a swim, walk, step, barrier jump, water jump, walk
+// off ledge, ladder or jump reachability towards
+// a uniform x-y grid over the area bounds is used to find these areas
+// instead of testing every area against every other area
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		reachcandidates, firstreachcandidate
+//===========================================================================
+void AAS_SetupReachabilityCandidates(void)
+{
+	int i, j, k, n, x, y, gridsize[2], cellmins[2], cellmaxs[2];
+	int numcandidates, maxcandidates, *candidates;
+	int *cellareas, *firstcellarea, *areastamp;
+	float reachdist, cellsize;
+	vec3_t gridmins, gridmaxs;
+	aas_area_t *area1, *area2;
+
+	firstreachcandidate = (int *) GetClearedMemory((aasworld.numareas + 1) * sizeof(int));
+	maxcandidates = 1024;
+	reachcandidates = (int *) GetMemory(maxcandidates * sizeof(int));
+	numcandidates = 0;
+	if (aasworld.numareas < 2) return;
+	//areas further apart in the x-y direction can't have any of these reachabilities,
+	//see the bounding box tests in AAS_Reachability_Swim, AAS_Reachability_Jump etc.
+	reachdist = 2 * AAS_MaxJumpDistance(aassettings.phys_jumpvel);
+	if (reachdist < 10) reachdist = 10;
+	//
+	ClearBounds(gridmins, gridmaxs);
+	for (i = 1; i < aasworld.numareas; i++)
+	{
+		AddPointToBounds(aasworld.areas[i].mins, gridmins, gridmaxs);
+		AddPointToBounds(aasworld.areas[i].maxs, gridmins, gridmaxs);
+	} //end for
+	//cells at least as large as the reach distance but not many more cells than areas
+	cellsize = reachdist;
+	while ((gridmaxs[0] - gridmins[0]) * (gridmaxs[1] - gridmins[1]) >
+				cellsize * cellsize * 4 * aasworld.numareas)
+	{
+		cellsize *= 2;
+	} //end while
+	for (i = 0; i < 2; i++)
+	{
+		gridsize[i] = (int) ((gridmaxs[i] - gridmins[i]) / cellsize) + 1;
+	} //end for
+	//count the areas in every cell
+	firstcellarea = (int *) GetClearedMemory((gridsize[0] * gridsize[1] + 1) * sizeof(int));
+	for (i = 1; i < aasworld.numareas; i++)
+	{
+		area1 = &aasworld.areas[i];
+		AAS_ReachabilityGridCells(gridmins, cellsize, gridsize, area1->mins, area1->maxs, 0, cellmins, cellmaxs);
+		for (y = cellmins[1]; y <= cellmaxs[1]; y++)
+		{
+			for (x = cellmins[0]; x <= cellmaxs[0]; x++)
+			{
+				firstcellarea[y * gridsize[0] + x + 1]++;
+			} //end for
+		} //end for
+	} //end for
+	for (n = 0; n < gridsize[0] * gridsize[1]; n++)
+	{
+		firstcellarea[n + 1] += firstcellarea[n];
+	} //end for
+	//store the areas in every cell
+	cellareas = (int *) GetMemory(firstcellarea[gridsize[0] * gridsize[1]] * sizeof(int));
+	for (i = 1; i < aasworld.numareas; i++)
+	{
+		area1 = &aasworld.areas[i];
+		AAS_ReachabilityGridCells(gridmins, cellsize, gridsize, area1->mins, area1->maxs, 0, cellmins, cellmaxs);
+		for (y = cellmins[1]; y <= cellmaxs[1]; y++)
+		{
+			for (x = cellmins[0]; x <= cellmaxs[0]; x++)
+			{
+				cellareas[firstcellarea[y * gridsize[0] + x]++] = i;
+			} //end for
+		} //end for
+	} //end for
+	//the stores moved the cell starts to the next cell
+	for (n = gridsize[0] * gridsize[1]; n > 0; n--)
+	{
+		firstcellarea[n] = firstcellarea[n - 1];
+	} //end for
+	firstcellarea[0] = 0;
+	//
+	areastamp = (int *) GetClearedMemory(aasworld.numareas * sizeof(int));
+	for (i = 1; i < aasworld.numareas; i++)
+	{
+		firstreachcandidate[i] = numcandidates;
+		area1 = &aasworld.areas[i];
+		//one unit extra for rounding
+		AAS_ReachabilityGridCells(gridmins, cellsize, gridsize, area1->mins, area1->maxs, reachdist + 1, cellmins, cellmaxs);
+		for (y = cellmins[1]; y <= cellmaxs[1]; y++)
+		{
+			for (x = cellmins[0]; x <= cellmaxs[0]; x++)
+			{
+				n = y * gridsize[0] + x;
+				for (k = firstcellarea[n]; k < firstcellarea[n + 1]; k++)
+				{
+					j = cellareas[k];
+					//areas overlapping several cells are only tested once
+					if (areastamp[j] == i) continue;
+					areastamp[j] = i;
+					if (i == j) continue;
+					//never create reachabilities from teleporter or jumppad areas to regular areas
+					if (aasworld.areasettings[i].contents & (AREACONTENTS_TELEPORTER|AREACONTENTS_JUMPPAD))
+					{
+						if (!(aasworld.areasettings[j].contents & (AREACONTENTS_TELEPORTER|AREACONTENTS_JUMPPAD)))
+						{
+							continue;
+						} //end if
+					} //end if
+					//if the areas are not near anough in the x-y direction
+					area2 = &aasworld.areas[j];
+					if (area1->mins[0] > area2->maxs[0] + reachdist) continue;
+					if (area1->maxs[0] < area2->mins[0] - reachdist) continue;
+					if (area1->mins[1] > area2->maxs[1] + reachdist) continue;
+					if (area1->maxs[1] < area2->mins[1] - reachdist) continue;
+					//
+					if (numcandidates >= maxcandidates)
+					{
+						maxcandidates *= 2;
+						candidates = (int *) GetMemory(maxcandidates * sizeof(int));
+						Com_Memcpy(candidates, reachcandidates, numcandidates * sizeof(int));
+						FreeMemory(reachcandidates);
+						reachcandidates = candidates;
+					} //end if
+					reachcandidates[numcandidates++] = j;
+				} //end for
+			} //end for
+		} //end for
+		//test the areas in the same order as when testing every area
+		qsort(reachcandidates + firstreachcandidate[i], numcandidates - firstreachcandidate[i],
+					sizeof(int), AAS_CompareAreaNums);
+	} //end for
+	firstreachcandidate[aasworld.numareas] = numcandidates;
+	//
+	FreeMemory(areastamp);
+	FreeMemory(cellareas);
+	FreeMemory(firstcellarea);
+} //end of the function AAS_SetupReachabilityCandidates
+//===========================================================================
+// finds the swim, walk, step, barrier jump, water jump, walk off ledge and
+// jump reachabilities from the given area towards its candidate areas
+// these only depend on the two areas, so they are calculated ahead for all
+// areas in threads and AAS_ContinueInitReachability only keeps the links
+// towards areas that don't have a reachability yet
+// ladder reachabilities also link other areas and are left to
+// AAS_ContinueInitReachability
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		pendingreachability
+//===========================================================================
+void AAS_FindAreaReachabilities(int areanum)
+{
+	int i, j;
+	aas_lreachability_t *lreach, *nextlreach, *pending;
+
+	//area zero is a dummy
+	if (!areanum) return;
+	//only create jumppad reachabilities from jumppad areas
+	if (aasworld.areasettings[areanum].contents & AREACONTENTS_JUMPPAD) return;
+	//
+	for (i = firstreachcandidate[areanum]; i < firstreachcandidate[areanum + 1]; i++)
+	{
+		j = reachcandidates[i];
+		//left to AAS_ContinueInitReachability
+		if (AAS_AreaLadder(areanum) && AAS_AreaLadder(j)) continue;
+		//check for a swim reachability
+		if (AAS_Reachability_Swim(areanum, j)) continue;
+		//check for a simple walk on equal floor height reachability
+		if (AAS_Reachability_EqualFloorHeight(areanum, j)) continue;
+		//check for step, barrier, waterjump and walk off ledge reachabilities
+		if (AAS_Reachability_Step_Barrier_WaterJump_WalkOffLedge(areanum, j)) continue;
+		//check for a jump reachability
+		if (AAS_Reachability_Jump(areanum, j)) continue;
+	} //end for
+	//move the links to the pending list in the order they were found
+	pending = NULL;
+	for (lreach = areareachability[areanum]; lreach; lreach = nextlreach)
+	{
+		nextlreach = lreach->next;
+		lreach->next = pending;
+		pending = lreach;
+	} //end for
+	pendingreachability[areanum] = pending;
+	areareachability[areanum] = NULL;
+} //end of the function AAS_FindAreaReachabilities
+//===========================================================================
 //
 // TRAVEL_WALK					100%	equal floor height + steps
 // TRAVEL_CROUCH				100%
@@ -4358,7 +4596,8 @@ void AAS_StoreReachability(void)
 //===========================================================================
 int AAS_ContinueInitReachability(float time)
 {
-	int i, j, todo, start_time;
+	int i, j, k, todo, start_time;
+	aas_lreachability_t *pending, *nextpending;
 	static float framereachability, reachability_delay;
 	static int lastpercentage;
 
@@ -4372,6 +4611,12 @@ int AAS_ContinueInitReachability(float time)
 		lastpercentage = 0;
 		framereachability = 2000;
 		reachability_delay = 1000;
+#ifdef BSPC
+		//find the reachabilities that only depend on the two areas in threads
+		reachthreaded = true;
+		RunThreadsOnIndividual(aasworld.numareas, true, AAS_FindAreaReachabilities);
+		reachthreaded = false;
+#endif //BSPC
 	} //end if
 	//number of areas to calculate reachability for this cycle
 	todo = aasworld.numreachabilityareas + (int) framereachability;
@@ -4385,20 +4630,35 @@ int AAS_ContinueInitReachability(float time)
 		{
 			continue;
 		} //end if
-		//loop over the areas
-		for (j = 1; j < aasworld.numareas; j++)
+		pending = pendingreachability[i];
+		//loop over the areas close enough to reach
+		for (k = firstreachcandidate[i]; k < firstreachcandidate[i + 1]; k++)
 		{
-			if (i == j) continue;
-			//never create reachabilities from teleporter or jumppad areas to regular areas
-			if (aasworld.areasettings[i].contents & (AREACONTENTS_TELEPORTER|AREACONTENTS_JUMPPAD))
+			j = reachcandidates[k];
+			//if there already is a reachability link from area i to j
+			if (AAS_ReachabilityExists(i, j))
 			{
-				if (!(aasworld.areasettings[j].contents & (AREACONTENTS_TELEPORTER|AREACONTENTS_JUMPPAD)))
+				//drop the links found ahead
+				for (; pending && pending->areanum == j; pending = nextpending)
 				{
-					continue;
-				} //end if
+					nextpending = pending->next;
+					AAS_FreeReachability(pending);
+				} //end for
+				continue;
 			} //end if
-			//if there already is a reachability link from area i to j
-			if (AAS_ReachabilityExists(i, j)) continue;
+#ifdef BSPC
+			//only ladder reachabilities weren't found ahead by AAS_FindAreaReachabilities
+			if (!AAS_AreaLadder(i) || !AAS_AreaLadder(j))
+			{
+				for (; pending && pending->areanum == j; pending = nextpending)
+				{
+					nextpending = pending->next;
+					pending->next = areareachability[i];
+					areareachability[i] = pending;
+				} //end for
+				continue;
+			} //end if
+#endif //BSPC
 			//check for a swim reachability
 			if (AAS_Reachability_Swim(i, j)) continue;
 			//check for a simple walk on equal floor height reachability
@@ -4419,6 +4679,8 @@ int AAS_ContinueInitReachability(float time)
 		for (j = 1; j < aasworld.numareas; j++)
 		{
 			if (i == j) continue;
+			//without grapple only weapon jump areas can be reached
+			if (!calcgrapplereach && !(aasworld.areasettings[j].areaflags & AREA_WEAPONJUMP)) continue;
 			//
 			if (AAS_ReachabilityExists(i, j)) continue;
 			//check for a grapple hook reachability
@@ -4484,6 +4746,9 @@ int AAS_ContinueInitReachability(float time)
 		AAS_ShutDownReachabilityHeap();
 		//
 		FreeMemory(areareachability);
+		FreeMemory(pendingreachability);
+		FreeMemory(reachcandidates);
+		FreeMemory(firstreachcandidate);
 		//
 		aasworld.numreachabilityareas++;
 		//
@@ -4532,6 +4797,10 @@ void AAS_InitReachability(void)
 	//allocate area reachability link array
 	areareachability = (aas_lreachability_t **) GetClearedMemory(
 									aasworld.numareas * sizeof(aas_lreachability_t *));
+	pendingreachability = (aas_lreachability_t **) GetClearedMemory(
+									aasworld.numareas * sizeof(aas_lreachability_t *));
+	//
+	AAS_SetupReachabilityCandidates();
 	//
 	AAS_SetWeaponJumpAreaFlags();
 } //end of the function AAS_InitReachable
@@ -1510,111 +1510,28 @@ node_t *BuildTree_r (node_t *node, bspbrush_t *brushes)
 // Returns:				-
 // Changes Globals:		-
 //===========================================================================
-node_t *firstnode;		//first node in the list
-node_t *lastnode;			//last node in the list
-int nodelistsize;			//number of nodes in the list
-int use_nodequeue = 0;	//use nodequeue, otherwise a node stack is used
-int numwaiting = 0;
+//nodes with fewer brushes are split by the thread that created them
+#define MIN_TASK_BRUSHES		16
 
-void (*AddNodeToList)(node_t *node);
-
-//add the node to the front of the node list
-//(effectively using a node stack)
-void AddNodeToStack(node_t *node)
-{
-	ThreadLock();
-
-	node->next = firstnode;
-	firstnode = node;
-	if (!lastnode) lastnode = node;
-	nodelistsize++;
-
-	ThreadUnlock();
-	//
-	ThreadSemaphoreIncrease(1);
-} //end of the function AddNodeToStack
-//add the node to the end of the node list
-//(effectively using a node queue)
-void AddNodeToQueue(node_t *node)
-{
-	ThreadLock();
-
-	node->next = NULL;
-	if (lastnode) lastnode->next = node;
-	else firstnode = node;
-	lastnode = node;
-	nodelistsize++;
-
-	ThreadUnlock();
-	//
-	ThreadSemaphoreIncrease(1);
-} //end of the function AddNodeToQueue
-//get the first node from the front of the node list
-node_t *NextNodeFromList(void)
-{
-	node_t *node;
-
-	ThreadLock();
-	numwaiting++;
-	if (!firstnode)
-	{
-		if (numwaiting >= GetNumThreads()) ThreadSemaphoreIncrease(GetNumThreads());
-	} //end if
-	ThreadUnlock();
-
-	ThreadSemaphoreWait();
-
-	ThreadLock();
-
-	numwaiting--;
-
-	node = firstnode;
-	if (firstnode)
-	{
-		firstnode = firstnode->next;
-		nodelistsize--;
-	} //end if
-	if (!firstnode) lastnode = NULL;
-
-	ThreadUnlock();
-
-	return node;
-} //end of the function NextNodeFromList
-//returns the size of the node list
-int NodeListSize(void)
-{
-	int size;
-
-	ThreadLock();
-	size = nodelistsize;
-	ThreadUnlock();
-
-	return size;
-} //end of the function NodeListSize
-//
+//display the number of nodes processed so far
 void IncreaseNodeCounter(void)
 {
-	ThreadLock();
-	//if (verbose) printf("\r%6d", numrecurse++);
+	if (threaded) ThreadLock();
 	qprint_progress(++numrecurse);
-	//qprintf("\r%6d %d, %5d ", numrecurse++, GetNumThreads(), nodelistsize);
-	ThreadUnlock();
+	if (threaded) ThreadUnlock();
 } //end of the function IncreaseNodeCounter
-//thread function, gets nodes from the nodelist and processes them
-void BuildTreeThread(int threadid)
+//task function, splits the node and all nodes below it, children with
+//enough brushes are added as new tasks for the other threads
+void BuildTreeTask(void *data)
 {
 	node_t *newnode, *node;
 	side_t *bestside;
 	int i, totalmem;
 	bspbrush_t *brushes;
 
-	for (node = NextNodeFromList(); node; )
+	for (node = data; node; )
 	{
-		//if the nodelist isn't empty try to add another thread
-		//if (NodeListSize() > 10) AddThread(BuildTreeThread);
-		//display the number of nodes processed so far
-		if (numthreads == 1)
-			IncreaseNodeCounter();
+		IncreaseNodeCounter();
 
 		brushes = node->brushlist;
 
@@ -1647,7 +1564,12 @@ void BuildTreeThread(int threadid)
 		{
 			//create a leaf out of the node
 			LeafNode(node, brushes);
-			if (node->contents & CONTENTS_SOLID) c_solidleafnodes++;
+			if (node->contents & CONTENTS_SOLID)
+			{
+				if (threaded) ThreadLock();
+				c_solidleafnodes++;
+				if (threaded) ThreadUnlock();
+			} //end if
 			if (create_aas)
 			{
 				//free up memory!!!
@@ -1660,8 +1582,7 @@ void BuildTreeThread(int threadid)
 				FreeBrush(node->volume);
 				node->volume = NULL;
 			} //end if
-			node = NextNodeFromList();
-			continue;
+			break;
 		} //end if
 
 		// this is a splitplane node
@@ -1699,15 +1620,16 @@ void BuildTreeThread(int threadid)
 			FreeBrush(node->volume);
 			node->volume = NULL;
 		} //end if
-		//add both children to the node list
-		//AddNodeToList(node->children[0]);
-		AddNodeToList(node->children[1]);
+		//let another thread split the back child if it's worth the overhead
+		if (CountBrushList(node->children[1]->brushlist) >= MIN_TASK_BRUSHES)
+			AddTask(BuildTreeTask, node->children[1]);
+		else
+			BuildTreeTask(node->children[1]);
 		node = node->children[0];
-	} //end while
-	RemoveThread(threadid);
-} //end of the function BuildTreeThread
+	} //end for
+} //end of the function BuildTreeTask
 //===========================================================================
-// build the bsp tree using a node list
+// build the bsp tree with tasks run by all threads
 //
 // Parameter:			-
 // Returns:				-
@@ -1715,32 +1637,9 @@ void BuildTreeThread(int threadid)
 //===========================================================================
 void BuildTree(tree_t *tree)
 {
-	int i;
-
-	firstnode = NULL;
-	lastnode = NULL;
-	//use a node queue or node stack
-	if (use_nodequeue) AddNodeToList = AddNodeToQueue;
-	else AddNodeToList = AddNodeToStack;
-	//setup thread locking
-	ThreadSetupLock();
-	ThreadSetupSemaphore();
-	numwaiting = 0;
-	//
 	Log_Print("%6d threads max\n", numthreads);
-	if (use_nodequeue) Log_Print("breadth first bsp building\n");
-	else Log_Print("depth first bsp building\n");
 	qprintf("%6d splits", numrecurse);
-	//add the first node to the list
-	AddNodeToList(tree->headnode);
-	//start the threads
-	for (i = 0; i < numthreads; i++)
-		AddThread(BuildTreeThread);
-	//wait for all added threads to be finished
-	WaitForAllThreadsFinished();
-	//shutdown the thread locking
-	ThreadShutdownLock();
-	ThreadShutdownSemaphore();
+	RunTasks(BuildTreeTask, tree->headnode);
 } //end of the function BuildTree
 //===========================================================================
 // The incoming brush list will be freed before exiting
@@ -42,7 +42,6 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "aas_cfg.h"
 #include "be_aas_bspc.h"
 
-extern	int use_nodequeue;		//brushbsp.c
 extern	int calcgrapplereach;	//be_aas_reach.c
 extern	qboolean g_bsp2map220;	//map.c
 
@@ -210,8 +209,6 @@ void Win_Map2Bsp(char *bspfilename)
 	start = I_FloatTime();
 
 	ThreadSetDefault();
-	//yeah sure Carmack
-	//numthreads = 1;		// multiple threads aren't helping...
 
 	strcpy(source, ExpandArg(bspfilename));
 	StripExtension(source);
@@ -252,8 +249,6 @@ void Map2Bsp(char *mapfilename, char *outputfilename)
 	start = I_FloatTime ();
 
 	ThreadSetDefault ();
-	//yeah sure Carmack
-	//numthreads = 1;		//multiple threads aren't helping...
 	//SetQdirFromPath(bspfilename);
 
 	strcpy(source, ExpandArg(mapfilename));
@@ -664,8 +659,8 @@ int main (int argc, char **argv)
 		} //end else if
 		else if (!stricmp(argv[i], "-breadthfirst"))
 		{
-			use_nodequeue = true;
-			Log_Print("breadthfirst = true\n");
+			//obsolete, the bsp tree is built with tasks
+			Log_Print("breadthfirst is obsolete\n");
 		} //end else if
 		else if (!stricmp(argv[i], "-capsule"))
 		{
@@ -760,6 +755,9 @@ int main (int argc, char **argv)
 	//if there are parameters and there's no mismatch in one of the parameters
 	if (argc > 1 && i == argc)
 	{
+		//use all processors unless -threads was given
+		ThreadSetDefault();
+
 		switch(comp)
 		{
 		// ML090131 added: extract BSP texture info
@@ -1055,7 +1053,6 @@ int main (int argc, char **argv)
 			"   cfg         <filename>                  = use this cfg file\n"
 			"   optimize                                = enable optimization\n"
 			"   noverbose                               = disable verbose output\n"
-			"   breadthfirst                            = breadth first bsp building\n"
 			"   capsule                                 = use spherical collision model\n"
 			"   nobrushmerge                            = don't merge brushes\n"
 			"   noliquids                               = don't write liquids to map\n"
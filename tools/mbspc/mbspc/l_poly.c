@@ -26,9 +26,17 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "l_poly.h"
 #include "l_log.h"
 #include "l_mem.h"
+#include "l_threads.h"
 
 #define	BOGUS_RANGE		65535
 
+//freed windings are kept per thread in lists with 4, 8, 16... points
+//for reuse, larger windings go straight back to the heap
+#define MIN_WINDING_CACHE_POINTS	4
+#define NUM_WINDING_CACHE_LISTS		6
+
+THREADLOCAL winding_t *freewindings[NUM_WINDING_CACHE_LISTS];
+
 extern int numthreads;
 
 // counters are only bumped when running single threaded,
@@ -66,14 +74,41 @@ void ResetWindings(void)
 AllocWinding
 =============
 */
+int WindingCacheList(int points)
+{
+	int list, maxpoints;
+
+	maxpoints = MIN_WINDING_CACHE_POINTS;
+	for (list = 0; list < NUM_WINDING_CACHE_LISTS; list++)
+	{
+		if (points <= maxpoints) return list;
+		maxpoints <<= 1;
+	} //end for
+	return -1;
+} //end of the function WindingCacheList
+
 winding_t *AllocWinding (int points)
 {
 	winding_t	*w;
-	int			s;
+	int			s, list, maxpoints;
 
+	list = WindingCacheList(points);
+	if (list >= 0)
+	{
+		maxpoints = MIN_WINDING_CACHE_POINTS << list;
+		w = freewindings[list];
+		//the free list link is kept in the points, memcpy keeps the access free of aliasing
+		if (w) memcpy(&freewindings[list], w->p, sizeof(winding_t *));
+		else w = GetMemory(sizeof(*w) + sizeof(*w->p) * maxpoints);
+	} //end if
+	else
+	{
+		maxpoints = points;
+		w = GetMemory(sizeof(*w) + sizeof(*w->p) * maxpoints);
+	} //end else
 	s = sizeof(*w) + sizeof(*w->p) * points;
-	w = GetMemory(s);
 	memset(w, 0, s);
+	w->maxpoints = maxpoints;
 
 	if (numthreads == 1)
 	{
@@ -91,6 +126,8 @@ winding_t *AllocWinding (int points)
 
 void FreeWinding (winding_t *w)
 {
+	int list;
+
 	if (*(unsigned *)w == 0xdeaddead)
 		Error ("FreeWinding: freed a freed winding");
 
@@ -102,9 +139,34 @@ void FreeWinding (winding_t *w)
 
 	*(unsigned *)w = 0xdeaddead;
 
-	FreeMemory(w);
+	list = WindingCacheList(w->maxpoints);
+	if (list >= 0)
+	{
+		memcpy(w->p, &freewindings[list], sizeof(winding_t *));
+		freewindings[list] = w;
+	} //end if
+	else
+	{
+		FreeMemory(w);
+	} //end else
 } //end of the function FreeWinding
 
+void FreeThreadWindings(void)
+{
+	int list;
+	winding_t *w;
+
+	for (list = 0; list < NUM_WINDING_CACHE_LISTS; list++)
+	{
+		while(freewindings[list])
+		{
+			w = freewindings[list];
+			memcpy(&freewindings[list], w->p, sizeof(winding_t *));
+			FreeMemory(w);
+		} //end while
+	} //end for
+} //end of the function FreeThreadWindings
+
 int WindingMemory(void)
 {
 	return c_windingmemory;
@@ -325,8 +387,9 @@ winding_t *CopyWinding (winding_t *w)
 	winding_t	*c;
 
 	c = AllocWinding (w->numpoints);
-	size = sizeof(*w) + sizeof(*w->p) * w->numpoints;
-	memcpy (c, w, size);
+	size = sizeof(*w->p) * w->numpoints;
+	memcpy (c->p, w->p, size);
+	c->numpoints = w->numpoints;
 	return c;
 }
 
@@ -24,6 +24,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 typedef struct
 {
 	int		numpoints;
+	int		maxpoints;		//number of points allocated
 	vec3_t	p[];
 } winding_t;
 
@@ -71,6 +72,8 @@ void RemoveColinearPoints(winding_t *w);
 int WindingOnPlaneSide(winding_t *w, vec3_t normal, vec_t dist);
 //frees the winding
 void FreeWinding(winding_t *w);
+//frees the windings cached for reuse by the calling thread
+void FreeThreadWindings(void);
 //gets the bounds of the winding
 void WindingBounds(winding_t *w, vec3_t mins, vec3_t maxs);
 //chops the winding with the given plane, the original winding is freed if clipped
@@ -21,6 +21,8 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 */
 
 #include "l_cmd.h"
+#include "l_math.h"
+#include "l_poly.h"
 #include "l_threads.h"
 #include "l_log.h"
 #include "l_mem.h"
@@ -36,6 +38,18 @@ qboolean pacifier;
 qboolean	threaded;
 void (*workfunction) (int);
 
+//task for RunTasks
+typedef struct task_s
+{
+	void (*func)(void *data);
+	void *data;
+	struct task_s *next;
+} task_t;
+
+task_t *firsttask;			//stack with tasks waiting to be run
+int numactivetasks;			//number of tasks being run
+qboolean taskthreaded;		//true while tasks are run in threads
+
 //===========================================================================
 //
 // Parameter:				-
@@ -128,11 +142,13 @@ thread_t *lastthread;
 int currentnumthreads;
 int currentthreadid;
 
-int numthreads = 1;
+int numthreads = -1;
 CRITICAL_SECTION crit;
 HANDLE semaphore;
 static int enter;
 static int numwaitingthreads = 0;
+CRITICAL_SECTION taskcrit;
+CONDITION_VARIABLE taskcond;
 
 //===========================================================================
 //
@@ -148,7 +164,7 @@ void ThreadSetDefault(void)
 	{
 		GetSystemInfo (&info);
 		numthreads = info.dwNumberOfProcessors;
-		if (numthreads < 1 || numthreads > 32)
+		if (numthreads < 1 || numthreads > MAX_THREADS)
 			numthreads = 1;
 	} //end if
 	qprintf ("%i threads\n", numthreads);
@@ -437,6 +453,124 @@ int GetNumThreads(void)
 	return currentnumthreads;
 } //end of the function GetNumThreads
 
+//===========================================================================
+// runs tasks until all tasks are done
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+DWORD WINAPI TaskWorkerFunction(LPVOID unused)
+{
+	task_t *task;
+
+	EnterCriticalSection(&taskcrit);
+	while(1)
+	{
+		task = firsttask;
+		if (task)
+		{
+			firsttask = task->next;
+			numactivetasks++;
+			LeaveCriticalSection(&taskcrit);
+			//
+			task->func(task->data);
+			FreeMemory(task);
+			//
+			EnterCriticalSection(&taskcrit);
+			numactivetasks--;
+			//wake up the waiting threads when all tasks are done
+			if (!numactivetasks && !firsttask) WakeAllConditionVariable(&taskcond);
+		} //end if
+		else if (numactivetasks)
+		{
+			//wait for tasks added by the running tasks
+			SleepConditionVariableCS(&taskcond, &taskcrit, INFINITE);
+		} //end else if
+		else
+		{
+			break;
+		} //end else
+	} //end while
+	LeaveCriticalSection(&taskcrit);
+	//
+	FreeThreadWindings();
+	return 0;
+} //end of the function TaskWorkerFunction
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void RunTasks(void (*func)(void *data), void *data)
+{
+	int i;
+	HANDLE threadhandle[MAX_THREADS];
+
+	if (numthreads == -1)
+		ThreadSetDefault();
+	if (numthreads < 1 || numthreads > MAX_THREADS) numthreads = 1;
+	//
+	if (numthreads == 1)
+	{
+		func(data);
+		return;
+	} //end if
+	//
+	InitializeCriticalSection(&crit);
+	InitializeCriticalSection(&taskcrit);
+	InitializeConditionVariable(&taskcond);
+	firsttask = NULL;
+	numactivetasks = 0;
+	taskthreaded = true;
+	threaded = true;
+	AddTask(func, data);
+	//this thread is one of the workers
+	for (i = 1; i < numthreads; i++)
+	{
+		threadhandle[i] = CreateThread(NULL, 0, TaskWorkerFunction, NULL, 0, NULL);
+		if (!threadhandle[i])
+			Error("CreateThread failed");
+	} //end for
+	TaskWorkerFunction(NULL);
+	for (i = 1; i < numthreads; i++)
+	{
+		WaitForSingleObject(threadhandle[i], INFINITE);
+		CloseHandle(threadhandle[i]);
+	} //end for
+	threaded = false;
+	taskthreaded = false;
+	DeleteCriticalSection(&taskcrit);
+	DeleteCriticalSection(&crit);
+} //end of the function RunTasks
+//===========================================================================
+// without threads the task is run right away
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void AddTask(void (*func)(void *data), void *data)
+{
+	task_t *task;
+
+	if (!taskthreaded)
+	{
+		func(data);
+		return;
+	} //end if
+	task = GetMemory(sizeof(task_t));
+	task->func = func;
+	task->data = data;
+	//
+	EnterCriticalSection(&taskcrit);
+	task->next = firsttask;
+	firsttask = task;
+	WakeConditionVariable(&taskcond);
+	LeaveCriticalSection(&taskcrit);
+} //end of the function AddTask
+
 #endif // _WIN32 ***********************************************************
 
 
@@ -444,22 +578,25 @@ int GetNumThreads(void)
 
 //===================================================================
 //
-// LINUX
+// POSIX threads
 //
 //===================================================================
 
-#if defined(LINUX)
+#if !defined(_WIN32)
 
 #define	MULTI_THREAD
 
 #include <pthread.h>
 #include <semaphore.h>
+#include <stdint.h>
+#include <unistd.h>
 
 typedef struct thread_s
 {
 	pthread_t thread;
 	int threadid;
 	int id;
+	void (*func)(int);
 	struct thread_s *next;
 } thread_t;
 
@@ -468,11 +605,13 @@ thread_t *lastthread;
 int currentnumthreads;
 int currentthreadid;
 
-int numthreads = 1;
+int numthreads = -1;
 pthread_mutex_t my_mutex = PTHREAD_MUTEX_INITIALIZER;
 pthread_attr_t	attrib;
 sem_t semaphore;
 static int enter;
+pthread_mutex_t task_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t task_cond = PTHREAD_COND_INITIALIZER;
 
 
 //===========================================================================
@@ -485,7 +624,9 @@ void ThreadSetDefault(void)
 {
 	if (numthreads == -1)	// not set manually
 	{
-		numthreads = 1;
+		numthreads = sysconf(_SC_NPROCESSORS_ONLN);
+		if (numthreads < 1 || numthreads > MAX_THREADS)
+			numthreads = 1;
 	} //end if
 	qprintf("%i threads\n", numthreads);
 } //end of the function ThreadSetDefault
@@ -600,6 +741,30 @@ void ThreadSemaphoreIncrease(int count)
 // Returns:					-
 // Changes Globals:		-
 //===========================================================================
+void (*threadfunction)(int);
+
+void *ThreadStart(void *threadnum)
+{
+	threadfunction((int) (intptr_t) threadnum);
+	return NULL;
+} //end of the function ThreadStart
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void *AddedThreadStart(void *thread)
+{
+	((thread_t *) thread)->func(((thread_t *) thread)->threadid);
+	return NULL;
+} //end of the function AddedThreadStart
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
 void RunThreadsOn(int workcnt, qboolean showpacifier, void(*func)(int))
 {
 	int		i;
@@ -621,15 +786,16 @@ void RunThreadsOn(int workcnt, qboolean showpacifier, void(*func)(int))
 	if (pacifier)
 		setbuf (stdout, NULL);
 
+	threadfunction = func;
 	for (i=0 ; i<numthreads ; i++)
 	{
-		if (pthread_create(&work_threads[i], NULL, (void *)func, (void *)i) == -1)
+		if (pthread_create(&work_threads[i], NULL, ThreadStart, (void *) (intptr_t) i))
 			Error ("pthread_create failed");
 	}
 
 	for (i=0 ; i<numthreads ; i++)
 	{
-		if (pthread_join(work_threads[i], &pthread_return) == -1)
+		if (pthread_join(work_threads[i], &pthread_return))
 			Error ("pthread_join failed");
 	}
 
@@ -670,7 +836,8 @@ void AddThread(void (*func)(int))
 		//
 		thread->threadid = currentthreadid;
 
-		if (pthread_create(&thread->thread, NULL, (void *)func, (void *)thread->threadid) == -1)
+		thread->func = func;
+		if (pthread_create(&thread->thread, NULL, AddedThreadStart, thread))
 			Error ("pthread_create failed");
 
 		//add the thread to the end of the list
@@ -732,16 +899,17 @@ void RemoveThread(int threadid)
 //===========================================================================
 void WaitForAllThreadsFinished(void)
 {
-	pthread_t *thread;
+	pthread_t thread;
 	void *pthread_return;
 
 	ThreadLock();
 	while(firstthread)
 	{
-		thread = &firstthread->thread;
+		//copy the handle, the thread frees its thread_t when it finishes
+		thread = firstthread->thread;
 		ThreadUnlock();
 
-		if (pthread_join(*thread, &pthread_return) == -1)
+		if (pthread_join(thread, &pthread_return))
 			Error("pthread_join failed");
 
 		ThreadLock();
@@ -759,7 +927,119 @@ int GetNumThreads(void)
 	return currentnumthreads;
 } //end of the function GetNumThreads
 
-#endif //LINUX
+//===========================================================================
+// runs tasks until all tasks are done
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void *TaskWorkerFunction(void *unused)
+{
+	task_t *task;
+
+	pthread_mutex_lock(&task_mutex);
+	while(1)
+	{
+		task = firsttask;
+		if (task)
+		{
+			firsttask = task->next;
+			numactivetasks++;
+			pthread_mutex_unlock(&task_mutex);
+			//
+			task->func(task->data);
+			FreeMemory(task);
+			//
+			pthread_mutex_lock(&task_mutex);
+			numactivetasks--;
+			//wake up the waiting threads when all tasks are done
+			if (!numactivetasks && !firsttask) pthread_cond_broadcast(&task_cond);
+		} //end if
+		else if (numactivetasks)
+		{
+			//wait for tasks added by the running tasks
+			pthread_cond_wait(&task_cond, &task_mutex);
+		} //end else if
+		else
+		{
+			break;
+		} //end else
+	} //end while
+	pthread_mutex_unlock(&task_mutex);
+	//
+	FreeThreadWindings();
+	return NULL;
+} //end of the function TaskWorkerFunction
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void RunTasks(void (*func)(void *data), void *data)
+{
+	int i;
+	pthread_t work_threads[MAX_THREADS];
+
+	if (numthreads == -1)
+		ThreadSetDefault();
+	if (numthreads < 1 || numthreads > MAX_THREADS) numthreads = 1;
+	//
+	if (numthreads == 1)
+	{
+		func(data);
+		return;
+	} //end if
+	//
+	firsttask = NULL;
+	numactivetasks = 0;
+	taskthreaded = true;
+	threaded = true;
+	AddTask(func, data);
+	//this thread is one of the workers
+	for (i = 1; i < numthreads; i++)
+	{
+		if (pthread_create(&work_threads[i], NULL, TaskWorkerFunction, NULL))
+			Error("pthread_create failed");
+	} //end for
+	TaskWorkerFunction(NULL);
+	for (i = 1; i < numthreads; i++)
+	{
+		if (pthread_join(work_threads[i], NULL))
+			Error("pthread_join failed");
+	} //end for
+	threaded = false;
+	taskthreaded = false;
+} //end of the function RunTasks
+//===========================================================================
+// without threads the task is run right away
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void AddTask(void (*func)(void *data), void *data)
+{
+	task_t *task;
+
+	if (!taskthreaded)
+	{
+		func(data);
+		return;
+	} //end if
+	task = GetMemory(sizeof(task_t));
+	task->func = func;
+	task->data = data;
+	//
+	pthread_mutex_lock(&task_mutex);
+	task->next = firsttask;
+	firsttask = task;
+	pthread_cond_signal(&task_cond);
+	pthread_mutex_unlock(&task_mutex);
+} //end of the function AddTask
+
+#endif //!_WIN32
 
 
 
@@ -923,4 +1203,25 @@ int GetNumThreads(void)
 	return currentnumthreads;
 } //end of the function GetNumThreads
 
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void RunTasks(void (*func)(void *data), void *data)
+{
+	func(data);
+} //end of the function RunTasks
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void AddTask(void (*func)(void *data), void *data)
+{
+	func(data);
+} //end of the function AddTask
+
 #endif // MULTI_THREAD
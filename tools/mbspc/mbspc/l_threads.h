@@ -21,6 +21,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 */
 
 extern int numthreads;
+extern qboolean threaded;		//true while the lock can be used
 
 void ThreadSetDefault (void);
 int GetThreadWork (void);
@@ -42,4 +43,14 @@ void AddThread(void (*func)(int));
 void RemoveThread(int threadid);
 void WaitForAllThreadsFinished(void);
 int GetNumThreads(void);
+//task-parallel recursion, tasks added while running are run by any of the threads
+void RunTasks(void (*func)(void *data), void *data);
+void AddTask(void (*func)(void *data), void *data);
+
+//thread local storage
+#ifdef _MSC_VER
+#define THREADLOCAL		__declspec(thread)
+#else
+#define THREADLOCAL		__thread
+#endif
 
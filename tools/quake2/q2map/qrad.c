@@ -185,12 +185,54 @@ qboolean PvsForOrigin( vec3_t org, byte *pvs ){
 
 /*
    =============
-   MakeTransfers
+   AllocTransfers
 
+   Transfer lists are carved out of large blocks
+   instead of being malloced one per patch
    =============
  */
+#define TRANSFER_BLOCK_SIZE ( 1 << 20 )
+
+typedef struct transferblock_s
+{
+	struct transferblock_s *next;
+	int used;
+	transfer_t transfers[TRANSFER_BLOCK_SIZE];
+} transferblock_t;
+
+transferblock_t *transferblocks;
 int total_transfer;
 
+transfer_t *AllocTransfers( int count ){
+	transferblock_t *block;
+	transfer_t  *t;
+
+	ThreadLock();
+	block = transferblocks;
+	if ( !block || block->used + count > TRANSFER_BLOCK_SIZE ) {
+		block = malloc( sizeof( *block ) );
+		if ( !block ) {
+			Error( "Memory allocation failure" );
+		}
+		block->next = transferblocks;
+		block->used = 0;
+		transferblocks = block;
+	}
+	t = block->transfers + block->used;
+	block->used += count;
+	total_transfer += count;
+	ThreadUnlock();
+
+	return t;
+}
+
+/*
+   =============
+   MakeTransfers
+
+   =============
+ */
+
 void MakeTransfers( int i ){
 	int j;
 	vec3_t delta;
@@ -202,7 +244,6 @@ void MakeTransfers( int i ){
 	dplane_t plane;
 	vec3_t origin;
 	float transfers[MAX_PATCHES];
-	int s;
 	int itotal;
 	byte pvs[( MAX_MAP_LEAFS + 7 ) / 8];
 	int cluster;
@@ -283,11 +324,7 @@ void MakeTransfers( int i ){
 		if ( patch->numtransfers < 0 || patch->numtransfers > MAX_PATCHES ) {
 			Error( "Weird numtransfers" );
 		}
-		s = patch->numtransfers * sizeof( transfer_t );
-		patch->transfers = malloc( s );
-		if ( !patch->transfers ) {
-			Error( "Memory allocation failure" );
-		}
+		patch->transfers = AllocTransfers( patch->numtransfers );
 
 		//
 		// normalize all transfers so all of the light
@@ -308,8 +345,6 @@ void MakeTransfers( int i ){
 		}
 	}
 
-	// don't bother locking around this.  not that important.
-	total_transfer += patch->numtransfers;
 }
 
 
@@ -320,12 +355,18 @@ void MakeTransfers( int i ){
  */
 void FreeTransfers( void ){
 	int i;
+	transferblock_t *block;
 
 	for ( i = 0 ; i < num_patches ; i++ )
 	{
-		free( patches[i].transfers );
 		patches[i].transfers = NULL;
 	}
+	while ( transferblocks )
+	{
+		block = transferblocks->next;
+		free( transferblocks );
+		transferblocks = block;
+	}
 }
 
 
@@ -452,10 +493,13 @@ float CollectLight( void ){
    ShootLight
 
    Send light out to other patches
+   each thread adds into its own copy of illumination
    Run multi-threaded
    =============
  */
-void ShootLight( int patchnum ){
+vec3_t      *thread_illumination;   // [numthreads - 1][num_patches], thread 0 uses illumination
+
+void ShootLight( int patchnum, vec3_t *target ){
 	int k, l;
 	transfer_t  *trans;
 	int num;
@@ -475,7 +519,38 @@ void ShootLight( int patchnum ){
 	for ( k = 0 ; k < num ; k++, trans++ )
 	{
 		for ( l = 0 ; l < 3 ; l++ )
-			illumination[trans->patch][l] += send[l] * trans->transfer;
+			target[trans->patch][l] += send[l] * trans->transfer;
+	}
+}
+
+void ShootLightThread( int threadnum ){
+	int work;
+	vec3_t      *target;
+
+	target = threadnum == 0 ? illumination : thread_illumination + ( threadnum - 1 ) * num_patches;
+	while ( ( work = GetThreadWork() ) != -1 )
+		ShootLight( work, target );
+}
+
+/*
+   =============
+   ReduceThreadLight
+
+   Adds the light the other threads shot into illumination
+   =============
+ */
+void ReduceThreadLight( void ){
+	int i, t;
+	vec3_t      *target;
+
+	for ( t = 1 ; t < numthreads ; t++ )
+	{
+		target = thread_illumination + ( t - 1 ) * num_patches;
+		for ( i = 0 ; i < num_patches ; i++ )
+		{
+			VectorAdd( illumination[i], target[i], illumination[i] );
+			VectorClear( target[i] );
+		}
 	}
 }
 
@@ -500,9 +575,22 @@ void BounceLight( void ){
 		}
 	}
 
+	if ( numthreads == -1 ) {
+		ThreadSetDefault();
+	}
+	if ( numthreads > 1 ) {
+		thread_illumination = calloc( ( numthreads - 1 ) * num_patches, sizeof( vec3_t ) );
+		if ( !thread_illumination ) {
+			Error( "Memory allocation failure" );
+		}
+		Sys_FPrintf( SYS_VRB, "thread illumination: %5.1f megs\n"
+					 , (float)( numthreads - 1 ) * num_patches * sizeof( vec3_t ) / ( 1024 * 1024 ) );
+	}
+
 	for ( i = 0 ; i < numbounce ; i++ )
 	{
-		RunThreadsOnIndividual( num_patches, false, ShootLight );
+		RunThreadsOn( num_patches, false, ShootLightThread );
+		ReduceThreadLight();
 		added = CollectLight();
 
 		Sys_FPrintf( SYS_VRB, "bounce:%i added:%f\n", i, added );
@@ -511,6 +599,9 @@ void BounceLight( void ){
 			WriteWorld( name );
 		}
 	}
+
+	free( thread_illumination );
+	thread_illumination = NULL;
 }
 
 
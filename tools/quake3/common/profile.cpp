@@ -0,0 +1,263 @@
+/*
+   Copyright (C) 1999-2006 Id Software, Inc. and contributors.
+   For a list of contributors, see the accompanying CONTRIBUTORS file.
+
+   This file is part of GtkRadiant.
+
+   GtkRadiant is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   GtkRadiant is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GtkRadiant; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "profile.h"
+#include "cmdlib.h"
+#include "inout.h"
+#include "qthreads.h"
+#include "timer.h"
+
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/prettywriter.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+#ifdef WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+bool profiling;
+
+
+struct ProfileStageInfo
+{
+	std::string name;
+	int parent;
+	int calls = 0;
+	double wall = 0;
+	double cpu = 0;
+	double peakMemory = 0;
+	double threadWall = 0;                      /* wall time of threaded work */
+	std::vector<double> threadBusy;             /* per thread */
+	std::vector<std::pair<std::string, double>> counters;
+	/* open call */
+	Timer timer;
+	double cpuStart;
+};
+
+static std::vector<ProfileStageInfo> stages;
+static std::vector<int> openStages;
+static Timer profileTimer;
+
+
+/*
+   ProfileCPUTime()
+   user + system time of the process in seconds
+ */
+
+static double ProfileCPUTime(){
+#ifdef WIN32
+	FILETIME creation, exit, kernel, user;
+	if ( GetProcessTimes( GetCurrentProcess(), &creation, &exit, &kernel, &user ) ) {
+		const auto seconds = []( const FILETIME& time ){
+			return ( ( std::uint64_t( time.dwHighDateTime ) << 32 ) | time.dwLowDateTime ) * 1e-7;
+		};
+		return seconds( kernel ) + seconds( user );
+	}
+	return 0;
+#else
+	rusage usage;
+	getrusage( RUSAGE_SELF, &usage );
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + ( usage.ru_utime.tv_usec + usage.ru_stime.tv_usec ) * 1e-6;
+#endif
+}
+
+/*
+   ProfilePeakMemory()
+   peak resident memory of the process in bytes
+ */
+
+static double ProfilePeakMemory(){
+#ifdef WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if ( K32GetProcessMemoryInfo( GetCurrentProcess(), &counters, sizeof( counters ) ) ) {
+		return counters.PeakWorkingSetSize;
+	}
+	return 0;
+#else
+	rusage usage;
+	getrusage( RUSAGE_SELF, &usage );
+#if defined( __APPLE__ )
+	return usage.ru_maxrss;
+#else
+	return usage.ru_maxrss * 1024.0;
+#endif
+#endif
+}
+
+
+ProfileStage::ProfileStage( const char *name ) : m_stage( -1 ){
+	if ( !profiling ) {
+		return;
+	}
+
+	const int parent = openStages.empty()? -1 : openStages.back();
+	for ( size_t i = 0; i < stages.size(); ++i )
+		if ( stages[ i ].parent == parent && stages[ i ].name == name )
+			m_stage = i;
+	if ( m_stage < 0 ) {
+		m_stage = stages.size();
+		stages.push_back( ProfileStageInfo{ name, parent } );
+	}
+
+	ProfileStageInfo& stage = stages[ m_stage ];
+	stage.calls++;
+	stage.timer.start();
+	stage.cpuStart = ProfileCPUTime();
+	openStages.push_back( m_stage );
+}
+
+ProfileStage::~ProfileStage(){
+	if ( m_stage < 0 ) {
+		return;
+	}
+
+	ProfileStageInfo& stage = stages[ m_stage ];
+	stage.wall += stage.timer.elapsed_sec();
+	stage.cpu += ProfileCPUTime() - stage.cpuStart;
+	stage.peakMemory = ProfilePeakMemory();
+	openStages.pop_back();
+}
+
+void ProfileCount( const char *name, double value ){
+	if ( !profiling || openStages.empty() ) {
+		return;
+	}
+
+	auto& counters = stages[ openStages.back() ].counters;
+	for ( auto& [ key, sum ] : counters )
+	{
+		if ( key == name ) {
+			sum += value;
+			return;
+		}
+	}
+	counters.emplace_back( name, value );
+}
+
+void ProfileThreads( const double *busy, int count, double wall ){
+	if ( !profiling || openStages.empty() ) {
+		return;
+	}
+
+	ProfileStageInfo& stage = stages[ openStages.back() ];
+	if ( int( stage.threadBusy.size() ) < count ) {
+		stage.threadBusy.resize( count );
+	}
+	for ( int i = 0; i < count; ++i )
+		stage.threadBusy[ i ] += busy[ i ];
+	stage.threadWall += wall;
+}
+
+
+/*
+   ProfileWrite()
+   writes the json report
+ */
+
+static void ProfileWriteStage( rapidjson::PrettyWriter<rapidjson::StringBuffer>& writer, int index ){
+	const ProfileStageInfo& stage = stages[ index ];
+
+	writer.StartObject();
+	writer.Key( "name" );
+	writer.String( stage.name.c_str() );
+	writer.Key( "calls" );
+	writer.Int( stage.calls );
+	writer.Key( "wall" );
+	writer.Double( stage.wall );
+	writer.Key( "cpu" );
+	writer.Double( stage.cpu );
+	writer.Key( "peakMemory" );
+	writer.Double( stage.peakMemory );
+
+	if ( !stage.threadBusy.empty() ) {
+		/* idle is time a thread waited for others to finish threaded work */
+		writer.Key( "threadWall" );
+		writer.Double( stage.threadWall );
+		writer.Key( "threadBusy" );
+		writer.StartArray();
+		for ( const double busy : stage.threadBusy )
+			writer.Double( busy );
+		writer.EndArray();
+		writer.Key( "threadIdle" );
+		writer.StartArray();
+		for ( const double busy : stage.threadBusy )
+			writer.Double( busy < stage.threadWall? stage.threadWall - busy : 0 );
+		writer.EndArray();
+	}
+
+	if ( !stage.counters.empty() ) {
+		writer.Key( "counters" );
+		writer.StartObject();
+		for ( const auto& [ name, value ] : stage.counters )
+		{
+			writer.Key( name.c_str() );
+			writer.Double( value );
+			writer.Key( ( name + "PerSecond" ).c_str() );
+			writer.Double( stage.wall > 0? value / stage.wall : 0 );
+		}
+		writer.EndObject();
+	}
+
+	writer.Key( "stages" );
+	writer.StartArray();
+	for ( size_t i = 0; i < stages.size(); ++i )
+		if ( stages[ i ].parent == index )
+			ProfileWriteStage( writer, i );
+	writer.EndArray();
+
+	writer.EndObject();
+}
+
+void ProfileWrite( const char *filename ){
+	if ( !profiling ) {
+		return;
+	}
+
+	rapidjson::StringBuffer buffer;
+	rapidjson::PrettyWriter<rapidjson::StringBuffer> writer( buffer );
+	writer.SetFormatOptions( rapidjson::kFormatSingleLineArray );
+
+	writer.StartObject();
+	writer.Key( "threads" );
+	writer.Int( numthreads );
+	writer.Key( "wall" );
+	writer.Double( profileTimer.elapsed_sec() );
+	writer.Key( "cpu" );
+	writer.Double( ProfileCPUTime() );
+	writer.Key( "peakMemory" );
+	writer.Double( ProfilePeakMemory() );
+	writer.Key( "stages" );
+	writer.StartArray();
+	for ( size_t i = 0; i < stages.size(); ++i )
+		if ( stages[ i ].parent < 0 )
+			ProfileWriteStage( writer, i );
+	writer.EndArray();
+	writer.EndObject();
+
+	Sys_Printf( "Writing %s\n", filename );
+	SaveFile( filename, buffer.GetString(), buffer.GetSize() );
+}
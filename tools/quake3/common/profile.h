@@ -0,0 +1,47 @@
+/*
+   Copyright (C) 1999-2006 Id Software, Inc. and contributors.
+   For a list of contributors, see the accompanying CONTRIBUTORS file.
+
+   This file is part of GtkRadiant.
+
+   GtkRadiant is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   GtkRadiant is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GtkRadiant; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#pragma once
+
+/* -profile: wall and cpu time of named stages, thread load of their threaded work and counters;
+   written as json by ProfileWrite() */
+
+extern bool profiling;
+
+/* times enclosing scope as a stage, nested stages are reported as children of the innermost open one;
+   stages of equal name and parent are accumulated; does nothing unless profiling */
+class ProfileStage
+{
+	int m_stage;
+public:
+	ProfileStage( const char *name );
+	~ProfileStage();
+	ProfileStage( const ProfileStage& ) = delete;
+	ProfileStage& operator=( const ProfileStage& ) = delete;
+};
+
+/* adds to a counter of the innermost open stage, also reported per second of its wall time */
+void ProfileCount( const char *name, double value );
+
+/* called by RunThreadsOn() with busy time of each thread */
+void ProfileThreads( const double *busy, int count, double wall );
+
+void ProfileWrite( const char *filename );
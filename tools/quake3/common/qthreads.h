@@ -25,5 +25,7 @@ extern int numthreads;
 
 void ThreadSetDefault();
 void RunThreadsOnIndividual( int workcnt, bool showpacifier, void ( *func )( int ) );
+/* lock free work stealing variant; optional order[ workcnt ] lists work items from most to least expensive (ignored when single threaded) */
+void RunThreadsOnIndividualStealing( int workcnt, bool showpacifier, void ( *func )( int ), const int *order = nullptr );
 void ThreadLock();
 void ThreadUnlock();
@@ -22,6 +22,7 @@
 #include "cmdlib.h"
 #include "inout.h"
 #include "qthreads.h"
+#include "profile.h"
 #include "timer.h"
 
 #define MAX_THREADS 64
@@ -109,10 +110,187 @@ void RunThreadsOnIndividual( int workcnt, bool showpacifier, void ( *func )( int
 }
 
 
+/*
+   =============
+   work stealing dispatcher
+
+   each thread owns a range of work positions packed in one atomic word (begin | end << 32)
+   it takes chunks from the front of its own range and, once drained, steals the back half
+   of the fullest range of another thread; no global lock is taken for dispatch
+   work items are dealt round-robin to the ranges, so every thread walks the items
+   (or the caller supplied order) roughly front to back, the same as GetThreadWork did
+   =============
+ */
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+struct alignas( 64 ) StealingRange
+{
+	std::atomic<uint64_t> range;
+};
+
+static inline uint64_t StealingRange_pack( uint32_t begin, uint32_t end ){
+	return uint64_t( end ) << 32 | begin;
+}
+static inline uint32_t StealingRange_begin( uint64_t range ){
+	return uint32_t( range );
+}
+static inline uint32_t StealingRange_end( uint64_t range ){
+	return uint32_t( range >> 32 );
+}
+
+#define STEALING_CHUNK_DIVISOR  8   /* take 1/8 of the remaining own range at once */
+
+static std::vector<StealingRange> stealingRanges;
+static std::vector<int> stealingWork;           /* position -> work item */
+static std::atomic<int> stealingDone;
+static std::atomic<int> stealingPacified;
+static std::mutex stealingPacifierLock;
+
+/* progress is derived from the atomic completion counter; whoever gets the pacifier lock prints, others go on working */
+static void StealingPacifier(){
+	if ( !pacifier ) {
+		return;
+	}
+	const int f = std::min( int( int64_t( 40 ) * stealingDone.load( std::memory_order_relaxed ) / workcount ), 39 );
+	if ( f <= stealingPacified.load( std::memory_order_relaxed ) || !stealingPacifierLock.try_lock() ) {
+		return;
+	}
+	for ( int tick = stealingPacified.load( std::memory_order_relaxed ) + 1; tick <= f; ++tick )
+	{
+		if ( tick % 4 == 0 ) {
+			Sys_Printf( "%i", tick / 4 );
+		}
+		else{
+			Sys_Printf( "." );
+		}
+		stealingPacified.store( tick, std::memory_order_relaxed );
+	}
+	fflush( stdout );
+	stealingPacifierLock.unlock();
+}
+
+static bool StealingPop( int threadnum, uint32_t& begin, uint32_t& end ){
+	std::atomic<uint64_t>& own = stealingRanges[threadnum].range;
+	uint64_t range = own.load( std::memory_order_acquire );
+	while ( StealingRange_begin( range ) < StealingRange_end( range ) )
+	{
+		const uint32_t b = StealingRange_begin( range );
+		const uint32_t e = StealingRange_end( range );
+		const uint32_t chunk = std::max( ( e - b ) / STEALING_CHUNK_DIVISOR, 1u );
+		if ( own.compare_exchange_weak( range, StealingRange_pack( b + chunk, e ), std::memory_order_acq_rel ) ) {
+			begin = b;
+			end = b + chunk;
+			return true;
+		}
+	}
+	return false;
+}
+
+/* moves the back half of the fullest other range into the (empty) own range */
+static bool StealingSteal( int threadnum ){
+	while ( true )
+	{
+		int victim = -1;
+		uint64_t victimRange = 0;
+		uint32_t most = 0;
+		for ( int i = 0; i < int( stealingRanges.size() ); ++i )
+		{
+			if ( i == threadnum ) {
+				continue;
+			}
+			const uint64_t range = stealingRanges[i].range.load( std::memory_order_acquire );
+			const uint32_t remaining = StealingRange_end( range ) - StealingRange_begin( range );
+			if ( remaining > most ) {
+				most = remaining;
+				victim = i;
+				victimRange = range;
+			}
+		}
+		if ( victim == -1 ) {
+			return false;
+		}
+
+		const uint32_t b = StealingRange_begin( victimRange );
+		const uint32_t e = StealingRange_end( victimRange );
+		const uint32_t mid = b + most / 2;
+		if ( stealingRanges[victim].range.compare_exchange_strong( victimRange, StealingRange_pack( b, mid ), std::memory_order_acq_rel ) ) {
+			stealingRanges[threadnum].range.store( StealingRange_pack( mid, e ), std::memory_order_release );
+			return true;
+		}
+	}
+}
+
+static void StealingWorkerFunction( int threadnum ){
+	uint32_t begin, end;
+	while ( StealingPop( threadnum, begin, end ) || ( StealingSteal( threadnum ) && StealingPop( threadnum, begin, end ) ) )
+	{
+		for ( uint32_t i = begin; i < end; ++i )
+			workfunction( stealingWork[i] );
+
+		stealingDone.fetch_add( end - begin, std::memory_order_relaxed );
+		StealingPacifier();
+	}
+}
+
+void RunThreadsOnIndividualStealing( int workcnt, bool showpacifier, void ( *func )( int ), const int *order ){
+	if ( numthreads == -1 ) {
+		ThreadSetDefault();
+	}
+	Timer timer;
+
+	workcount = workcnt;
+	pacifier = showpacifier;
+	workfunction = func;
+	stealingDone = 0;
+	stealingPacified = -1;
+
+	if ( workcount > 0 ) {
+		StealingPacifier();
+
+		if ( numthreads == 1 ) { // in order, so single threaded results stay reproducible
+			Timer busy;
+			for ( int i = 0; i < workcount; ++i )
+			{
+				workfunction( i );
+				++stealingDone;
+				StealingPacifier();
+			}
+			const double elapsed = busy.elapsed_sec();
+			ProfileThreads( &elapsed, 1, elapsed );
+		}
+		else
+		{
+			/* deal the items round-robin, so each range starts with the most expensive ones of the order */
+			stealingRanges = std::vector<StealingRange>( numthreads );
+			stealingWork.resize( workcount );
+			for ( int t = 0, pos = 0; t < numthreads; ++t )
+			{
+				const int start = pos;
+				for ( int i = t; i < workcount; i += numthreads )
+					stealingWork[pos++] = order != nullptr ? order[i] : i;
+				stealingRanges[t].range.store( StealingRange_pack( start, pos ), std::memory_order_relaxed );
+			}
+
+			RunThreadsOn( StealingWorkerFunction );
+
+			stealingRanges.clear();
+			stealingWork.clear();
+			stealingWork.shrink_to_fit();
+		}
+	}
+
+	if ( pacifier ) {
+		Sys_Printf( " (%i)\n", int( timer.elapsed_sec() ) );
+	}
+}
+
+
 #if 1
 
 #include <thread>
-#include <mutex>
 
 std::mutex crit;
 static bool enter;
@@ -152,8 +330,12 @@ void ThreadUnlock(){
    =============
  */
 void RunThreadsOn( void ( *func )( int ) ){
+	Timer timer;
+	double busy[MAX_THREADS];
+
 	if ( numthreads == 1 ) { // use same thread
 		func( 0 );
+		busy[0] = timer.elapsed_sec();
 	}
 	else
 	{
@@ -162,13 +344,18 @@ void RunThreadsOn( void ( *func )( int ) ){
 		std::thread threads[MAX_THREADS];
 
 		for ( int i = 0; i < numthreads; ++i )
-			threads[i] = std::thread( func, i );
+			threads[i] = std::thread( [func, i, &timer, &busy](){
+				func( i );
+				busy[i] = timer.elapsed_sec();
+			} );
 
 		for ( int i = 0; i < numthreads; ++i )
 			threads[i].join();
 
 		threaded = false;
 	}
+
+	ProfileThreads( busy, numthreads, timer.elapsed_sec() );
 }
 
 #else
@@ -70,14 +70,22 @@
 #include "stream/textstream.h"
 #include <forward_list>
 #include <filesystem>
+#include <atomic>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
 
 struct VFS_PAK
 {
 	unzFile zipfile;
 	const CopiedString unzFilePath;
+	std::mutex readersLock;
+	std::vector<unzFile> readers; // idle handles with own file streams, lets threads read the pak concurrently
 	VFS_PAK( unzFile zipfile, const char *unzFilePath ) : zipfile( zipfile ), unzFilePath( unzFilePath ) {};
 	VFS_PAK( VFS_PAK&& ) noexcept = delete;
 	~VFS_PAK(){
+		for ( unzFile reader : readers )
+			unzClose( reader );
 		unzClose( zipfile );
 	}
 };
@@ -95,7 +103,10 @@ struct VFS_PAKFILE
 
 static std::forward_list<VFS_PAK>  g_paks;
 static std::forward_list<VFS_PAKFILE>  g_pakFiles;
+static std::unordered_map<std::string_view, std::vector<const VFS_PAKFILE*>> g_pakFileIndex; // lowercase name -> files in g_pakFiles order
 static std::vector<CopiedString> g_strDirs;
+static constexpr int c_maxIdlePakReaders = 64; // over all paks, bounds open files with many paks and threads
+static std::atomic<int> g_idlePakReaders;
 std::vector<CopiedString> g_strForbiddenDirs;
 static constexpr bool g_bUsePak = true;
 StringOutputStream g_loadedScriptLocation;
@@ -121,18 +132,69 @@ static void vfsInitPakFile( const char *filename ){
 					FixDOSName( filename_inzip );
 					strLower( filename_inzip );
 
-					g_pakFiles.emplace_front( VFS_PAKFILE{
+					const VFS_PAKFILE& file = g_pakFiles.emplace_front( VFS_PAKFILE{
 						filename_inzip,
 						*(unz_s*)uf,
 						pak,
 						file_info.uncompressed_size
 					} );
+					auto& files = g_pakFileIndex[file.name.c_str()];
+					files.insert( files.begin(), &file );
 				}
 			} while( unzGoToNextFile( uf ) == UNZ_OK );
 		}
 	}
 }
 
+static const std::vector<const VFS_PAKFILE*>& vfsFindPakFiles( const char *name ){
+	static const std::vector<const VFS_PAKFILE*> none;
+	const auto found = g_pakFileIndex.find( name );
+	return found == g_pakFileIndex.end()? none : found->second;
+}
+
+// thread safe, each read takes an idle reader of the pak or opens a new one
+// readers are closed after the read while c_maxIdlePakReaders are idle
+static MemBuffer vfsReadPakFile( const VFS_PAKFILE& file ){
+	VFS_PAK& pak = file.pak;
+	unzFile zipfile = nullptr;
+	{
+		std::lock_guard lock( pak.readersLock );
+		if ( !pak.readers.empty() ) {
+			zipfile = pak.readers.back();
+			pak.readers.pop_back();
+			--g_idlePakReaders;
+		}
+	}
+	if ( zipfile == nullptr && ( zipfile = unzReOpen( pak.unzFilePath.c_str(), pak.zipfile ) ) == nullptr ) {
+		return MemBuffer();
+	}
+
+	unz_s& reader = *(unz_s*)zipfile;
+	FILE *stream = reader.file;
+	reader = file.zipinfo;
+	reader.file = stream;
+
+	MemBuffer buffer;
+	if ( unzOpenCurrentFile( zipfile ) == UNZ_OK ) {
+		buffer = MemBuffer( file.size );
+
+		if ( unzReadCurrentFile( zipfile, buffer.data(), file.size ) < 0 ) {
+			buffer = MemBuffer();
+		}
+		unzCloseCurrentFile( zipfile );
+	}
+
+	if ( g_idlePakReaders++ < c_maxIdlePakReaders ) {
+		std::lock_guard lock( pak.readersLock );
+		pak.readers.push_back( zipfile );
+	}
+	else{
+		--g_idlePakReaders;
+		unzClose( zipfile );
+	}
+	return buffer;
+}
+
 // =============================================================================
 // Global functions
 
@@ -229,8 +291,10 @@ std::vector<CopiedString> vfsListShaderFiles( const char *shaderPath ){
 
 // frees all memory that we allocated
 void vfsShutdown(){
-	g_paks.clear();
+	g_pakFileIndex.clear();
 	g_pakFiles.clear();
+	g_paks.clear();
+	g_idlePakReaders = 0;
 }
 
 // return the number of files that match
@@ -247,14 +311,7 @@ int vfsGetFileCount( const char *filename ){
 
 	strLower( fixedname.c_str() );
 
-	for ( const VFS_PAKFILE& file : g_pakFiles )
-	{
-		if ( strEqual( file.name.c_str(), fixedname ) ) {
-			++count;
-		}
-	}
-
-	return count;
+	return count + vfsFindPakFiles( fixedname ).size();
 }
 
 // NOTE: when loading a file, you have to allocate one extra byte and set it to \0
@@ -298,30 +355,15 @@ MemBuffer vfsLoadFile( const char *filename, int index /* = 0 */, bool script /*
 
 	strLower( fixedname.c_str() );
 
-	MemBuffer buffer;
-
-	for ( const VFS_PAKFILE& file : g_pakFiles )
-	{
-		if ( strEqual( file.name.c_str(), fixedname ) && 0 == index-- )
-		{
-			if( script ) g_loadedScriptLocation( file.pak.unzFilePath.c_str(), " :: ", filename );
-
-			unzFile zipfile = file.pak.zipfile;
-			*(unz_s*)zipfile = file.zipinfo;
+	const auto& files = vfsFindPakFiles( fixedname );
+	if ( index < int( files.size() ) ) {
+		const VFS_PAKFILE& file = *files[index];
+		if( script ) g_loadedScriptLocation( file.pak.unzFilePath.c_str(), " :: ", filename );
 
-			if ( unzOpenCurrentFile( zipfile ) == UNZ_OK ) {
-				buffer = MemBuffer( file.size );
-
-				if ( unzReadCurrentFile( zipfile, buffer.data(), file.size ) < 0 ) {
-					buffer = MemBuffer();
-				}
-				unzCloseCurrentFile( zipfile );
-			}
-			return buffer;
-		}
+		return vfsReadPakFile( file );
 	}
 
-	return buffer;
+	return MemBuffer();
 }
 
 
@@ -337,26 +379,13 @@ bool vfsPackFile( const char *filename, const char *packname, const int compLeve
 	auto fixed = StringStream<64>( PathCleaned( filename ) );
 	strLower( fixed.c_str() );
 
-	for ( const VFS_PAKFILE& file : g_pakFiles )
-	{
-		if ( strEqual( file.name.c_str(), fixed ) )
-		{
-			unzFile zipfile = file.pak.zipfile;
-			*(unz_s*)zipfile = file.zipinfo;
-
-			if ( unzOpenCurrentFile( zipfile ) == UNZ_OK ) {
-				MemBuffer buffer( file.size );
-
-				const int size = unzReadCurrentFile( zipfile, buffer.data(), file.size );
-				unzCloseCurrentFile( zipfile );
-				if ( size >= 0 ) {
-					if ( !mz_zip_add_mem_to_archive_file_in_place_with_time( packname, filename, buffer.data(), size, 0, 0, compLevel, file.zipinfo.cur_file_info.dosDate ) ){
-						Error( "Failed creating zip archive \"%s\"!\n", packname );
-					}
-					return true;
-				}
+	if ( const auto& files = vfsFindPakFiles( fixed ); !files.empty() ) {
+		const VFS_PAKFILE& file = *files.front();
+		if ( const MemBuffer buffer = vfsReadPakFile( file ) ) {
+			if ( !mz_zip_add_mem_to_archive_file_in_place_with_time( packname, filename, buffer.data(), buffer.size(), 0, 0, compLevel, file.zipinfo.cur_file_info.dosDate ) ){
+				Error( "Failed creating zip archive \"%s\"!\n", packname );
 			}
-			return false;
+			return true;
 		}
 	}
 
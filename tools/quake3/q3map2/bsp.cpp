@@ -917,8 +917,12 @@ int BSPMain( Args& args ){
 	/* ydnar: cloned brush model entities */
 	SetCloneModelNumbers();
 
+	/* load misc_models in threads */
+	PrefetchModels();
+
 	/* process world and submodels */
 	ProcessModels();
+	SaveModelCache();
 
 	/* set light styles from targetted light entities */
 	SetLightStyles();
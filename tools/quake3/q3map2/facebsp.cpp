@@ -30,10 +30,113 @@
 
 /* dependencies */
 #include "q3map2.h"
+#include <numeric>
 
 
 
-static int c_faceLeafs;
+static std::atomic<int> c_faceLeafs;
+
+/* threaded FaceBSP: the top of the tree is built serially with threaded split plane scoring,
+   subtrees of less than faceTreeTaskFaces faces are deferred and built as threaded tasks;
+   neither changes the tree, which only depends on the order faces are visited in */
+#define FACEBSP_THREADED_SCORING    1024    /* minimum faces to score split planes in threads */
+
+struct FaceTreeTask
+{
+	node_t *node;
+	facelist_t list;
+	int numFaces;
+};
+
+static std::vector<FaceTreeTask> faceTreeTasks;
+static int faceTreeTaskFaces;               /* 0 = no deferring */
+static const std::vector<const face_t*> *scoringFaces;
+static int *scoringValues;
+
+
+
+/*
+   NodeBlockSplit()
+   returns axis of the first block boundary crossed by the node and its distance, -1 if none
+ */
+
+static int NodeBlockSplit( const node_t *node, float *dist ){
+	/* ydnar 2002-06-24: changed this to split on z-axis as well */
+	/* ydnar 2002-09-21: changed blocksize to be a vector, so mappers can specify a 3 element value */
+	for ( int i = 0; i < 3; ++i )
+	{
+		if ( blockSize[ i ] <= 0 ) {
+			continue;
+		}
+		*dist = blockSize[ i ] * ( floor( node->minmax.mins[ i ] / blockSize[ i ] ) + 1 );
+		if ( node->minmax.maxs[ i ] > *dist ) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+
+
+/*
+   SplitPlaneValue()
+   scores a face plane as split plane for the faces
+ */
+
+static int SplitPlaneValue( const face_t& split, const std::vector<const face_t*>& faces ){
+	const plane_t& plane = mapplanes[ split.planenum ];
+	int splits = 0;
+	int facing = 0;
+	int front = 0;
+	int back = 0;
+	for ( const face_t *check : faces ) {
+		if ( check->planenum == split.planenum ) {
+			facing++;
+			//check->checked = true;	// won't need to test this plane again
+			continue;
+		}
+		const EPlaneSide side = WindingOnPlaneSide( check->w, plane.plane );
+		if ( side == eSideCross ) {
+			splits++;
+		}
+		else if ( side == eSideFront ) {
+			front++;
+		}
+		else if ( side == eSideBack ) {
+			back++;
+		}
+	}
+
+	int value;
+	if ( bspAlternateSplitWeights ) {
+		// from 27
+
+		//Bigger is better
+		const float sizeBias = WindingArea( split.w );
+
+		//Base score = 20000 perfectly balanced
+		value = 20000 - ( abs( front - back ) );
+		value -= plane.counter; // If we've already used this plane sometime in the past try not to use it again
+		value -= facing;        // if we're going to have alot of other surfs use this plane, we want to get it in quickly.
+		value -= splits * 5;        //more splits = bad
+		value +=  sizeBias * 10; //We want a huge score bias based on plane size
+	}
+	else
+	{
+		value =  5 * facing - 5 * splits; // - abs(front-back);
+		if ( plane.type < ePlaneNonAxial ) {
+			value += 5;       // axial is better
+		}
+	}
+
+	value += split.priority;       // prioritize hints higher
+
+	return value;
+}
+
+static void SplitPlaneValueThread( int i ){
+	scoringValues[ i ] = SplitPlaneValue( *( *scoringFaces )[ i ], *scoringFaces );
+}
 
 
 
@@ -42,7 +145,7 @@ static int c_faceLeafs;
    finds the best split plane for this node
  */
 
-static void SelectSplitPlaneNum( const node_t *node, const facelist_t& list, int *splitPlaneNum, int *compileFlags ){
+static void SelectSplitPlaneNum( const node_t *node, const facelist_t& list, bool threadedScoring, int *splitPlaneNum, int *compileFlags ){
 	//int frontC, backC, splitsC, facingC;
 
 
@@ -50,20 +153,11 @@ static void SelectSplitPlaneNum( const node_t *node, const facelist_t& list, int
 	*splitPlaneNum = PLANENUM_LEAF; /* leaf */
 	*compileFlags = 0;
 
-	/* ydnar 2002-06-24: changed this to split on z-axis as well */
-	/* ydnar 2002-09-21: changed blocksize to be a vector, so mappers can specify a 3 element value */
-
 	/* if it is crossing a block boundary, force a split */
-	for ( int i = 0; i < 3; ++i )
-	{
-		if ( blockSize[ i ] <= 0 ) {
-			continue;
-		}
-		const float dist = blockSize[ i ] * ( floor( node->minmax.mins[ i ] / blockSize[ i ] ) + 1 );
-		if ( node->minmax.maxs[ i ] > dist ) {
-			*splitPlaneNum = FindFloatPlane( Plane3f( g_vector3_axes[i], dist ) );
-			return;
-		}
+	float dist;
+	if ( const int axis = NodeBlockSplit( node, &dist ); axis >= 0 ) {
+		*splitPlaneNum = FindFloatPlane( Plane3f( g_vector3_axes[axis], dist ) );
+		return;
 	}
 
 	/* pick one of the face planes */
@@ -75,65 +169,26 @@ static void SelectSplitPlaneNum( const node_t *node, const facelist_t& list, int
 	//for( face_t& split : list )
 	//	split.checked = false;
 
-	for ( const face_t& split : list )
-	{
-		//if ( split->checked )
-		//	continue;
-
-		const plane_t& plane = mapplanes[ split.planenum ];
-		int splits = 0;
-		int facing = 0;
-		int front = 0;
-		int back = 0;
-		for ( const face_t& check : list ) {
-			if ( check.planenum == split.planenum ) {
-				facing++;
-				//check->checked = true;	// won't need to test this plane again
-				continue;
-			}
-			const EPlaneSide side = WindingOnPlaneSide( check.w, plane.plane );
-			if ( side == eSideCross ) {
-				splits++;
-			}
-			else if ( side == eSideFront ) {
-				front++;
-			}
-			else if ( side == eSideBack ) {
-				back++;
-			}
-		}
-
-		int value;
-		if ( bspAlternateSplitWeights ) {
-			// from 27
-
-			//Bigger is better
-			const float sizeBias = WindingArea( split.w );
-
-			//Base score = 20000 perfectly balanced
-			value = 20000 - ( abs( front - back ) );
-			value -= plane.counter; // If we've already used this plane sometime in the past try not to use it again
-			value -= facing;        // if we're going to have alot of other surfs use this plane, we want to get it in quickly.
-			value -= splits * 5;        //more splits = bad
-			value +=  sizeBias * 10; //We want a huge score bias based on plane size
-		}
-		else
-		{
-			value =  5 * facing - 5 * splits; // - abs(front-back);
-			if ( plane.type < ePlaneNonAxial ) {
-				value += 5;       // axial is better
-			}
-		}
+	std::vector<const face_t*> faces;
+	for ( const face_t& face : list )
+		faces.push_back( &face );
+	std::vector<int> values( faces.size() );
 
-		value += split.priority;       // prioritize hints higher
+	if ( threadedScoring && faces.size() >= FACEBSP_THREADED_SCORING ) {
+		scoringFaces = &faces;
+		scoringValues = values.data();
+		RunThreadsOnIndividualStealing( faces.size(), false, SplitPlaneValueThread );
+	}
+	else{
+		for ( size_t i = 0; i < faces.size(); ++i )
+			values[ i ] = SplitPlaneValue( *faces[ i ], faces );
+	}
 
-		if ( value > bestValue ) {
-			bestValue = value;
-			bestSplit = &split;
-			//frontC = front;
-			//backC = back;
-			//splitsC = splits;
-			//facingC = facing;
+	for ( size_t i = 0; i < faces.size(); ++i )
+	{
+		if ( values[ i ] > bestValue ) {
+			bestValue = values[ i ];
+			bestSplit = faces[ i ];
 		}
 	}
 
@@ -160,7 +215,8 @@ static void SelectSplitPlaneNum( const node_t *node, const facelist_t& list, int
 	}
 #endif
 
-	if ( *splitPlaneNum > -1 ) {
+	/* only read by bspAlternateSplitWeights, which builds serially */
+	if ( *splitPlaneNum > -1 && bspAlternateSplitWeights ) {
 		mapplanes[ *splitPlaneNum ].counter++;
 	}
 }
@@ -172,16 +228,25 @@ static void SelectSplitPlaneNum( const node_t *node, const facelist_t& list, int
    recursively builds the bsp, splitting on face planes
  */
 
-static void BuildFaceTree_r( node_t *node, facelist_t& list ){
+static void BuildFaceTree_r( node_t *node, facelist_t& list, bool top ){
 	facelist_t childLists[2];
 	int splitPlaneNum, compileFlags;
 #if 0
 	bool isstruct = false;
 #endif
 
+	/* defer small subtrees to threaded tasks, block splits must stay serial to keep plane numbering */
+	if ( top && faceTreeTaskFaces > 0 ) {
+		const int numFaces = std::distance( list.cbegin(), list.cend() );
+		float dist;
+		if ( numFaces < faceTreeTaskFaces && NodeBlockSplit( node, &dist ) < 0 ) {
+			faceTreeTasks.push_back( FaceTreeTask{ node, std::move( list ), numFaces } );
+			return;
+		}
+	}
 
 	/* select the best split plane */
-	SelectSplitPlaneNum( node, list, &splitPlaneNum, &compileFlags );
+	SelectSplitPlaneNum( node, list, top, &splitPlaneNum, &compileFlags );
 
 	/* if we don't have any more faces, this is a node */
 	if ( splitPlaneNum == PLANENUM_LEAF ) {
@@ -273,7 +338,7 @@ static void BuildFaceTree_r( node_t *node, facelist_t& list ){
 #endif
 
 	for ( int i = 0; i < 2; ++i ) {
-		BuildFaceTree_r( node->children[i], childLists[i] );
+		BuildFaceTree_r( node->children[i], childLists[i], top );
 		node->has_structural_children |= node->children[i]->has_structural_children;
 	}
 
@@ -288,6 +353,34 @@ static void BuildFaceTree_r( node_t *node, facelist_t& list ){
 }
 
 
+/*
+   BuildFaceTreeTask()
+   builds a deferred subtree
+ */
+
+static void BuildFaceTreeTask( int i ){
+	FaceTreeTask& task = faceTreeTasks[ i ];
+	BuildFaceTree_r( task.node, task.list, false );
+}
+
+
+
+/*
+   StructuralChildren_r()
+   redoes has_structural_children of BuildFaceTree_r
+ */
+
+static bool StructuralChildren_r( node_t *node ){
+	if ( node->planenum == PLANENUM_LEAF ) {
+		return node->has_structural_children = false;
+	}
+	node->has_structural_children = !( node->compileFlags & C_DETAIL ) && !node->opaque;
+	for ( node_t *child : node->children )
+		node->has_structural_children |= StructuralChildren_r( child );
+	return node->has_structural_children;
+}
+
+
 /*
    ================
    FaceBSP
@@ -296,6 +389,7 @@ static void BuildFaceTree_r( node_t *node, facelist_t& list ){
    ================
  */
 tree_t FaceBSP( facelist_t& list ) {
+	ProfileStage stage( "FaceBSP" );
 	Sys_FPrintf( SYS_VRB, "--- FaceBSP ---\n" );
 
 	tree_t tree{};
@@ -317,9 +411,22 @@ tree_t FaceBSP( facelist_t& list ) {
 	tree.headnode->minmax = tree.minmax;
 	c_faceLeafs = 0;
 
-	BuildFaceTree_r( tree.headnode, list );
+	/* alternate split weights depend on the order planes are used in */
+	faceTreeTaskFaces = ( numthreads > 1 && !bspAlternateSplitWeights )? std::max( count / ( numthreads * 8 ), 64 ) : 0;
+
+	BuildFaceTree_r( tree.headnode, list, true );
+
+	if ( !faceTreeTasks.empty() ) {
+		std::vector<int> order( faceTreeTasks.size() );
+		std::iota( order.begin(), order.end(), 0 );
+		std::ranges::sort( order, [&]( int a, int b ){ return faceTreeTasks[ a ].numFaces > faceTreeTasks[ b ].numFaces; } );
+		RunThreadsOnIndividualStealing( faceTreeTasks.size(), false, BuildFaceTreeTask, order.data() );
+		faceTreeTasks.clear();
+		/* parents were done before their deferred children */
+		StructuralChildren_r( tree.headnode );
+	}
 
-	Sys_FPrintf( SYS_VRB, "%9d leafs\n", c_faceLeafs );
+	Sys_FPrintf( SYS_VRB, "%9d leafs\n", c_faceLeafs.load() );
 
 	return tree;
 }
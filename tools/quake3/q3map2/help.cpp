@@ -147,6 +147,7 @@ static void HelpVis()
 		{ "-vis [options] <filename.map>", "Switch that enters this stage" },
 		{ "-fast", "Very fast and crude vis calculation" },
 		{ "-hint", "Merge all but hint portals" },
+		{ "-incremental", "Reuse the vis of portals whose surroundings did not change since the last -incremental run, cached in a .viscache file" },
 		{ "-mergeportals", "The less crude half of `-merge`, makes vis sometimes much faster but doesn't hurt fps usually" },
 		{ "-merge", "Faster but still okay vis calculation" },
 		{ "-nopassage", "Just use PortalFlow vis (usually less fps)" },
@@ -248,6 +249,7 @@ static void HelpLight()
 		{ "-q3", "Use nonlinear falloff curve by default (like Q3A)" },
 		{ "-randomsamples", "Use random sampling for lightmaps" },
 		{ "-rawlightmapsizelimit <N>", "Sets maximum lightmap resolution in pixels (only affects patches if used -patchmeta in BSP stage)" },
+		{ "-rectallocate", "Use rectangle packing lightmaps allocation algorithm (much faster on big maps, does not interleave sparse lightmaps)" },
 		{ "-samplescale <F>", "Scales all lightmap resolutions" },
 		{ "-samplesize <N>", "Sets default lightmap resolution in qu/luxel" },
 		{ "-samplessearchboxsize <N>", "Search box size (1 to 4) for lightmap adaptive supersampling" },
@@ -268,6 +270,7 @@ static void HelpLight()
 		{ "-sunonly", "Only compute sun light" },
 		{ "-super <N>, -supersample <N>", "Ordered grid supersampling quality" },
 		{ "-thresh <F>", "Triangle subdivision threshold" },
+		{ "-tracer <bsp|flat>", "Shadow raytracer: bsp trace nodes (default) or their flattened copy (same results, faster)" },
 		{ "-trianglecheck", "Broken check that should ensure luxels apply to the right triangle" },
 		{ "-trisoup", "Convert brush faces to triangle soup" },
 		{ "-vertexscale <F>", "Scaling factor for resulting vertex light values" },
@@ -463,6 +466,8 @@ static void HelpCommon()
 		{ "-fs_pakpath <path>", "Specify a package directory (can be used more than once to look in multiple paths)" },
 		{ "-game <gamename>", "Load settings for the given game (default: quake3), -help -game lists available games" },
 		{ "-maxmapdrawsurfs <N>", "Sets max amount of mapDrawSurfs, used during .map compilation (-bsp, -convert), default = 131072" },
+		{ "-modelcache", "Keep imported misc_model and shader models in <mapname>.modelcache and reuse them while model files are unchanged" },
+		{ "-profile", "Time compile stages and write per stage wall/cpu time, peak memory, thread utilization and throughput counters to <mapname>.<mode>.profile.json" },
 		{ "-subdivisions <F>", "multiplier for patch subdivisions quality" },
 		{ "-threads <N>", "number of threads to use" },
 		{ "-v", "Verbose mode" },
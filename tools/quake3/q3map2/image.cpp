@@ -33,6 +33,8 @@
 #include "ddslib.h"
 #include "crnlib/crnlib.h"
 #include "webplib/webplib.h"
+#include <mutex>
+#include <unordered_map>
 
 #define STBI_NO_BMP
 #define STBI_NO_PSD
@@ -46,8 +48,8 @@
 
 /* -------------------------------------------------------------------------------
 
-   this file contains image pool management with reference counting. note: it isn't
-   reentrant, so only call it from init/shutdown code or wrap calls in a mutex
+   this file contains image pool management. ImageLoad() is thread safe, images are
+   decoded outside of the pool lock
 
    ------------------------------------------------------------------------------- */
 
@@ -166,38 +168,23 @@ static int LoadPNGBuffer( byte *buffer, int size, byte **pixels, int *width, int
 
 
 static std::forward_list<image_t> images;
+static std::unordered_map<std::string, const image_t*> imageIndex; /* lowercase name -> image, nullptr if no file of any extension loads */
+static std::mutex imagesLock;
+
+static std::string ImageKey( const char *name ){
+	std::string key( name );
+	strLower( key.data() );
+	return key;
+}
 
 static struct construct_default_image
 {
 	construct_default_image(){
 		images.emplace_front( DEFAULT_IMAGE, DEFAULT_IMAGE, 64, 64, void_ptr( memset( safe_malloc( 64 * 64 * 4 ), 255, 64 * 64 * 4 ) ) );
+		imageIndex.emplace( ImageKey( DEFAULT_IMAGE ), &images.front() );
 	}
 } s_construct_default_image;
 
-/*
-   ImageFind()
-   finds an existing rgba image and returns a pointer to the image_t struct or NULL if not found
-   name is name without extension, as in images[ i ].name
- */
-
-static const image_t *ImageFind( const char *name ){
-	/* dummy check */
-	if ( strEmptyOrNull( name ) ) {
-		return nullptr;
-	}
-
-	/* search list */
-	for ( const auto& img : images )
-	{
-		if ( striEqual( name, img.name.c_str() ) ) {
-			return &img;
-		}
-	}
-
-	/* no matching image found */
-	return nullptr;
-}
-
 
 
 /*
@@ -212,9 +199,13 @@ const image_t *ImageLoad( const char *name ){
 		return nullptr;
 	}
 
-	/* try to find existing image */
-	if ( const auto *img = ImageFind( name ) ) {
-		return img;
+	/* try to find existing image, or known missing one */
+	const std::string key = ImageKey( name );
+	{
+		std::lock_guard lock( imagesLock );
+		if ( const auto found = imageIndex.find( key ); found != imageIndex.end() ) {
+			return found->second;
+		}
 	}
 
 	/* none found, so let's create a new one */
@@ -279,11 +270,12 @@ const image_t *ImageLoad( const char *name ){
 	if ( !buffer || width <= 0 || height <= 0 || pixels == nullptr ) {
 		//%	Sys_Printf( "size = %zu  width = %d  height = %d  pixels = 0x%08x (%s)\n",
 		//%		buffer.size(), width, height, pixels, filename );
-		return nullptr;
+		std::lock_guard lock( imagesLock );
+		return imageIndex.try_emplace( key, nullptr ).first->second;
 	}
 
 	/* everybody's in the place, create new image */
-	image_t& image = *images.emplace_after( images.cbegin(), name, filename, width, height, pixels );
+	image_t image( name, filename, width, height, pixels );
 
 	if ( alphaHack ) {
 		if ( path_set_extension( filename, "_alpha.jpg" ); ( buffer = vfsLoadFile( filename ) ) ) {
@@ -302,6 +294,13 @@ const image_t *ImageLoad( const char *name ){
 		}
 	}
 
+	/* add to the pool, unless another thread was faster */
+	std::lock_guard lock( imagesLock );
+	const auto [found, inserted] = imageIndex.try_emplace( key, nullptr );
+	if ( inserted ) {
+		found->second = &*images.emplace_after( images.cbegin(), std::move( image ) );
+	}
+
 	/* return the image */
-	return &image;
+	return found->second;
 }
@@ -770,13 +770,15 @@ float PointToPolygonFormFactor( const Vector3& point, const Vector3& normal, con
 
 
 /*
-   LightContributionTosample()
-   determines the amount of light reaching a sample (luxel or vertex) from a given light
+   LightContributionSetup()
+   the part of LightContributionToSample() before tracing, returns LIGHT_CONTRIBUTION_TRACE
+   if the sample needs to be traced, its final result otherwise
  */
 
-int LightContributionToSample( trace_t *trace ){
+#define LIGHT_CONTRIBUTION_TRACE    2
+
+static int LightContributionSetup( trace_t *trace, float& add ){
 	float angle;
-	float add;
 	float dist;
 	float addDeluxe = 0, addDeluxeBounceScale = 0.25f;
 	bool angledDeluxe = true;
@@ -1108,16 +1110,7 @@ int LightContributionToSample( trace_t *trace ){
 
 		/* trace to point */
 		if ( trace->testOcclusion && !trace->forceSunlight ) {
-			/* trace */
-			TraceLine( trace );
-			trace->forceSubsampling *= add;
-			if ( !( trace->compileFlags & C_SKY ) || trace->opaque
-			|| ( !g_oneSky && light->skyIndex != -1 && !bit_is_enabled( trace->skyIndices, light->skyIndex ) ) ) {
-				trace->color.set( 0 );
-				trace->directionContribution.set( 0 );
-
-				return -1;
-			}
+			return LIGHT_CONTRIBUTION_TRACE;
 		}
 
 		/* return to sender */
@@ -1163,9 +1156,30 @@ int LightContributionToSample( trace_t *trace ){
 	trace->color = light->color * add;
 
 	/* raytrace */
-	TraceLine( trace );
+	return LIGHT_CONTRIBUTION_TRACE;
+}
+
+
+
+/*
+   LightContributionFinish()
+   the part of LightContributionToSample() after tracing
+ */
+
+static int LightContributionFinish( trace_t *trace, float add ){
+	const light_t *light = trace->light;
+
 	trace->forceSubsampling *= add;
-	if ( trace->passSolid || trace->opaque ) {
+	if ( light->type == ELightType::Sun ) {
+		if ( !( trace->compileFlags & C_SKY ) || trace->opaque
+		|| ( !g_oneSky && light->skyIndex != -1 && !bit_is_enabled( trace->skyIndices, light->skyIndex ) ) ) {
+			trace->color.set( 0 );
+			trace->directionContribution.set( 0 );
+
+			return -1;
+		}
+	}
+	else if ( trace->passSolid || trace->opaque ) {
 		trace->color.set( 0 );
 		trace->directionContribution.set( 0 );
 
@@ -1178,6 +1192,51 @@ int LightContributionToSample( trace_t *trace ){
 
 
 
+/*
+   LightContributionTosample()
+   determines the amount of light reaching a sample (luxel or vertex) from a given light
+ */
+
+int LightContributionToSample( trace_t *trace ){
+	float add;
+	const int result = LightContributionSetup( trace, add );
+	if ( result != LIGHT_CONTRIBUTION_TRACE ) {
+		return result;
+	}
+
+	TraceLine( trace );
+	return LightContributionFinish( trace, add );
+}
+
+
+
+/*
+   LightContributionToSamples()
+   LightContributionToSample() for a batch of samples, tracing them together
+ */
+
+void LightContributionToSamples( trace_t *traces, int numTraces ){
+	for ( int i = 0; i < numTraces; i += TRACE_PACKET_SIZE )
+	{
+		trace_t *packet[ TRACE_PACKET_SIZE ];
+		float add[ TRACE_PACKET_SIZE ];
+		int numPacket = 0;
+
+		for ( trace_t& trace : Span( traces + i, std::min( numTraces - i, TRACE_PACKET_SIZE ) ) )
+		{
+			if ( LightContributionSetup( &trace, add[ numPacket ] ) == LIGHT_CONTRIBUTION_TRACE ) {
+				packet[ numPacket++ ] = &trace;
+			}
+		}
+
+		TraceLines( packet, numPacket );
+		for ( int j = 0; j < numPacket; ++j )
+			LightContributionFinish( packet[ j ], add[ j ] );
+	}
+}
+
+
+
 /*
    LightingAtSample()
    determines the amount of light reaching a sample (luxel or vertex)
@@ -1922,6 +1981,20 @@ static void WriteBSPFileAfterLight( const char *bspFileName ){
    does what it says...
  */
 
+/*
+   ProfileLightCounters()
+   adds traces and luxels since last call to the current -profile stage
+ */
+
+static void ProfileLightCounters(){
+	static int luxels;
+	if ( profiling ) {
+		ProfileCount( "traces", numProfiledTraces.exchange( 0 ) );
+		ProfileCount( "luxels", numLuxelsIlluminated - luxels );
+	}
+	luxels = numLuxelsIlluminated;
+}
+
 static void LightWorld( bool fastAllocate, bool bounceStore ){
 	Vector3 color;
 	float f;
@@ -1988,9 +2061,11 @@ static void LightWorld( bool fastAllocate, bool bounceStore ){
 		SetupEnvelopes( true, fastgrid );
 
 		Sys_Printf( "--- TraceGrid ---\n" );
+		ProfileStage stage( "TraceGrid" );
 		inGrid = true;
-		RunThreadsOnIndividual( rawGridPoints.size(), true, TraceGrid );
+		RunThreadsOnIndividualStealing( rawGridPoints.size(), true, TraceGrid );
 		inGrid = false;
+		ProfileLightCounters();
 		Sys_Printf( "%d x %d x %d = %zu grid\n",
 		            gridBounds[ 0 ], gridBounds[ 1 ], gridBounds[ 2 ], bspGridPoints.size() );
 
@@ -2002,9 +2077,16 @@ static void LightWorld( bool fastAllocate, bool bounceStore ){
 	/* slight optimization to remove a sqrt */
 	subdivideThreshold *= subdivideThreshold;
 
+	/* lightmap work order for the threads, biggest first */
+	const std::vector<int> lightmapOrder = RawLightmapsByCost();
+
 	/* map the world luxels */
 	Sys_Printf( "--- MapRawLightmap ---\n" );
-	RunThreadsOnIndividual( numRawLightmaps, true, MapRawLightmap );
+	{
+		ProfileStage stage( "MapRawLightmap" );
+		RunThreadsOnIndividualStealing( numRawLightmaps, true, MapRawLightmap, lightmapOrder.data() );
+		ProfileLightCounters();
+	}
 	Sys_Printf( "%9d luxels\n", numLuxels );
 	Sys_Printf( "%9d luxels mapped\n", numLuxelsMapped );
 	Sys_Printf( "%9d luxels occluded\n", numLuxelsOccluded );
@@ -2012,11 +2094,17 @@ static void LightWorld( bool fastAllocate, bool bounceStore ){
 	/* dirty them up */
 	if ( dirty ) {
 		Sys_Printf( "--- DirtyRawLightmap ---\n" );
-		RunThreadsOnIndividual( numRawLightmaps, true, DirtyRawLightmap );
+		ProfileStage stage( "DirtyRawLightmap" );
+		RunThreadsOnIndividualStealing( numRawLightmaps, true, DirtyRawLightmap, lightmapOrder.data() );
+		ProfileLightCounters();
 	}
 
 	/* floodlight pass */
-	FloodlightRawLightmaps();
+	{
+		ProfileStage stage( "FloodlightRawLightmaps" );
+		FloodlightRawLightmaps();
+		ProfileLightCounters();
+	}
 
 	/* ydnar: set up light envelopes */
 	SetupEnvelopes( false, fast );
@@ -2028,13 +2116,21 @@ static void LightWorld( bool fastAllocate, bool bounceStore ){
 	lightsClusterCulled = 0;
 
 	Sys_Printf( "--- IlluminateRawLightmap ---\n" );
-	RunThreadsOnIndividual( numRawLightmaps, true, IlluminateRawLightmap );
+	{
+		ProfileStage stage( "IlluminateRawLightmap" );
+		RunThreadsOnIndividualStealing( numRawLightmaps, true, IlluminateRawLightmap, lightmapOrder.data() );
+		ProfileLightCounters();
+	}
 	Sys_Printf( "%9d luxels illuminated\n", numLuxelsIlluminated );
 
 	StitchSurfaceLightmaps();
 
 	Sys_Printf( "--- IlluminateVertexes ---\n" );
-	RunThreadsOnIndividual( bspDrawSurfaces.size(), true, IlluminateVertexes );
+	{
+		ProfileStage stage( "IlluminateVertexes" );
+		RunThreadsOnIndividualStealing( bspDrawSurfaces.size(), true, IlluminateVertexes );
+		ProfileLightCounters();
+	}
 	Sys_Printf( "%9d vertexes illuminated\n", numVertsIlluminated );
 
 	/* ydnar: emit statistics on light culling */
@@ -2049,12 +2145,17 @@ static void LightWorld( bool fastAllocate, bool bounceStore ){
 	while ( bounce > 0 )
 	{
 		/* store off the bsp between bounces */
-		StoreSurfaceLightmaps( fastAllocate, bounceStore );
+		{
+			ProfileStage stage( "StoreSurfaceLightmaps" );
+			StoreSurfaceLightmaps( fastAllocate, bounceStore );
+		}
 		if( bounceStore ){
 			UnparseEntities();
 			WriteBSPFileAfterLight( source );
 		}
 
+		ProfileStage stage( "bounce" );
+
 		/* note it */
 		Sys_Printf( "\n--- Radiosity (bounce %d of %d) ---\n", b, bt );
 
@@ -2070,7 +2171,10 @@ static void LightWorld( bool fastAllocate, bool bounceStore ){
 		/* delete any existing lights, freeing up memory for the next bounce */
 		lights.clear();
 		/* generate diffuse lights */
-		RadCreateDiffuseLights();
+		{
+			ProfileStage stage( "RadCreateDiffuseLights" );
+			RadCreateDiffuseLights();
+		}
 
 		/* setup light envelopes */
 		SetupEnvelopes( false, fastbounce );
@@ -2088,9 +2192,11 @@ static void LightWorld( bool fastAllocate, bool bounceStore ){
 			gridBoundsCulled = 0;
 
 			Sys_Printf( "--- BounceGrid ---\n" );
+			ProfileStage stage( "BounceGrid" );
 			inGrid = true;
-			RunThreadsOnIndividual( rawGridPoints.size(), true, TraceGrid );
+			RunThreadsOnIndividualStealing( rawGridPoints.size(), true, TraceGrid );
 			inGrid = false;
+			ProfileLightCounters();
 			Sys_FPrintf( SYS_VRB, "%9d grid points envelope culled\n", gridEnvelopeCulled );
 			Sys_FPrintf( SYS_VRB, "%9d grid points bounds culled\n", gridBoundsCulled );
 		}
@@ -2102,14 +2208,22 @@ static void LightWorld( bool fastAllocate, bool bounceStore ){
 		lightsClusterCulled = 0;
 
 		Sys_Printf( "--- IlluminateRawLightmap ---\n" );
-		RunThreadsOnIndividual( numRawLightmaps, true, IlluminateRawLightmap );
+		{
+			ProfileStage stage( "IlluminateRawLightmap" );
+			RunThreadsOnIndividualStealing( numRawLightmaps, true, IlluminateRawLightmap, lightmapOrder.data() );
+			ProfileLightCounters();
+		}
 		Sys_Printf( "%9d luxels illuminated\n", numLuxelsIlluminated );
 		Sys_Printf( "%9d vertexes illuminated\n", numVertsIlluminated );
 
 		StitchSurfaceLightmaps();
 
 		Sys_Printf( "--- IlluminateVertexes ---\n" );
-		RunThreadsOnIndividual( bspDrawSurfaces.size(), true, IlluminateVertexes );
+		{
+			ProfileStage stage( "IlluminateVertexes" );
+			RunThreadsOnIndividualStealing( bspDrawSurfaces.size(), true, IlluminateVertexes );
+			ProfileLightCounters();
+		}
 		Sys_Printf( "%9d vertexes illuminated\n", numVertsIlluminated );
 
 		/* ydnar: emit statistics on light culling */
@@ -2124,7 +2238,10 @@ static void LightWorld( bool fastAllocate, bool bounceStore ){
 	}
 
 	/* ydnar: store off lightmaps */
-	StoreSurfaceLightmaps( fastAllocate, true );
+	{
+		ProfileStage stage( "StoreSurfaceLightmaps" );
+		StoreSurfaceLightmaps( fastAllocate, true );
+	}
 
 	/* write out the bsp */
 	UnparseEntities();
@@ -2657,6 +2774,11 @@ int LightMain( Args& args ){
 			Sys_Printf( "Slow allocation mode enabled\n" );
 		}
 
+		while ( args.takeArg( "-rectallocate" ) ) {
+			rectAllocate = true;
+			Sys_Printf( "Rectangle lightmap allocation enabled\n" );
+		}
+
 		while ( args.takeArg( "-fastgrid" ) ) {
 			fastgrid = true;
 			Sys_Printf( "Fast grid lighting enabled\n" );
@@ -2770,6 +2892,21 @@ int LightMain( Args& args ){
 			noSurfaces = true;
 			Sys_Printf( "Not tracing against surfaces\n" );
 		}
+		while ( args.takeArg( "-tracer" ) ) {
+			const char *tracer = args.takeNext();
+			if ( striEqual( tracer, "flat" ) ) {
+				g_tracer = ETracer::Flat;
+				Sys_Printf( "Tracing with flattened trace nodes\n" );
+			}
+			else if ( striEqual( tracer, "bsp" ) ) {
+				g_tracer = ETracer::Bsp;
+				Sys_Printf( "Tracing with trace node bsp\n" );
+			}
+			else{
+				Sys_Warning( "Unknown tracer \"%s\", using bsp\n", tracer );
+				g_tracer = ETracer::Bsp;
+			}
+		}
 		while ( args.takeArg( "-dump" ) ) {
 			dump = true;
 			Sys_Printf( "Dumping radiosity lights into numbered prefabs\n" );
@@ -2939,6 +3076,14 @@ int LightMain( Args& args ){
 	/* load bsp file */
 	LoadBSPFile( source );
 
+	/* decode the shader images in threads */
+	{
+		std::vector<const char*> shaderNames;
+		for ( const bspShader_t& shader : bspShaders )
+			shaderNames.push_back( shader.shader );
+		PrefetchShaderImages( shaderNames );
+	}
+
 	/* parse bsp entities */
 	ParseEntities();
 
@@ -2964,7 +3109,11 @@ int LightMain( Args& args ){
 	SetupSurfaceLightmaps();
 
 	/* initialize the surface facet tracing */
-	SetupTraceNodes();
+	{
+		ProfileStage stage( "SetupTraceNodes" );
+		SetupTraceNodes();
+	}
+	SaveModelCache();
 
 	/* light the world */
 	LightWorld( fastAllocate, bounceStore );
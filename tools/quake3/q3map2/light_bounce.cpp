@@ -806,7 +806,7 @@ void RadCreateDiffuseLights(){
 	static int iterations = 0;
 
 	/* hit every surface (threaded) */
-	RunThreadsOnIndividual( bspDrawSurfaces.size(), true, RadLight );
+	RunThreadsOnIndividualStealing( bspDrawSurfaces.size(), true, RadLight );
 
 	/* dump the lights generated to a file */
 	if ( dump && !lights.empty() ) {
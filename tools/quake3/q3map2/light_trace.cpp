@@ -31,6 +31,11 @@
 /* dependencies */
 #include "q3map2.h"
 
+#if defined( __SSE__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 1 )
+#define TRACE_SSE 1
+#include <xmmintrin.h>
+#endif
+
 
 #define MAX_NODE_ITEMS          5
 #define MAX_NODE_TRIANGLES      5
@@ -1056,6 +1061,143 @@ static void PopulateTraceNodes(){
 
 
 
+/* -------------------------------------------------------------------------------
+
+   flattened trace tree (-tracer flat)
+
+   a compact copy of the finished trace nodes, laid out depth first, with leaf triangles
+   stored as SoA blocks of 4 and a bounding box around the triangles of every subtree;
+   walked in exactly the order of TraceLine_r(), so surfaces are tested in the same order
+   and results are identical, but subtrees without solid leaves are skipped when the
+   trace misses their triangles
+
+   ------------------------------------------------------------------------------- */
+
+#define TRACE_BLOCK_SIZE        4
+#define TRACE_BLOCK_EPSILON     0.02f   /* > BARY_EPSILON, bounds and block tests cover every hit TraceTriangle() accepts */
+
+struct traceFlatNode_t
+{
+	Plane3f plane;
+	int type;                           /* plane type, TRACE_LEAF or TRACE_LEAF_SOLID */
+	int children[ 2 ];                  /* leaves: flat leaf number in children[ 0 ] */
+	int numItems;
+	int numLeaves;                      /* leaves with items in the subtree */
+	bool solid;                         /* subtree contains a solid leaf */
+	MinMax minmax;                      /* triangles of the subtree */
+};
+
+struct traceFlatLeaf_t
+{
+	int firstBlock, numBlocks;
+};
+
+struct traceTriangleBlock_t
+{
+	float v0[ 3 ][ TRACE_BLOCK_SIZE ];
+	float edge1[ 3 ][ TRACE_BLOCK_SIZE ];
+	float edge2[ 3 ][ TRACE_BLOCK_SIZE ];
+	int triangles[ TRACE_BLOCK_SIZE ];  /* trace triangle number, -1 for padding */
+};
+
+namespace
+{
+std::vector<traceFlatNode_t> traceFlatNodes;
+std::vector<traceFlatLeaf_t> traceFlatLeafs;
+std::vector<traceTriangleBlock_t> traceTriangleBlocks;
+}
+
+
+
+/*
+   SetupTraceFlatLeaf()
+   stores the triangles of a trace leaf as SoA blocks, bounded by their barycentric slack
+ */
+
+static int SetupTraceFlatLeaf( const traceNode_t& node, MinMax& minmax ){
+	traceFlatLeaf_t leaf;
+	leaf.firstBlock = traceTriangleBlocks.size();
+	leaf.numBlocks = ( node.numItems + TRACE_BLOCK_SIZE - 1 ) / TRACE_BLOCK_SIZE;
+	traceTriangleBlocks.resize( leaf.firstBlock + leaf.numBlocks );
+
+	for ( int i = 0; i < leaf.numBlocks * TRACE_BLOCK_SIZE; ++i )
+	{
+		traceTriangleBlock_t& block = traceTriangleBlocks[ leaf.firstBlock + i / TRACE_BLOCK_SIZE ];
+		const int lane = i % TRACE_BLOCK_SIZE;
+
+		/* padding never hits */
+		if ( i >= node.numItems ) {
+			for ( int k = 0; k < 3; ++k )
+				block.v0[ k ][ lane ] = block.edge1[ k ][ lane ] = block.edge2[ k ][ lane ] = 0;
+			block.triangles[ lane ] = -1;
+			continue;
+		}
+
+		const traceTriangle_t& tt = traceTriangles[ node.items[ i ] ];
+		for ( int k = 0; k < 3; ++k )
+		{
+			block.v0[ k ][ lane ] = tt.v[ 0 ].xyz[ k ];
+			block.edge1[ k ][ lane ] = tt.edge1[ k ];
+			block.edge2[ k ][ lane ] = tt.edge2[ k ];
+		}
+		block.triangles[ lane ] = node.items[ i ];
+
+		/* the triangle grown by the barycentric slack */
+		const Vector3 grow = ( tt.edge1 + tt.edge2 ) * -TRACE_BLOCK_EPSILON;
+		MinMax bounds;
+		bounds.extend( tt.v[ 0 ].xyz + grow );
+		bounds.extend( tt.v[ 0 ].xyz + grow + tt.edge1 * ( 1.0f + 3 * TRACE_BLOCK_EPSILON ) );
+		bounds.extend( tt.v[ 0 ].xyz + grow + tt.edge2 * ( 1.0f + 3 * TRACE_BLOCK_EPSILON ) );
+		minmax.extend( bounds.mins - Vector3( TRACE_ON_EPSILON ) );
+		minmax.extend( bounds.maxs + Vector3( TRACE_ON_EPSILON ) );
+	}
+
+	traceFlatLeafs.push_back( leaf );
+	return traceFlatLeafs.size() - 1;
+}
+
+
+
+/*
+   SetupTraceFlat_r()
+   recursively copies the trace nodes depth first, returns the flat node number
+ */
+
+static int SetupTraceFlat_r( int nodeNum ){
+	const traceNode_t& node = traceNodes[ nodeNum ];
+	const int flatNum = traceFlatNodes.size();
+	traceFlatNodes.emplace_back();
+
+	traceFlatNode_t flat;
+	flat.plane = node.plane;
+	flat.type = node.type;
+	flat.numItems = node.numItems;
+	flat.numLeaves = 0;
+	flat.solid = ( node.type == TRACE_LEAF_SOLID );
+	flat.children[ 0 ] = flat.children[ 1 ] = -1;
+
+	if ( node.type >= 0 ) {
+		for ( int i = 0; i < 2; ++i )
+		{
+			flat.children[ i ] = SetupTraceFlat_r( node.children[ i ] );
+			const traceFlatNode_t& child = traceFlatNodes[ flat.children[ i ] ];
+			flat.numLeaves += child.numLeaves;
+			flat.solid |= child.solid;
+			flat.minmax.extend( child.minmax );
+		}
+	}
+	else if ( node.type == TRACE_LEAF ) {
+		flat.children[ 0 ] = SetupTraceFlatLeaf( node, flat.minmax );
+		flat.numLeaves = ( node.numItems > 0 );
+	}
+
+	traceFlatNodes[ flatNum ] = flat;
+	return flatNum;
+}
+
+
+
+
 /* -------------------------------------------------------------------------------
 
    trace initialization
@@ -1094,6 +1236,11 @@ void SetupTraceNodes(){
 	TriangulateTraceNode_r( headNodeNum );
 	TriangulateTraceNode_r( skyboxNodeNum );
 
+	/* flatten the tree */
+	if ( g_tracer == ETracer::Flat ) {
+		SetupTraceFlat_r( headNodeNum );
+	}
+
 	/* emit some stats */
 	//%	Sys_FPrintf( SYS_VRB, "%9d original triangles\n", numOriginalTriangles );
 	Sys_FPrintf( SYS_VRB, "%9d trace windings (%.2fMB)\n", numTraceWindings, (float) ( numTraceWindings * sizeof( *traceWindings ) ) / ( 1024.0f * 1024.0f ) );
@@ -1103,6 +1250,10 @@ void SetupTraceNodes(){
 	//%	Sys_FPrintf( SYS_VRB, "%9d average triangles per leaf node\n", numTraceTriangles / numTraceLeafNodes );
 	Sys_FPrintf( SYS_VRB, "%9d average windings per leaf node\n", numTraceWindings / ( numTraceLeafNodes + 1 ) );
 	Sys_FPrintf( SYS_VRB, "%9d max trace depth\n", maxTraceDepth );
+	if ( g_tracer == ETracer::Flat ) {
+		Sys_FPrintf( SYS_VRB, "%9zu flat trace nodes (%.2fMB)\n", traceFlatNodes.size(), (float) ( traceFlatNodes.size() * sizeof( traceFlatNode_t ) ) / ( 1024.0f * 1024.0f ) );
+		Sys_FPrintf( SYS_VRB, "%9zu trace triangle blocks (%.2fMB)\n", traceTriangleBlocks.size(), (float) ( traceTriangleBlocks.size() * sizeof( traceTriangleBlock_t ) ) / ( 1024.0f * 1024.0f ) );
+	}
 
 	/* free trace windings */
 	free( traceWindings );
@@ -1487,11 +1638,481 @@ static bool TraceLine_r( int nodeNum, const Vector3& origin, const Vector3& end,
 
 
 /*
-   TraceLine() - ydnar
-   rewrote this function a bit :)
+   traceFlatWalk_t
+   state of one TraceLineFlat() walk
  */
 
-void TraceLine( trace_t *trace ){
+struct traceFlatWalk_t
+{
+	trace_t *trace;
+	Vector3 invDir;
+	Vector3 solidHit;
+	int numLeaves;                      /* leaves with items, as trace_t::numTestNodes */
+	int numSkippedLeaves;               /* leaves with items in skipped subtrees */
+	bool skip;                          /* skip subtrees the trace misses */
+	bool done;                          /* a surface stopped the trace, only solid matters now */
+	bool solid;                         /* solid stopped the trace */
+
+	/* trace state to restore when the surfaces tested should not have been */
+	Vector3 hit, color;
+	float forceSubsampling;
+};
+
+
+
+/*
+   TraceFlatBounds()
+   returns true if the whole trace touches the bounds
+ */
+
+static bool TraceFlatBounds( const MinMax& minmax, const traceFlatWalk_t& walk ){
+	const Vector3& origin = walk.trace->origin;
+	float tNear = 0, tFar = walk.trace->distance;
+	for ( int k = 0; k < 3; ++k )
+	{
+		const float t1 = ( minmax.mins[ k ] - origin[ k ] ) * walk.invDir[ k ];
+		const float t2 = ( minmax.maxs[ k ] - origin[ k ] ) * walk.invDir[ k ];
+		tNear = std::max( tNear, std::min( t1, t2 ) );
+		tFar = std::min( tFar, std::max( t1, t2 ) );
+	}
+	return tNear <= tFar;
+}
+
+
+
+/*
+   TraceTriangleBlock()
+   loose version of the geometric part of TraceTriangle() for a block of triangles,
+   returns a mask of the lanes that may stop the trace
+ */
+
+static int TraceTriangleBlock( const traceTriangleBlock_t& block, const trace_t *trace ){
+#if TRACE_SSE
+	const __m128 dx = _mm_set1_ps( trace->direction[ 0 ] );
+	const __m128 dy = _mm_set1_ps( trace->direction[ 1 ] );
+	const __m128 dz = _mm_set1_ps( trace->direction[ 2 ] );
+	const __m128 e1x = _mm_loadu_ps( block.edge1[ 0 ] ), e1y = _mm_loadu_ps( block.edge1[ 1 ] ), e1z = _mm_loadu_ps( block.edge1[ 2 ] );
+	const __m128 e2x = _mm_loadu_ps( block.edge2[ 0 ] ), e2y = _mm_loadu_ps( block.edge2[ 1 ] ), e2z = _mm_loadu_ps( block.edge2[ 2 ] );
+
+	/* determinant */
+	const __m128 px = _mm_sub_ps( _mm_mul_ps( dy, e2z ), _mm_mul_ps( dz, e2y ) );
+	const __m128 py = _mm_sub_ps( _mm_mul_ps( dz, e2x ), _mm_mul_ps( dx, e2z ) );
+	const __m128 pz = _mm_sub_ps( _mm_mul_ps( dx, e2y ), _mm_mul_ps( dy, e2x ) );
+	const __m128 det = _mm_add_ps( _mm_add_ps( _mm_mul_ps( e1x, px ), _mm_mul_ps( e1y, py ) ), _mm_mul_ps( e1z, pz ) );
+	__m128 mask = _mm_cmpge_ps( _mm_andnot_ps( _mm_set1_ps( -0.0f ), det ), _mm_set1_ps( COPLANAR_EPSILON * 0.5f ) );
+	const __m128 invDet = _mm_div_ps( _mm_set1_ps( 1.0f ), det );
+
+	/* u */
+	const __m128 tx = _mm_sub_ps( _mm_set1_ps( trace->origin[ 0 ] ), _mm_loadu_ps( block.v0[ 0 ] ) );
+	const __m128 ty = _mm_sub_ps( _mm_set1_ps( trace->origin[ 1 ] ), _mm_loadu_ps( block.v0[ 1 ] ) );
+	const __m128 tz = _mm_sub_ps( _mm_set1_ps( trace->origin[ 2 ] ), _mm_loadu_ps( block.v0[ 2 ] ) );
+	const __m128 u = _mm_mul_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( tx, px ), _mm_mul_ps( ty, py ) ), _mm_mul_ps( tz, pz ) ), invDet );
+
+	/* v and depth */
+	const __m128 qx = _mm_sub_ps( _mm_mul_ps( ty, e1z ), _mm_mul_ps( tz, e1y ) );
+	const __m128 qy = _mm_sub_ps( _mm_mul_ps( tz, e1x ), _mm_mul_ps( tx, e1z ) );
+	const __m128 qz = _mm_sub_ps( _mm_mul_ps( tx, e1y ), _mm_mul_ps( ty, e1x ) );
+	const __m128 v = _mm_mul_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( dx, qx ), _mm_mul_ps( dy, qy ) ), _mm_mul_ps( dz, qz ) ), invDet );
+	const __m128 depth = _mm_mul_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( e2x, qx ), _mm_mul_ps( e2y, qy ) ), _mm_mul_ps( e2z, qz ) ), invDet );
+
+	/* NaN lanes fail every compare */
+	mask = _mm_and_ps( mask, _mm_cmpge_ps( u, _mm_set1_ps( -TRACE_BLOCK_EPSILON ) ) );
+	mask = _mm_and_ps( mask, _mm_cmple_ps( u, _mm_set1_ps( 1.0f + TRACE_BLOCK_EPSILON ) ) );
+	mask = _mm_and_ps( mask, _mm_cmpge_ps( v, _mm_set1_ps( -TRACE_BLOCK_EPSILON ) ) );
+	mask = _mm_and_ps( mask, _mm_cmple_ps( _mm_add_ps( u, v ), _mm_set1_ps( 1.0f + TRACE_BLOCK_EPSILON ) ) );
+	mask = _mm_and_ps( mask, _mm_cmpgt_ps( depth, _mm_set1_ps( trace->inhibitRadius - TRACE_ON_EPSILON ) ) );
+	mask = _mm_and_ps( mask, _mm_cmplt_ps( depth, _mm_set1_ps( trace->distance + TRACE_ON_EPSILON ) ) );
+	return _mm_movemask_ps( mask );
+#else
+	int mask = 0;
+	for ( int j = 0; j < TRACE_BLOCK_SIZE; ++j )
+	{
+		const Vector3 edge1( block.edge1[ 0 ][ j ], block.edge1[ 1 ][ j ], block.edge1[ 2 ][ j ] );
+		const Vector3 edge2( block.edge2[ 0 ][ j ], block.edge2[ 1 ][ j ], block.edge2[ 2 ][ j ] );
+		const Vector3 pvec = vector3_cross( trace->direction, edge2 );
+		const float det = vector3_dot( edge1, pvec );
+		if ( !( std::fabs( det ) >= COPLANAR_EPSILON * 0.5f ) ) {
+			continue;
+		}
+		const float invDet = 1.0f / det;
+		const Vector3 tvec = trace->origin - Vector3( block.v0[ 0 ][ j ], block.v0[ 1 ][ j ], block.v0[ 2 ][ j ] );
+		const float u = vector3_dot( tvec, pvec ) * invDet;
+		const Vector3 qvec = vector3_cross( tvec, edge1 );
+		const float v = vector3_dot( trace->direction, qvec ) * invDet;
+		const float depth = vector3_dot( edge2, qvec ) * invDet;
+		if ( u >= -TRACE_BLOCK_EPSILON && u <= 1.0f + TRACE_BLOCK_EPSILON
+		  && v >= -TRACE_BLOCK_EPSILON && u + v <= 1.0f + TRACE_BLOCK_EPSILON
+		  && depth > trace->inhibitRadius - TRACE_ON_EPSILON && depth < trace->distance + TRACE_ON_EPSILON ) {
+			mask |= 1 << j;
+		}
+	}
+	return mask;
+#endif
+}
+
+
+
+/*
+   TraceFlatLeaf()
+   tests the triangles of a flattened trace leaf in item order, returns true if one stops the trace
+ */
+
+static bool TraceFlatLeaf( const traceFlatNode_t& node, traceFlatWalk_t& walk ){
+	/* skip leaves the whole trace misses */
+	if ( !TraceFlatBounds( node.minmax, walk ) ) {
+		return false;
+	}
+
+	const traceFlatLeaf_t& leaf = traceFlatLeafs[ node.children[ 0 ] ];
+
+	for ( const traceTriangleBlock_t& block : Span( &traceTriangleBlocks[ leaf.firstBlock ], leaf.numBlocks ) )
+	{
+		/* the lanes left are tested properly, padding never gets here */
+		const int mask = TraceTriangleBlock( block, walk.trace );
+		for ( int j = 0; j < TRACE_BLOCK_SIZE; ++j )
+		{
+			if ( mask & ( 1 << j ) ) {
+				const traceTriangle_t& tt = traceTriangles[ block.triangles[ j ] ];
+				if ( TraceTriangle( traceInfos[ tt.infoNum ], tt, walk.trace ) ) {
+					return true;
+				}
+			}
+		}
+	}
+
+	return false;
+}
+
+
+
+/*
+   TraceLineFlat_r()
+   TraceLine_r() on the flattened trace tree, testing leaf triangles as they are reached
+   returns true if solid is hit and tracing can stop
+ */
+
+static bool TraceLineFlat_r( int nodeNum, Vector3 origin, const Vector3& end, traceFlatWalk_t& walk ){
+	float front, back;
+
+	while ( true )
+	{
+		const traceFlatNode_t& node = traceFlatNodes[ nodeNum ];
+
+		/* solid? */
+		if ( node.type == TRACE_LEAF_SOLID ) {
+			walk.solidHit = origin;
+			return true;
+		}
+
+		/* leafnode? */
+		if ( node.type < 0 ) {
+			if ( !walk.done && node.numItems > 0 && walk.numLeaves < MAX_TRACE_TEST_NODES ) {
+				walk.numLeaves++;
+				walk.done = TraceFlatLeaf( node, walk );
+			}
+			return false;
+		}
+
+		/* nothing left to find in here */
+		if ( !node.solid ) {
+			if ( walk.done || node.numLeaves == 0 ) {
+				return false;
+			}
+			if ( walk.skip && !TraceFlatBounds( node.minmax, walk ) ) {
+				walk.numSkippedLeaves += node.numLeaves;
+				return false;
+			}
+		}
+
+		/* ydnar 2003-09-07: don't test branches of the bsp with nothing in them when testall is enabled */
+		if ( walk.trace->testAll && node.numItems == 0 ) {
+			return false;
+		}
+
+		/* classify beginning and end points */
+		switch ( node.type )
+		{
+		case ePlaneX:
+			front = origin[ 0 ] - node.plane.dist();
+			back = end[ 0 ] - node.plane.dist();
+			break;
+
+		case ePlaneY:
+			front = origin[ 1 ] - node.plane.dist();
+			back = end[ 1 ] - node.plane.dist();
+			break;
+
+		case ePlaneZ:
+			front = origin[ 2 ] - node.plane.dist();
+			back = end[ 2 ] - node.plane.dist();
+			break;
+
+		default:
+			front = plane3_distance_to_point( node.plane, origin );
+			back = plane3_distance_to_point( node.plane, end );
+			break;
+		}
+
+		/* entirely in front side? */
+		if ( front >= -TRACE_ON_EPSILON && back >= -TRACE_ON_EPSILON ) {
+			nodeNum = node.children[ 0 ];
+			continue;
+		}
+
+		/* entirely on back side? */
+		if ( front < TRACE_ON_EPSILON && back < TRACE_ON_EPSILON ) {
+			nodeNum = node.children[ 1 ];
+			continue;
+		}
+
+		/* trace first side, then the other */
+		const int side = front < 0;
+		const float frac = front / ( front - back );
+		const Vector3 mid = origin + ( end - origin ) * frac;
+		if ( TraceLineFlat_r( node.children[ side ], origin, mid, walk ) ) {
+			return true;
+		}
+		nodeNum = node.children[ !side ];
+		origin = mid;
+	}
+}
+
+
+
+/*
+   TraceLineFlatPacket_r()
+   TraceLineFlat_r() for a packet of traces walking the tree together
+   every trace still visits its nodes in its own order, the packet only shares the node visits
+ */
+
+struct traceFlatRay_t
+{
+	traceFlatWalk_t *walk;
+	Vector3 origin, end;
+};
+
+static void TraceLineFlatPacket_r( int nodeNum, const traceFlatRay_t *rays, int numRays ){
+	/* a lone trace walks on by itself */
+	if ( numRays == 1 ) {
+		if ( !rays->walk->solid ) {
+			rays->walk->solid = TraceLineFlat_r( nodeNum, rays->origin, rays->end, *rays->walk );
+		}
+		return;
+	}
+
+	const traceFlatNode_t& node = traceFlatNodes[ nodeNum ];
+
+	/* solid? */
+	if ( node.type == TRACE_LEAF_SOLID ) {
+		for ( const traceFlatRay_t& ray : Span( rays, numRays ) )
+		{
+			if ( !ray.walk->solid ) {
+				ray.walk->solidHit = ray.origin;
+				ray.walk->solid = true;
+			}
+		}
+		return;
+	}
+
+	/* leafnode? */
+	if ( node.type < 0 ) {
+		for ( const traceFlatRay_t& ray : Span( rays, numRays ) )
+		{
+			traceFlatWalk_t& walk = *ray.walk;
+			if ( !walk.solid && !walk.done && node.numItems > 0 && walk.numLeaves < MAX_TRACE_TEST_NODES ) {
+				walk.numLeaves++;
+				walk.done = TraceFlatLeaf( node, walk );
+			}
+		}
+		return;
+	}
+
+	/* sort the traces by the child they visit first; split traces visit the other one after that */
+	traceFlatRay_t toFront[ TRACE_PACKET_SIZE ], toBack[ TRACE_PACKET_SIZE ], toFrontLast[ TRACE_PACKET_SIZE ];
+	int numToFront = 0, numToBack = 0, numToFrontLast = 0;
+	float front, back;
+
+	for ( const traceFlatRay_t& ray : Span( rays, numRays ) )
+	{
+		traceFlatWalk_t& walk = *ray.walk;
+		if ( walk.solid ) {
+			continue;
+		}
+
+		/* nothing left to find in here */
+		if ( !node.solid ) {
+			if ( walk.done || node.numLeaves == 0 ) {
+				continue;
+			}
+			if ( walk.skip && !TraceFlatBounds( node.minmax, walk ) ) {
+				walk.numSkippedLeaves += node.numLeaves;
+				continue;
+			}
+		}
+
+		/* ydnar 2003-09-07: don't test branches of the bsp with nothing in them when testall is enabled */
+		if ( walk.trace->testAll && node.numItems == 0 ) {
+			continue;
+		}
+
+		/* classify beginning and end points */
+		switch ( node.type )
+		{
+		case ePlaneX:
+			front = ray.origin[ 0 ] - node.plane.dist();
+			back = ray.end[ 0 ] - node.plane.dist();
+			break;
+
+		case ePlaneY:
+			front = ray.origin[ 1 ] - node.plane.dist();
+			back = ray.end[ 1 ] - node.plane.dist();
+			break;
+
+		case ePlaneZ:
+			front = ray.origin[ 2 ] - node.plane.dist();
+			back = ray.end[ 2 ] - node.plane.dist();
+			break;
+
+		default:
+			front = plane3_distance_to_point( node.plane, ray.origin );
+			back = plane3_distance_to_point( node.plane, ray.end );
+			break;
+		}
+
+		/* entirely in front side? */
+		if ( front >= -TRACE_ON_EPSILON && back >= -TRACE_ON_EPSILON ) {
+			toFront[ numToFront++ ] = ray;
+		}
+		/* entirely on back side? */
+		else if ( front < TRACE_ON_EPSILON && back < TRACE_ON_EPSILON ) {
+			toBack[ numToBack++ ] = ray;
+		}
+		/* first side, then the other */
+		else
+		{
+			const float frac = front / ( front - back );
+			const Vector3 mid = ray.origin + ( ray.end - ray.origin ) * frac;
+			if ( front < 0 ) {
+				toBack[ numToBack++ ] = { ray.walk, ray.origin, mid };
+				toFrontLast[ numToFrontLast++ ] = { ray.walk, mid, ray.end };
+			}
+			else{
+				toFront[ numToFront++ ] = { ray.walk, ray.origin, mid };
+				toBack[ numToBack++ ] = { ray.walk, mid, ray.end };
+			}
+		}
+	}
+
+	if ( numToFront != 0 ) {
+		TraceLineFlatPacket_r( node.children[ 0 ], toFront, numToFront );
+	}
+	if ( numToBack != 0 ) {
+		TraceLineFlatPacket_r( node.children[ 1 ], toBack, numToBack );
+	}
+	if ( numToFrontLast != 0 ) {
+		TraceLineFlatPacket_r( node.children[ 0 ], toFrontLast, numToFrontLast );
+	}
+}
+
+
+
+/*
+   TraceLineFlatBegin()
+   prepares a walk of the flattened trace tree
+ */
+
+static void TraceLineFlatBegin( traceFlatWalk_t& walk, trace_t *trace, bool skip ){
+	walk.trace = trace;
+	for ( int k = 0; k < 3; ++k )
+		walk.invDir[ k ] = ( trace->direction[ k ] != 0 )? 1.0f / trace->direction[ k ] : 1e30f;
+	walk.numLeaves = 0;
+	walk.numSkippedLeaves = 0;
+	walk.skip = skip;
+	walk.done = noSurfaces;
+	walk.solid = false;
+
+	walk.hit = trace->hit;
+	walk.color = trace->color;
+	walk.forceSubsampling = trace->forceSubsampling;
+}
+
+
+
+/*
+   TraceLineFlatRestore()
+   undoes what the surfaces tested did to the trace
+ */
+
+static void TraceLineFlatRestore( const traceFlatWalk_t& walk ){
+	trace_t *trace = walk.trace;
+	trace->hit = walk.hit;
+	trace->color = walk.color;
+	trace->forceSubsampling = walk.forceSubsampling;
+	trace->compileFlags = 0;
+	memset( trace->skyIndices, 0, sizeof( trace->skyIndices ) );
+	trace->opaque = false;
+}
+
+
+
+/*
+   TraceLineFlatEnd()
+   turns a finished walk into the TraceLine() result
+   surfaces are tested during the walk instead of after it, so whatever they did to the trace
+   is undone if solid turns up later and the bsp tracer would not have tested them at all
+ */
+
+static void TraceLineFlat( trace_t *trace, bool skip );
+
+static void TraceLineFlatEnd( const traceFlatWalk_t& walk ){
+	trace_t *trace = walk.trace;
+
+	/* the bsp tracer tests MAX_TRACE_TEST_NODES leaves at most, which the skipped ones may have used up */
+	if ( walk.numLeaves + walk.numSkippedLeaves > MAX_TRACE_TEST_NODES ) {
+		TraceLineFlatRestore( walk );
+		TraceLineFlat( trace, false );
+		return;
+	}
+
+	if ( walk.solid ) {
+		trace->passSolid = true;
+		if ( !trace->testAll ) {
+			TraceLineFlatRestore( walk );
+			trace->hit = walk.solidHit;
+			trace->opaque = true;
+			return;
+		}
+		if ( !trace->opaque ) {
+			trace->hit = walk.solidHit;
+		}
+	}
+
+	/* the skybox nodes are not walked: TraceLine() only does so for C_SKY in
+	   trace->compileFlags before any surface is tested, when it is always clear */
+}
+
+
+
+/*
+   TraceLineFlat()
+   TraceLine() on the flattened trace tree
+ */
+
+static void TraceLineFlat( trace_t *trace, bool skip ){
+	traceFlatWalk_t walk;
+	TraceLineFlatBegin( walk, trace, skip );
+	walk.solid = TraceLineFlat_r( 0, trace->origin, trace->end, walk );
+	TraceLineFlatEnd( walk );
+}
+
+
+
+/*
+   TraceLineSetup()
+   clears the trace output, returns false if there is nothing to trace
+ */
+
+static bool TraceLineSetup( trace_t *trace ){
 	/* setup output (note: this code assumes the input data is completely filled out) */
 	trace->passSolid = false;
 	trace->opaque = false;
@@ -1500,7 +2121,29 @@ void TraceLine( trace_t *trace ){
 	trace->numTestNodes = 0;
 
 	/* early outs */
-	if ( !trace->recvShadows || !trace->testOcclusion || trace->distance <= 0.00001f ) {
+	return trace->recvShadows && trace->testOcclusion && trace->distance > 0.00001f;
+}
+
+
+
+/*
+   TraceLine() - ydnar
+   rewrote this function a bit :)
+ */
+
+void TraceLine( trace_t *trace ){
+	if ( profiling ) {
+		numProfiledTraces.fetch_add( 1, std::memory_order_relaxed );
+	}
+
+	/* setup output and early outs */
+	if ( !TraceLineSetup( trace ) ) {
+		return;
+	}
+
+	/* flattened trace tree */
+	if ( g_tracer == ETracer::Flat ) {
+		TraceLineFlat( trace, true );
 		return;
 	}
 
@@ -1546,6 +2189,48 @@ void TraceLine( trace_t *trace ){
 
 
 
+/*
+   TraceLines()
+   TraceLine() for a batch of traces, the flattened trace tree walks them in packets
+   results are the same as tracing them one by one
+ */
+
+void TraceLines( trace_t *const *traces, int numTraces ){
+	if ( g_tracer != ETracer::Flat ) {
+		for ( trace_t *trace : Span( traces, numTraces ) )
+			TraceLine( trace );
+		return;
+	}
+
+	if ( profiling ) {
+		numProfiledTraces.fetch_add( numTraces, std::memory_order_relaxed );
+	}
+
+	for ( int i = 0; i < numTraces; i += TRACE_PACKET_SIZE )
+	{
+		traceFlatWalk_t walks[ TRACE_PACKET_SIZE ];
+		traceFlatRay_t rays[ TRACE_PACKET_SIZE ];
+		int numRays = 0;
+
+		for ( trace_t *trace : Span( traces + i, std::min( numTraces - i, TRACE_PACKET_SIZE ) ) )
+		{
+			if ( TraceLineSetup( trace ) ) {
+				TraceLineFlatBegin( walks[ numRays ], trace, true );
+				rays[ numRays ] = { &walks[ numRays ], trace->origin, trace->end };
+				numRays++;
+			}
+		}
+
+		if ( numRays != 0 ) {
+			TraceLineFlatPacket_r( 0, rays, numRays );
+			for ( const traceFlatWalk_t& walk : Span( walks, numRays ) )
+				TraceLineFlatEnd( walk );
+		}
+	}
+}
+
+
+
 /*
    SetupTrace() - ydnar
    sets up certain trace values
@@ -31,6 +31,7 @@
 /* dependencies */
 #include "q3map2.h"
 #include "timer.h"
+#include "visbits.h"
 
 
 // http://www.graficaobscura.com/matrix/index.html
@@ -304,6 +305,36 @@ bool ClusterVisible( int a, int b ){
 
 
 
+/*
+   ClusterVisibleAny()
+   returns true if cluster a can see any cluster of the set,
+   same as ClusterVisible() for each of them
+ */
+
+static bool ClusterVisibleAny( int a, const VisBitSet& clusters ){
+	/* dummy check */
+	if ( a < CLUSTER_NORMAL || clusters.empty() ) {
+		return false;
+	}
+
+	/* not vised? */
+	if ( bspVisBytes.size() <= 8 ) {
+		return true;
+	}
+
+	const int numClusters = ( (int*) bspVisBytes.data() )[ 0 ];
+	const int leafBytes = ( (int*) bspVisBytes.data() )[ 1 ];
+	if ( a >= numClusters ) {
+		return false;
+	}
+
+	/* a cluster sees itself */
+	return clusters.test( a )
+	    || clusters.anyEnabled( bspVisBytes.data() + VIS_HEADER_SIZE + ( a * leafBytes ), leafBytes );
+}
+
+
+
 /*
    PointInLeafNum_r()
    borrowed from vlight.c
@@ -1118,6 +1149,24 @@ static bool MapQuad( rawLightmap_t *lm, const surfaceInfo_t *info, const QuadRef
 
 
 
+/*
+   RawLightmapsByCost()
+   raw lightmap indices ordered by supersampled luxel count, largest first,
+   so that threads start on the long running lightmaps and share out the small ones at the end
+ */
+
+std::vector<int> RawLightmapsByCost(){
+	std::vector<int> order( numRawLightmaps );
+	for ( int i = 0; i < numRawLightmaps; ++i )
+		order[ i ] = i;
+	std::ranges::stable_sort( order, []( int a, int b ){
+		return rawLightmaps[ a ].sw * rawLightmaps[ a ].sh > rawLightmaps[ b ].sw * rawLightmaps[ b ].sh;
+	} );
+	return order;
+}
+
+
+
 /*
    MapRawLightmap()
    maps the locations, normals, and pvs clusters for a raw lightmap
@@ -1454,6 +1503,10 @@ static float DirtForSample( trace_t *trace ){
 	int i;
 	float gatherDirt, outDirt, angle, elevation, ooDepth;
 	Vector3 myUp, myRt;
+	trace_t packet[ TRACE_PACKET_SIZE ];
+	trace_t *packetTraces[ TRACE_PACKET_SIZE ];
+	bool packetSkyOpen[ TRACE_PACKET_SIZE ];
+	int numPacket = 0;
 
 
 	/* dummy check */
@@ -1486,11 +1539,18 @@ static float DirtForSample( trace_t *trace ){
 		myUp = VectorNormalized( vector3_cross( myRt, normal ) );
 	}
 
-	/* 1 = random mode, 0 (well everything else) = non-random mode */
-	if ( dirtMode == 1 ) {
-		/* iterate */
-		for ( i = 0; i < numDirtVectors; ++i )
-		{
+	/* the dirt vectors, then the direct ray, traced in packets */
+	std::fill_n( packet, TRACE_PACKET_SIZE, *trace );
+	for ( i = 0; i <= numDirtVectors; ++i )
+	{
+		Vector3 direction;
+
+		/* direct ray */
+		if ( i == numDirtVectors ) {
+			direction = normal;
+		}
+		/* 1 = random mode, 0 (well everything else) = non-random mode */
+		else if ( dirtMode == 1 ) {
 			/* get random vector */
 			angle = Random() * degrees_to_radians( 360.0f );
 			elevation = Random() * degrees_to_radians( DIRT_CONE_ANGLE );
@@ -1499,52 +1559,37 @@ static float DirtForSample( trace_t *trace ){
 			                    cos( elevation ) );
 
 			/* transform into tangent space */
-			const Vector3 direction = myRt * temp[ 0 ] + myUp * temp[ 1 ] + normal * temp[ 2 ];
-
-			/* set endpoint */
-			trace->end = trace->origin + direction * dirtDepth;
-			SetupTrace( trace );
-			trace->color.set( 1 );
-
-			/* trace */
-			TraceLine( trace );
-			if ( trace->opaque && !( trace->compileFlags & C_SKY ) ) {
-				gatherDirt += 1.0f - ooDepth * vector3_length( trace->hit - trace->origin );
-			}
+			direction = myRt * temp[ 0 ] + myUp * temp[ 1 ] + normal * temp[ 2 ];
 		}
-	}
-	else
-	{
-		/* iterate through ordered vectors */
-		for ( i = 0; i < numDirtVectors; ++i )
+		else
 		{
 			/* transform vector into tangent space */
-			const Vector3 direction = myRt * dirtVectors[ i ][ 0 ] + myUp * dirtVectors[ i ][ 1 ] + normal * dirtVectors[ i ][ 2 ];
+			direction = myRt * dirtVectors[ i ][ 0 ] + myUp * dirtVectors[ i ][ 1 ] + normal * dirtVectors[ i ][ 2 ];
+		}
 
-			/* set endpoint */
-			trace->end = trace->origin + direction * dirtDepth;
-			SetupTrace( trace );
-			trace->color.set( 1 );
+		/* set endpoint */
+		trace_t& sample = packet[ numPacket ];
+		sample.end = sample.origin + direction * dirtDepth;
+		SetupTrace( &sample );
+		sample.color.set( 1 );
+		packetTraces[ numPacket ] = &sample;
 
-			/* trace */
-			TraceLine( trace );
-			if ( trace->opaque ) {
-				gatherDirt += 1.0f - ooDepth * vector3_length( trace->hit - trace->origin );
+		/* random mode does not count sky on the dirt vectors */
+		packetSkyOpen[ numPacket++ ] = ( dirtMode == 1 && i != numDirtVectors );
+
+		/* trace */
+		if ( numPacket == TRACE_PACKET_SIZE || i == numDirtVectors ) {
+			TraceLines( packetTraces, numPacket );
+			for ( int j = 0; j < numPacket; ++j )
+			{
+				if ( packet[ j ].opaque && !( packetSkyOpen[ j ] && ( packet[ j ].compileFlags & C_SKY ) ) ) {
+					gatherDirt += 1.0f - ooDepth * vector3_length( packet[ j ].hit - packet[ j ].origin );
+				}
 			}
+			numPacket = 0;
 		}
 	}
 
-	/* direct ray */
-	trace->end = trace->origin + normal * dirtDepth;
-	SetupTrace( trace );
-	trace->color.set( 1 );
-
-	/* trace */
-	TraceLine( trace );
-	if ( trace->opaque ) {
-		gatherDirt += 1.0f - ooDepth * vector3_length( trace->hit - trace->origin );
-	}
-
 	/* early out */
 	if ( gatherDirt <= 0 ) {
 		return 1;
@@ -1794,6 +1839,8 @@ static void SubsampleRawLuxel_r( rawLightmap_t *lm, trace_t *trace, const Vector
 	Vector3 origin[ 4 ], normal[ 4 ];
 	float biasDirs[ 4 ][ 2 ] = { { -1, -1 }, { 1, -1 }, { -1, 1 }, { 1, 1 } };
 	Vector3 color, direction( 0 ), total( 0 );
+	trace_t packet[ 4 ];
+	int packetB[ 4 ], numPacket = 0;
 
 
 	/* limit check */
@@ -1822,14 +1869,22 @@ static void SubsampleRawLuxel_r( rawLightmap_t *lm, trace_t *trace, const Vector
 		luxel[ b ].count = lightLuxel.count + 1;
 
 		/* setup trace */
-		trace->cluster = *cluster;
-		trace->origin = origin[ b ];
-		trace->normal = normal[ b ];
+		trace_t& sample = packet[ numPacket ];
+		sample = *trace;
+		sample.cluster = *cluster;
+		sample.origin = origin[ b ];
+		sample.normal = normal[ b ];
+		packetB[ numPacket++ ] = b;
+	}
 
-		/* sample light */
+	/* sample light */
+	LightContributionToSamples( packet, numPacket );
+	for ( int i = 0; i < numPacket; ++i )
+	{
+		const trace_t& sample = packet[ i ];
+		b = packetB[ i ];
 
-		LightContributionToSample( trace );
-		if ( trace->forceSubsampling > 1 ) {
+		if ( sample.forceSubsampling > 1 ) {
 			/* alphashadow: we subsample as deep as we can */
 			++lighted;
 			++mapped;
@@ -1837,11 +1892,11 @@ static void SubsampleRawLuxel_r( rawLightmap_t *lm, trace_t *trace, const Vector
 		}
 
 		/* add to totals (fixme: make contrast function) */
-		luxel[ b ].value = trace->color;
+		luxel[ b ].value = sample.color;
 		if ( lightDeluxel ) {
-			deluxel[ b ] = trace->directionContribution;
+			deluxel[ b ] = sample.directionContribution;
 		}
-		total += trace->color;
+		total += sample.color;
 		if ( ( luxel[ b ].value[ 0 ] + luxel[ b ].value[ 1 ] + luxel[ b ].value[ 2 ] ) > 0 ) {
 			lighted++;
 		}
@@ -1914,6 +1969,8 @@ static void RandomSubsampleRawLuxel( rawLightmap_t *lm, trace_t *trace, const Ve
 	Vector3 origin, normal;
 	Vector3 total( 0 ), totaldirection( 0 );
 	float dx, dy;
+	trace_t packet[ TRACE_PACKET_SIZE ];
+	int numPacket = 0;
 
 	for ( b = 0; b < lightSamples; ++b )
 	{
@@ -1922,20 +1979,27 @@ static void RandomSubsampleRawLuxel( rawLightmap_t *lm, trace_t *trace, const Ve
 		GaussLikeRandom( bias, &dx, &dy );
 
 		/* calculate position */
-		if ( !SubmapRawLuxel( lm, x, y, dx, dy, cluster, origin, normal ) ) {
-			cluster = CLUSTER_UNMAPPED;
-			continue;
+		if ( SubmapRawLuxel( lm, x, y, dx, dy, cluster, origin, normal ) ) {
+			mapped++;
+
+			trace_t& sample = packet[ numPacket++ ];
+			sample = *trace;
+			sample.cluster = cluster;
+			sample.origin = origin;
+			sample.normal = normal;
 		}
-		mapped++;
 
-		trace->cluster = cluster;
-		trace->origin = origin;
-		trace->normal = normal;
-
-		LightContributionToSample( trace );
-		total += trace->color;
-		if ( lightDeluxel ) {
-			totaldirection += trace->directionContribution;
+		/* sample light in packets */
+		if ( numPacket == TRACE_PACKET_SIZE || ( b == lightSamples - 1 && numPacket != 0 ) ) {
+			LightContributionToSamples( packet, numPacket );
+			for ( const trace_t& sample : Span( packet, numPacket ) )
+			{
+				total += sample.color;
+				if ( lightDeluxel ) {
+					totaldirection += sample.directionContribution;
+				}
+			}
+			numPacket = 0;
 		}
 	}
 
@@ -1952,27 +2016,159 @@ static void RandomSubsampleRawLuxel( rawLightmap_t *lm, trace_t *trace, const Ve
 
 
 
+/*
+   light index
+   a bounding volume hierarchy over the light envelopes, rebuilt by SetupEnvelopes()
+   lights with unbounded envelopes (sunlight) are kept in a separate list
+ */
+
+struct LightIndexNode
+{
+	MinMax minmax;
+	int first, count;   /* leaf: range of lightIndexOrder */
+	int child;          /* inner node: children are child and child + 1 */
+};
+
+static std::vector<const light_t*> indexedLights;     /* in lights order */
+static std::vector<MinMax> indexedEnvelopes;
+static std::vector<int> lightIndexOrder;
+static std::vector<LightIndexNode> lightIndexNodes;
+static std::vector<int> unboundedLights;
+
+#define LIGHT_INDEX_LEAF_SIZE   4
+
+static void BuildLightIndex_r( int nodeNum, int first, int count ){
+	MinMax minmax, centers;
+	for ( const int i : Span( &lightIndexOrder[ first ], count ) )
+	{
+		minmax.extend( indexedEnvelopes[ i ] );
+		centers.extend( indexedEnvelopes[ i ].origin() );
+	}
+	lightIndexNodes[ nodeNum ].minmax = minmax;
+
+	if ( count <= LIGHT_INDEX_LEAF_SIZE ) {
+		lightIndexNodes[ nodeNum ].first = first;
+		lightIndexNodes[ nodeNum ].count = count;
+		return;
+	}
+
+	/* split at the median of the longest axis */
+	const Vector3 size = centers.maxs - centers.mins;
+	const int axis = size[ 0 ] > size[ 1 ]
+	                 ? ( size[ 0 ] > size[ 2 ]? 0 : 2 )
+	                 : ( size[ 1 ] > size[ 2 ]? 1 : 2 );
+	const int half = count / 2;
+	std::nth_element( &lightIndexOrder[ first ], &lightIndexOrder[ first + half ], &lightIndexOrder[ first ] + count, [axis]( int a, int b ){
+		return indexedEnvelopes[ a ].mins[ axis ] + indexedEnvelopes[ a ].maxs[ axis ]
+		     < indexedEnvelopes[ b ].mins[ axis ] + indexedEnvelopes[ b ].maxs[ axis ];
+	} );
+
+	const int child = lightIndexNodes.size();
+	lightIndexNodes.resize( child + 2 );
+	lightIndexNodes[ nodeNum ].count = 0;
+	lightIndexNodes[ nodeNum ].child = child;
+	BuildLightIndex_r( child, first, half );
+	BuildLightIndex_r( child + 1, first + half, count - half );
+}
+
+static void SetupLightIndex(){
+	indexedLights.clear();
+	indexedEnvelopes.clear();
+	lightIndexOrder.clear();
+	lightIndexNodes.clear();
+	unboundedLights.clear();
+
+	for ( const light_t& light : lights )
+	{
+		const int index = indexedLights.size();
+		indexedLights.push_back( &light );
+		indexedEnvelopes.emplace_back( light.origin - Vector3( light.envelope ), light.origin + Vector3( light.envelope ) );
+		if ( light.type == ELightType::Sun || light.envelope >= MAX_WORLD_COORD ) {
+			unboundedLights.push_back( index );
+		}
+		else
+		{
+			lightIndexOrder.push_back( index );
+		}
+	}
+
+	if ( !lightIndexOrder.empty() ) {
+		lightIndexNodes.resize( 1 );
+		BuildLightIndex_r( 0, 0, lightIndexOrder.size() );
+	}
+}
+
+/* appends the lights whose envelope box is within radius of origin */
+static void QueryLightIndex( const Vector3& origin, float radius, std::vector<int>& found ){
+	if ( lightIndexNodes.empty() ) {
+		return;
+	}
+
+	int stack[ 64 ];
+	int numStack = 0;
+	stack[ numStack++ ] = 0;
+	while ( numStack != 0 )
+	{
+		const LightIndexNode& node = lightIndexNodes[ stack[ --numStack ] ];
+
+		/* squared distance from origin to the node bounds */
+		float dist2 = 0;
+		for ( int i = 0; i < 3; ++i )
+		{
+			const float d = std::max( { node.minmax.mins[ i ] - origin[ i ], 0.f, origin[ i ] - node.minmax.maxs[ i ] } );
+			dist2 += d * d;
+		}
+		if ( dist2 > radius * radius ) {
+			continue;
+		}
+
+		if ( node.count != 0 ) {
+			found.insert( found.end(), &lightIndexOrder[ node.first ], &lightIndexOrder[ node.first ] + node.count );
+		}
+		else
+		{
+			stack[ numStack++ ] = node.child;
+			stack[ numStack++ ] = node.child + 1;
+		}
+	}
+}
+
+
+
 /*
    CreateTraceLightsForBounds()
    creates a list of lights that affect the given bounding box and pvs clusters (bsp leaves)
  */
 
 static void CreateTraceLightsForBounds( const MinMax& minmax, const Vector3 *normal, int numClusters, int *clusters, LightFlags flags, trace_t *trace ){
-	int i;
 	float length;
 
 
 	/* debug code */
 	//% Sys_Printf( "CTWLFB: (%4.1f %4.1f %4.1f) (%4.1f %4.1f %4.1f)\n", minmax.mins[ 0 ], minmax.mins[ 1 ], minmax.mins[ 2 ], minmax.maxs[ 0 ], minmax.maxs[ 1 ], minmax.maxs[ 2 ] );
 
-	/* allocate the light list */
-	trace->lights = safe_malloc( sizeof( light_t* ) * ( lights.size() + 1 ) );
-	trace->numLights = 0;
-
 	/* calculate spherical bounds */
 	const Vector3 origin = minmax.origin();
 	const float radius = vector3_length( minmax.maxs - origin );
 
+	/* find the lights with an envelope near the sphere, in lights order, so the result does not depend on the index */
+	std::vector<int> candidates( unboundedLights );
+	QueryLightIndex( origin, radius + 1, candidates );
+	std::sort( candidates.begin(), candidates.end() );
+
+	/* lights not found can't reach the sphere */
+	lightsEnvelopeCulled += indexedLights.size() - candidates.size();
+
+	/* gather the clusters into words for the pvs checks */
+	VisBitSet clusterSet;
+	if ( numClusters > 0 && clusters != nullptr ) {
+		clusterSet.assign( clusters, numClusters );
+	}
+
+	/* allocate the light list */
+	trace->lights = safe_malloc( sizeof( light_t* ) * ( candidates.size() + 1 ) );
+	trace->numLights = 0;
+
 	/* get length of normal vector */
 	if ( normal != nullptr ) {
 		length = vector3_length( *normal );
@@ -1985,8 +2181,10 @@ static void CreateTraceLightsForBounds( const MinMax& minmax, const Vector3 *nor
 
 	/* test each light and see if it reaches the sphere */
 	/* note: the attenuation code MUST match LightingAtSample() */
-	for ( const light_t& light : lights )
+	for ( const int index : candidates )
 	{
+		const light_t& light = *indexedLights[ index ];
+
 		/* check zero sized envelope */
 		if ( light.envelope <= 0 ) {
 			lightsEnvelopeCulled++;
@@ -2007,15 +2205,7 @@ static void CreateTraceLightsForBounds( const MinMax& minmax, const Vector3 *nor
 
 			/* check against pvs cluster */
 			if ( numClusters > 0 && clusters != nullptr ) {
-				for ( i = 0; i < numClusters; ++i )
-				{
-					if ( ClusterVisible( light.cluster, clusters[ i ] ) ) {
-						break;
-					}
-				}
-
-				/* fixme! */
-				if ( i == numClusters ) {
+				if ( !ClusterVisibleAny( light.cluster, clusterSet ) ) {
 					lightsClusterCulled++;
 					continue;
 				}
@@ -2112,6 +2302,8 @@ void IlluminateRawLightmap( int rawLightmapNum ){
 	Vector3 averageColor, averageDir;
 	float tests[ 4 ][ 2 ] = { { 0, 0 }, { 1, 0 }, { 0, 1 }, { 1, 1 } };
 	trace_t trace;
+	trace_t packet[ TRACE_PACKET_SIZE ];
+	int packetX[ TRACE_PACKET_SIZE ], packetY[ TRACE_PACKET_SIZE ];
 	SuperLuxel stackLightLuxels[ 64 * 64 ];
 
 
@@ -2318,7 +2510,35 @@ void IlluminateRawLightmap( int rawLightmapNum ){
 				memset( lm->superFlags, 0, size );
 			}
 
-			/* initial pass, one sample per luxel */
+			/* initial pass, one sample per luxel, neighbouring luxels are traced together */
+			std::fill_n( packet, TRACE_PACKET_SIZE, trace );
+			int numPacket = 0;
+			const auto lightPacket = [&](){
+				LightContributionToSamples( packet, numPacket );
+				for ( int i = 0; i < numPacket; ++i )
+				{
+					const trace_t& sample = packet[ i ];
+					const int px = packetX[ i ], py = packetY[ i ];
+					tmplm.getSuperLuxel( 0, px, py ).value = sample.color;
+
+					/* add the contribution to the deluxemap */
+					if ( deluxemap ) {
+						tmplm.getSuperDeluxel( px, py ) = sample.directionContribution;
+					}
+
+					/* check for evilness */
+					if ( sample.forceSubsampling > 1 && ( lightSamples > 1 || lightRandomSamples ) ) {
+						totalLighted++;
+						lm->getSuperFlag( px, py ) |= FLAG_FORCE_SUBSAMPLING; /* force */
+					}
+					/* add to count */
+					else if ( sample.color != g_vector3_identity ) {
+						totalLighted++;
+					}
+				}
+				numPacket = 0;
+			};
+
 			for ( y = 0; y < lm->sh; ++y )
 			{
 				for ( x = 0; x < lm->sw; ++x )
@@ -2329,48 +2549,24 @@ void IlluminateRawLightmap( int rawLightmapNum ){
 						continue;
 					}
 
-					/* get particulars */
-					SuperLuxel& lightLuxel = tmplm.getSuperLuxel( 0, x, y );
-
-#if 0
-					////////// 27's temp hack for testing edge clipping ////
-					if ( lm->getSuperOrigin( x, y ) == g_vector3_identity ) {
-						lightLuxel.value[ 1 ] = 255;
-						lightLuxel.count = 1;
-						totalLighted++;
-					}
-					else
-#endif
-					{
-						/* set contribution count */
-						lightLuxel.count = 1;
-
-						/* setup trace */
-						trace.cluster = cluster;
-						trace.origin = lm->getSuperOrigin( x, y );
-						trace.normal = lm->getSuperNormal( x, y );
-
-						/* get light for this sample */
-						LightContributionToSample( &trace );
-						lightLuxel.value = trace.color;
-
-						/* add the contribution to the deluxemap */
-						if ( deluxemap ) {
-							tmplm.getSuperDeluxel( x, y ) = trace.directionContribution;
-						}
+					/* set contribution count */
+					tmplm.getSuperLuxel( 0, x, y ).count = 1;
 
-						/* check for evilness */
-						if ( trace.forceSubsampling > 1 && ( lightSamples > 1 || lightRandomSamples ) ) {
-							totalLighted++;
-							lm->getSuperFlag( x, y ) |= FLAG_FORCE_SUBSAMPLING; /* force */
-						}
-						/* add to count */
-						else if ( trace.color != g_vector3_identity ) {
-							totalLighted++;
-						}
+					/* setup trace */
+					trace_t& sample = packet[ numPacket ];
+					sample.cluster = cluster;
+					sample.origin = lm->getSuperOrigin( x, y );
+					sample.normal = lm->getSuperNormal( x, y );
+					packetX[ numPacket ] = x;
+					packetY[ numPacket ] = y;
+
+					/* get light for the samples */
+					if ( ++numPacket == TRACE_PACKET_SIZE ) {
+						lightPacket();
 					}
 				}
 			}
+			lightPacket();
 
 			/* don't even bother with everything else if nothing was lit */
 			if ( totalLighted == 0 ) {
@@ -3270,6 +3466,52 @@ inline bool ChopBounds( MinMax& minmax, const Vector3& origin, const Vector3& no
 
 
 
+/*
+   ClusterPVSBounds()
+   returns the bounds of all leaves in the pvs of a cluster
+   the per cluster leaf bounds are gathered once, and each pvs once,
+   as many lights (e.g. radiosity diffuse lights) share clusters
+ */
+
+static const MinMax& ClusterPVSBounds( int cluster ){
+	static std::vector<MinMax> clusterBounds, pvsBounds;
+	static std::vector<std::uint8_t> pvsBoundsValid;
+
+	/* gather leaf bounds per cluster */
+	if ( clusterBounds.empty() ) {
+		for ( const bspLeaf_t& leaf : bspLeafs )
+		{
+			if ( leaf.cluster <= CLUSTER_OPAQUE ) {
+				continue;
+			}
+			if ( leaf.cluster >= int( clusterBounds.size() ) ) {
+				clusterBounds.resize( leaf.cluster + 1 );
+			}
+			clusterBounds[ leaf.cluster ].extend( leaf.minmax );
+		}
+		pvsBounds.resize( clusterBounds.size() );
+		pvsBoundsValid.resize( clusterBounds.size(), false );
+	}
+
+	static const MinMax empty;
+	if ( cluster < 0 || cluster >= int( pvsBounds.size() ) ) {
+		return empty;
+	}
+
+	if ( !pvsBoundsValid[ cluster ] ) {
+		for ( size_t i = 0; i < clusterBounds.size(); ++i )
+		{
+			if ( ClusterVisible( cluster, int( i ) ) ) { /* ydnar: thanks Arnout for exposing my stupid error (this never failed before) */
+				pvsBounds[ cluster ].extend( clusterBounds[ i ] );
+			}
+		}
+		pvsBoundsValid[ cluster ] = true;
+	}
+	return pvsBounds[ cluster ];
+}
+
+
+
 /*
    SetupEnvelopes()
    calculates each light's effective envelope,
@@ -3285,6 +3527,7 @@ void SetupEnvelopes( bool forGrid, bool fastFlag ){
 
 	/* early out for weird cases where there are no lights */
 	if ( lights.empty() ) {
+		SetupLightIndex();
 		return;
 	}
 
@@ -3444,23 +3687,8 @@ void SetupEnvelopes( bool forGrid, bool fastFlag ){
 
 				/* chop radius against pvs */
 				{
-					/* clear bounds */
-					MinMax minmax;
-
-					/* check all leaves */
-					for ( const bspLeaf_t& leaf : bspLeafs )
-					{
-						/* in pvs? */
-						if ( leaf.cluster <= CLUSTER_OPAQUE ) {
-							continue;
-						}
-						if ( !ClusterVisible( light->cluster, leaf.cluster ) ) { /* ydnar: thanks Arnout for exposing my stupid error (this never failed before) */
-							continue;
-						}
-
-						/* add this leafs bbox to the bounds */
-						minmax.extend( leaf.minmax );
-					}
+					/* get bounds of all leaves in pvs */
+					MinMax minmax = ClusterPVSBounds( light->cluster );
 
 					/* test to see if bounds encompass light */
 					if ( !minmax.test( light->origin ) ) {
@@ -3537,6 +3765,9 @@ void SetupEnvelopes( bool forGrid, bool fastFlag ){
 	/* emit some statistics */
 	Sys_Printf( "%9zu total lights\n", lights.size() );
 	Sys_Printf( "%9d culled lights\n", numCulledLights );
+
+	/* index the envelopes for CreateTraceLightsForBounds() */
+	SetupLightIndex();
 }
 
 
@@ -3620,6 +3851,9 @@ float FloodLightForSample( trace_t *trace, float floodLightDistance, bool floodL
 	float gatherLight, outLight;
 	Vector3 myUp, myRt;
 	int vecs = 0;
+	trace_t packet[ TRACE_PACKET_SIZE ];
+	trace_t *packetTraces[ TRACE_PACKET_SIZE ];
+	int numPacket = 0;
 
 	gatherLight = 0;
 	/* dummy check */
@@ -3661,7 +3895,8 @@ float FloodLightForSample( trace_t *trace, float floodLightDistance, bool floodL
 	}
 	else
 	{
-		/* iterate through ordered vectors */
+		/* iterate through ordered vectors, traced in packets */
+		std::fill_n( packet, TRACE_PACKET_SIZE, *trace );
 		for ( i = 0; i < numFloodVectors; ++i )
 		{
 			vecs++;
@@ -3670,30 +3905,39 @@ float FloodLightForSample( trace_t *trace, float floodLightDistance, bool floodL
 			const Vector3 direction = myRt * floodVectors[ i ][ 0 ] + myUp * floodVectors[ i ][ 1 ] + normal * floodVectors[ i ][ 2 ];
 
 			/* set endpoint */
-			trace->end = trace->origin + direction * dd;
+			trace_t& sample = packet[ numPacket ];
+			sample.end = sample.origin + direction * dd;
 
-			// trace->origin += direction;
+			// sample.origin += direction;
+
+			SetupTrace( &sample );
+			sample.color.set( 1 );
+			packetTraces[ numPacket++ ] = &sample;
 
-			SetupTrace( trace );
-			trace->color.set( 1 );
 			/* trace */
-			TraceLine( trace );
-			contribution = 1;
+			if ( numPacket == TRACE_PACKET_SIZE || i == numFloodVectors - 1 ) {
+				TraceLines( packetTraces, numPacket );
+				for ( const trace_t& traced : Span( packet, numPacket ) )
+				{
+					contribution = 1;
 
-			if ( trace->compileFlags & C_SKY || trace->compileFlags & C_TRANSLUCENT ) {
-				contribution = 1;
-			}
-			else if ( trace->opaque ) {
-				const float d = vector3_length( trace->hit - trace->origin );
+					if ( traced.compileFlags & C_SKY || traced.compileFlags & C_TRANSLUCENT ) {
+						contribution = 1;
+					}
+					else if ( traced.opaque ) {
+						const float d = vector3_length( traced.hit - traced.origin );
 
-				// d = trace->distance;
-				//if ( d > 256 ) gatherDirt += 1;
-				contribution = std::min( 1.f, d / dd );
+						// d = traced.distance;
+						//if ( d > 256 ) gatherDirt += 1;
+						contribution = std::min( 1.f, d / dd );
 
-				//gatherDirt += 1.0f - ooDepth * VectorLength( displacement );
-			}
+						//gatherDirt += 1.0f - ooDepth * VectorLength( displacement );
+					}
 
-			gatherLight += contribution;
+					gatherLight += contribution;
+				}
+				numPacket = 0;
+			}
 		}
 	}
 
@@ -3866,7 +4110,7 @@ static void FloodLightRawLightmap( int rawLightmapNum ){
 void FloodlightRawLightmaps(){
 	Sys_Printf( "--- FloodlightRawLightmap ---\n" );
 	numSurfacesFloodlighten = 0;
-	RunThreadsOnIndividual( numRawLightmaps, true, FloodLightRawLightmap );
+	RunThreadsOnIndividualStealing( numRawLightmaps, true, FloodLightRawLightmap, RawLightmapsByCost().data() );
 	Sys_Printf( "%9d custom lightmaps floodlighted\n", numSurfacesFloodlighten );
 }
 
@@ -1774,6 +1774,83 @@ static void SetupOutLightmap( rawLightmap_t *lm, outLightmap_t *olm ){
 
 
 
+/*
+   rectangle lightmap allocator - enabled by -rectallocate
+   keeps the maximal free rectangles of each output lightmap, stamps are placed as bounding rectangles
+   into the one fitting best (shorter leftover side), so need no luxel test
+ */
+
+struct FreeRect
+{
+	int x, y, w, h;
+};
+
+static std::vector<std::vector<FreeRect>> outLightmapFreeRects; /* per outLightmaps entry */
+
+static bool FindFreeRect( const std::vector<FreeRect>& rects, int w, int h, int& x, int& y ){
+	int bestShort = std::numeric_limits<int>::max();
+	int bestLong = std::numeric_limits<int>::max();
+
+	for ( const FreeRect& rect : rects )
+	{
+		if ( w <= rect.w && h <= rect.h ) {
+			const int shortSide = std::min( rect.w - w, rect.h - h );
+			const int longSide = std::max( rect.w - w, rect.h - h );
+			if ( shortSide < bestShort || ( shortSide == bestShort && longSide < bestLong ) ) {
+				bestShort = shortSide;
+				bestLong = longSide;
+				x = rect.x;
+				y = rect.y;
+			}
+		}
+	}
+
+	return bestShort != std::numeric_limits<int>::max();
+}
+
+static void SplitFreeRects( std::vector<FreeRect>& rects, int x, int y, int w, int h ){
+	/* split rectangles overlapped by stamp to maximal ones around it */
+	const size_t count = rects.size();
+	for ( size_t i = 0; i < count; ++i )
+	{
+		const FreeRect rect = rects[ i ];
+		if ( x >= rect.x + rect.w || x + w <= rect.x || y >= rect.y + rect.h || y + h <= rect.y ) {
+			continue;
+		}
+		if ( x > rect.x ) {
+			rects.push_back( FreeRect{ rect.x, rect.y, x - rect.x, rect.h } );
+		}
+		if ( x + w < rect.x + rect.w ) {
+			rects.push_back( FreeRect{ x + w, rect.y, rect.x + rect.w - x - w, rect.h } );
+		}
+		if ( y > rect.y ) {
+			rects.push_back( FreeRect{ rect.x, rect.y, rect.w, y - rect.y } );
+		}
+		if ( y + h < rect.y + rect.h ) {
+			rects.push_back( FreeRect{ rect.x, y + h, rect.w, rect.y + rect.h - y - h } );
+		}
+		rects[ i ].w = 0;
+	}
+	std::erase_if( rects, []( const FreeRect& rect ){ return rect.w == 0; } );
+
+	/* prune rectangles contained in others */
+	for ( FreeRect& rect : rects )
+	{
+		for ( const FreeRect& other : rects )
+		{
+			if ( &rect != &other && other.w != 0
+			  && rect.x >= other.x && rect.y >= other.y
+			  && rect.x + rect.w <= other.x + other.w && rect.y + rect.h <= other.y + other.h ) {
+				rect.w = 0;
+				break;
+			}
+		}
+	}
+	std::erase_if( rects, []( const FreeRect& rect ){ return rect.w == 0; } );
+}
+
+
+
 /*
    FindOutLightmaps()
    for a given surface lightmap, find output lightmap pages and positions for it
@@ -1908,6 +1985,17 @@ static void FindOutLightmaps( rawLightmap_t *lm, bool fastAllocate ){
 					continue;
 				}
 
+				/* rectangle allocation, solid lightmaps use a 1x1 stamp */
+				if ( rectAllocate ) {
+					ok = lm->solid[ lightmapNum ]
+					   ? FindFreeRect( outLightmapFreeRects[ i ], 1, 1, x, y )
+					   : FindFreeRect( outLightmapFreeRects[ i ], lm->w, lm->h, x, y );
+					if ( ok ) {
+						break;
+					}
+					continue;
+				}
+
 				/* set maxs */
 				if ( lm->solid[ lightmapNum ] ) {
 					xMax = olm->customWidth;
@@ -1972,6 +2060,9 @@ static void FindOutLightmaps( rawLightmap_t *lm, bool fastAllocate ){
 			/* initialize both out lightmaps */
 			for ( k = numOutLightmaps - LIGHTMAP_RESERVE_COUNT; k < numOutLightmaps; ++k )
 				SetupOutLightmap( lm, &outLightmaps[ k ] );
+			if ( rectAllocate ) {
+				outLightmapFreeRects.resize( numOutLightmaps, { FreeRect{ 0, 0, lm->customWidth, lm->customHeight } } );
+			}
 
 			/* set out lightmap */
 			i = numOutLightmaps - LIGHTMAP_RESERVE_COUNT;
@@ -1982,6 +2073,20 @@ static void FindOutLightmaps( rawLightmap_t *lm, bool fastAllocate ){
 				x = lm->lightmapX[ 0 ];
 				y = lm->lightmapY[ 0 ];
 			}
+			else{
+				x = 0;
+				y = 0;
+			}
+		}
+
+		/* take stamp rectangle from free ones, styled lightmaps may be put into not free ones */
+		if ( rectAllocate ) {
+			if ( lm->solid[ lightmapNum ] ) {
+				SplitFreeRects( outLightmapFreeRects[ i ], x, y, 1, 1 );
+			}
+			else{
+				SplitFreeRects( outLightmapFreeRects[ i ], x, y, lm->w, lm->h );
+			}
 		}
 
 		/* if this is a style-using lightmap, it must be exported */
@@ -2837,6 +2942,7 @@ void StoreSurfaceLightmaps( bool fastAllocate, bool storeForReal ){
 			free( outLightmaps );
 			outLightmaps = nullptr;
 		}
+		outLightmapFreeRects.clear();
 
 		numLightmapShaders = 0;
 		numOutLightmaps = 0;
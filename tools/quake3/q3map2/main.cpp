@@ -32,6 +32,7 @@
 #include "q3map2.h"
 #include "autopk3.h"
 #include "timer.h"
+#include <optional>
 
 
 
@@ -109,6 +110,16 @@ int main( int argc, char **argv ){
 			patchSubdivisions = std::max( atoi( args.takeNext() ), 1 );
 		}
 
+		/* model cache */
+		while ( args.takeArg( "-modelcache" ) ) {
+			modelCache = true;
+		}
+
+		/* profile */
+		while ( args.takeArg( "-profile" ) ) {
+			profiling = true;
+		}
+
 		/* threads */
 		while ( args.takeArg( "-threads" ) ) {
 			numthreads = atoi( args.takeNext() );
@@ -150,6 +161,14 @@ int main( int argc, char **argv ){
 		Error( "Usage: %s [general options] [options] mapfile\n%s -help for help", args.getArg0(), args.getArg0() );
 	}
 
+	/* -profile: the whole mode is the root stage, named after the mode switch */
+	const char *mode = "bsp";
+	for ( const char *m : { "-fixaas", "-analyze", "-info", "-vis", "-light", "-exportents", "-export", "-import", "-scale",
+	                        "-shift", "-pk3", "-repack", "-convert", "-json", "-mergebsp", "-minimap" } )
+		if ( striEqual( args.getVector().front(), m ) )
+			mode = m + 1;
+	std::optional<ProfileStage> profileStage( std::in_place, mode );
+
 	/* fixaas */
 	if ( args.takeFront( "-fixaas" ) ) {
 		r = FixAAS( args );
@@ -235,6 +254,10 @@ int main( int argc, char **argv ){
 		r = BSPMain( args );
 	}
 
+	/* write -profile report next to the input */
+	profileStage.reset();
+	ProfileWrite( StringStream( PathExtensionless( source ), '.', mode, ".profile.json" ) );
+
 	/* emit time */
 	Sys_Printf( "%9.0f seconds elapsed\n", timer.elapsed_sec() );
 
@@ -46,6 +46,11 @@ struct minimap_t
 	float *data1f;
 	float *sharpendata1f;
 	Vector3 mins, size;
+	/* uniform grid over the xy footprints of the opaque brushes */
+	int gridWidth, gridHeight;
+	float gridCellWidth, gridCellHeight;
+	std::vector<int> gridCellStart;     /* gridWidth * gridHeight + 1 offsets into gridBrushes */
+	std::vector<int> gridBrushes;       /* brush indices, ascending per cell */
 };
 
 static minimap_t minimap;
@@ -92,6 +97,14 @@ static bool BrushIntersectionWithLine( const bspBrush_t& brush, const Vector3& s
 	return in && out;
 }
 
+/* cell of a coordinate, samples outside of the grid use the border cells */
+inline int MiniMapGridCellX( float x ){
+	return std::clamp( int( std::floor( ( x - minimap.mins[0] ) / minimap.gridCellWidth ) ), 0, minimap.gridWidth - 1 );
+}
+inline int MiniMapGridCellY( float y ){
+	return std::clamp( int( std::floor( ( y - minimap.mins[1] ) / minimap.gridCellHeight ) ), 0, minimap.gridHeight - 1 );
+}
+
 static float MiniMapSample( float x, float y ){
 	float t0, t1;
 	float samp;
@@ -102,31 +115,29 @@ static float MiniMapSample( float x, float y ){
 
 	cnt = 0;
 	samp = 0;
-	for ( int i = 0; i < minimap.model->numBSPBrushes; ++i )
+	const int cell = MiniMapGridCellY( y ) * minimap.gridWidth + MiniMapGridCellX( x );
+	for ( const int bi : Span( minimap.gridBrushes.data() + minimap.gridCellStart[cell], minimap.gridBrushes.data() + minimap.gridCellStart[cell + 1] ) )
 	{
-		const int bi = minimap.model->firstBSPBrush + i;
-		if ( opaqueBrushes[bi] ) {
-			const bspBrush_t& b = bspBrushes[bi];
-
-			// sort out mins/maxs of the brush
-			const bspBrushSide_t *s = &bspBrushSides[b.firstSide];
-			if ( x < -bspPlanes[s[0].planeNum].dist() ) {
-				continue;
-			}
-			if ( x > +bspPlanes[s[1].planeNum].dist() ) {
-				continue;
-			}
-			if ( y < -bspPlanes[s[2].planeNum].dist() ) {
-				continue;
-			}
-			if ( y > +bspPlanes[s[3].planeNum].dist() ) {
-				continue;
-			}
+		const bspBrush_t& b = bspBrushes[bi];
 
-			if ( BrushIntersectionWithLine( b, org, dir, &t0, &t1 ) ) {
-				samp += t1 - t0;
-				++cnt;
-			}
+		// sort out mins/maxs of the brush
+		const bspBrushSide_t *s = &bspBrushSides[b.firstSide];
+		if ( x < -bspPlanes[s[0].planeNum].dist() ) {
+			continue;
+		}
+		if ( x > +bspPlanes[s[1].planeNum].dist() ) {
+			continue;
+		}
+		if ( y < -bspPlanes[s[2].planeNum].dist() ) {
+			continue;
+		}
+		if ( y > +bspPlanes[s[3].planeNum].dist() ) {
+			continue;
+		}
+
+		if ( BrushIntersectionWithLine( b, org, dir, &t0, &t1 ) ) {
+			samp += t1 - t0;
+			++cnt;
 		}
 	}
 
@@ -315,6 +326,54 @@ static void MiniMapSetupBrushes(){
 	// not all may be nodraw
 }
 
+/*
+   MiniMapSetupGrid()
+   sorts the opaque brushes into a 2d grid over the minimap area,
+   so each sample only tests the brushes overlapping its cell
+ */
+
+static void MiniMapSetupGrid(){
+	std::vector<int> brushes;
+	for ( int i = 0; i < minimap.model->numBSPBrushes; ++i )
+		if ( opaqueBrushes[minimap.model->firstBSPBrush + i] ) {
+			brushes.push_back( minimap.model->firstBSPBrush + i );
+		}
+
+	/* about one brush per cell, no finer than the image */
+	const int cells = std::max( 1, int( std::sqrt( float( brushes.size() ) ) ) );
+	minimap.gridWidth = std::min( cells, minimap.width );
+	minimap.gridHeight = std::min( cells, minimap.height );
+	minimap.gridCellWidth = minimap.size[0] > 0 ? minimap.size[0] / minimap.gridWidth : 1;
+	minimap.gridCellHeight = minimap.size[1] > 0 ? minimap.size[1] / minimap.gridHeight : 1;
+
+	/* brush xy extents in cells, from the axial sides as in MiniMapSample() */
+	const auto forEachCell = []( int bi, auto&& functor ){
+		const bspBrushSide_t *s = &bspBrushSides[bspBrushes[bi].firstSide];
+		const int x0 = MiniMapGridCellX( -bspPlanes[s[0].planeNum].dist() );
+		const int x1 = MiniMapGridCellX( +bspPlanes[s[1].planeNum].dist() );
+		const int y0 = MiniMapGridCellY( -bspPlanes[s[2].planeNum].dist() );
+		const int y1 = MiniMapGridCellY( +bspPlanes[s[3].planeNum].dist() );
+		for ( int y = y0; y <= y1; ++y )
+			for ( int x = x0; x <= x1; ++x )
+				functor( y * minimap.gridWidth + x );
+	};
+
+	/* count, then fill in brush order */
+	minimap.gridCellStart.assign( minimap.gridWidth * minimap.gridHeight + 1, 0 );
+	for ( const int bi : brushes )
+		forEachCell( bi, []( int cell ){ ++minimap.gridCellStart[cell + 1]; } );
+	for ( size_t i = 1; i < minimap.gridCellStart.size(); ++i )
+		minimap.gridCellStart[i] += minimap.gridCellStart[i - 1];
+
+	minimap.gridBrushes.resize( minimap.gridCellStart.back() );
+	std::vector<int> fill( minimap.gridCellStart.begin(), minimap.gridCellStart.end() - 1 );
+	for ( const int bi : brushes )
+		forEachCell( bi, [bi, &fill]( int cell ){ minimap.gridBrushes[fill[cell]++] = bi; } );
+
+	Sys_FPrintf( SYS_VRB, "%9zu opaque brushes in %d x %d grid cells, %zu references\n",
+	             brushes.size(), minimap.gridWidth, minimap.gridHeight, minimap.gridBrushes.size() );
+}
+
 static bool MiniMapEvaluateSampleOffsets( int *bestj, int *bestk, float *bestval ){
 	float val, dx, dy;
 	int j, k;
@@ -590,27 +649,28 @@ int MiniMapBSPMain( Args& args ){
 	}
 
 	MiniMapSetupBrushes();
+	MiniMapSetupGrid();
 
 	if ( minimap.samples <= 1 ) {
 		Sys_Printf( "\n--- MiniMapNoSupersampling (%d) ---\n", minimap.height );
-		RunThreadsOnIndividual( minimap.height, true, MiniMapNoSupersampling );
+		RunThreadsOnIndividualStealing( minimap.height, true, MiniMapNoSupersampling );
 	}
 	else
 	{
 		if ( minimap.sample_offsets ) {
 			Sys_Printf( "\n--- MiniMapSupersampled (%d) ---\n", minimap.height );
-			RunThreadsOnIndividual( minimap.height, true, MiniMapSupersampled );
+			RunThreadsOnIndividualStealing( minimap.height, true, MiniMapSupersampled );
 		}
 		else
 		{
 			Sys_Printf( "\n--- MiniMapRandomlySupersampled (%d) ---\n", minimap.height );
-			RunThreadsOnIndividual( minimap.height, true, MiniMapRandomlySupersampled );
+			RunThreadsOnIndividualStealing( minimap.height, true, MiniMapRandomlySupersampled );
 		}
 	}
 
 	if ( minimap.boost != 1 ) {
 		Sys_Printf( "\n--- MiniMapContrastBoost (%d) ---\n", minimap.height );
-		RunThreadsOnIndividual( minimap.height, true, MiniMapContrastBoost );
+		RunThreadsOnIndividualStealing( minimap.height, true, MiniMapContrastBoost );
 	}
 
 	if ( autolevel ) {
@@ -650,12 +710,12 @@ int MiniMapBSPMain( Args& args ){
 
 	if ( minimap.brightness != 0 || minimap.contrast != 1 ) {
 		Sys_Printf( "\n--- MiniMapBrightnessContrast (%d) ---\n", minimap.height );
-		RunThreadsOnIndividual( minimap.height, true, MiniMapBrightnessContrast );
+		RunThreadsOnIndividualStealing( minimap.height, true, MiniMapBrightnessContrast );
 	}
 
 	if ( minimap.sharpendata1f ) {
 		Sys_Printf( "\n--- MiniMapSharpen (%d) ---\n", minimap.height );
-		RunThreadsOnIndividual( minimap.height, true, MiniMapSharpen );
+		RunThreadsOnIndividualStealing( minimap.height, true, MiniMapSharpen );
 		q = minimap.sharpendata1f;
 	}
 	else
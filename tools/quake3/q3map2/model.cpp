@@ -45,6 +45,11 @@
 #include <assimp/mesh.h>
 
 #include <map>
+#include <set>
+#include <mutex>
+#include <optional>
+#include <array>
+#include "miniz.h"
 
 
 class AssLogger : public Assimp::Logger
@@ -81,6 +86,24 @@ public:
 };
 
 
+/* files read by the running import of this thread, with their checksums for -modelcache;
+   files it probed and did not find are kept too, as adding them may change the import */
+struct ModelCacheFile
+{
+	CopiedString m_name;
+	std::array<byte, 16> m_checksum;
+	bool m_missing;
+};
+static thread_local std::vector<ModelCacheFile> t_importedFiles;
+
+static void ModelCacheMissingFile( const char *name ){
+	if ( modelCache && std::ranges::none_of( t_importedFiles, [name]( const ModelCacheFile& file ){
+		return file.m_missing && striEqual( file.m_name.c_str(), name );
+	} ) ) {
+		t_importedFiles.push_back( ModelCacheFile{ name, {}, true } );
+	}
+}
+
 class AssIOSystem : public Assimp::IOSystem
 {
 public:
@@ -91,7 +114,11 @@ public:
 	 * @return true if there is a file with this path, else false.
 	 */
 	bool Exists( const char* pFile ) const override {
-		return vfsGetFileCount( pFile ) != 0;
+		if ( vfsGetFileCount( pFile ) != 0 ) {
+			return true;
+		}
+		ModelCacheMissingFile( pFile );
+		return false;
 	}
 
 	// -------------------------------------------------------------------
@@ -119,8 +146,13 @@ public:
 	 */
 	Assimp::IOStream* Open( const char* pFile, const char* pMode = "rb" ) override {
 		if ( MemBuffer boo = vfsLoadFile( pFile ) ) {
+			if ( modelCache ) {
+				ModelCacheFile& file = t_importedFiles.emplace_back( ModelCacheFile{ pFile, {}, false } );
+				Com_BlockFullChecksum( boo.data(), boo.size(), file.m_checksum.data() );
+			}
 			return new Assimp::MemoryIOStream( boo.release(), boo.size(), true );
 		}
+		ModelCacheMissingFile( pFile );
 		return nullptr;
 	}
 
@@ -162,22 +194,48 @@ public:
 private:
 };
 
-static Assimp::Importer *s_assImporter = nullptr;
+static const unsigned c_assImportFlags = //aiProcessPreset_TargetRealtime_Fast
+                                       //    | aiProcess_FixInfacingNormals
+                                         aiProcess_GenNormals
+                                       | aiProcess_JoinIdenticalVertices
+                                       | aiProcess_Triangulate
+                                       | aiProcess_GenUVCoords
+                                       | aiProcess_SortByPType
+                                       | aiProcess_FindDegenerates
+                                       | aiProcess_FindInvalidData
+                                       | aiProcess_ValidateDataStructure
+                                       | aiProcess_FlipUVs
+                                       | aiProcess_FlipWindingOrder
+                                       | aiProcess_PreTransformVertices
+                                       | aiProcess_RemoveComponent
+                                       | aiProcess_SplitLargeMeshes;
+
+/* importers aren't thread safe, each thread gets its own */
+static Assimp::Importer& AssImporter(){
+	static thread_local std::unique_ptr<Assimp::Importer> importer;
+	if ( importer == nullptr ) {
+		importer = std::make_unique<Assimp::Importer>();
+
+		importer->SetPropertyBool( AI_CONFIG_PP_PTV_ADD_ROOT_TRANSFORMATION, true );
+		// rotate the whole scene 90 degrees around the x axis to convert assimp's Y = UP to Quakes's Z = UP
+		importer->SetPropertyMatrix( AI_CONFIG_PP_PTV_ROOT_TRANSFORMATION, aiMatrix4x4( 1, 0, 0, 0,
+		                                                                                0, 0, -1, 0,
+		                                                                                0, 1, 0, 0,
+		                                                                                0, 0, 0, 1 ) ); // aiMatrix4x4::RotationX( c_half_pi )
+		importer->SetPropertyInteger( AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_POINT | aiPrimitiveType_LINE );
+		importer->SetPropertyString( AI_CONFIG_IMPORT_MDL_COLORMAP, "gfx/palette.lmp" ); // Q1 palette, default is fine too
+		importer->SetPropertyBool( AI_CONFIG_IMPORT_MD3_LOAD_SHADERS, false );
+		importer->SetPropertyString( AI_CONFIG_IMPORT_MD3_SHADER_SRC, "scripts/" );
+		importer->SetPropertyBool( AI_CONFIG_IMPORT_MD3_HANDLE_MULTIPART, false );
+		importer->SetPropertyInteger( AI_CONFIG_PP_RVC_FLAGS, aiComponent_TANGENTS_AND_BITANGENTS ); // varying tangents prevent aiProcess_JoinIdenticalVertices
+
+		importer->SetIOHandler( new AssIOSystem );
+	}
+	return *importer;
+}
 
 void assimp_init(){
-	s_assImporter = new Assimp::Importer();
-
-	s_assImporter->SetPropertyBool( AI_CONFIG_PP_PTV_ADD_ROOT_TRANSFORMATION, true );
-	s_assImporter->SetPropertyInteger( AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_POINT | aiPrimitiveType_LINE );
-	s_assImporter->SetPropertyString( AI_CONFIG_IMPORT_MDL_COLORMAP, "gfx/palette.lmp" ); // Q1 palette, default is fine too
-	s_assImporter->SetPropertyBool( AI_CONFIG_IMPORT_MD3_LOAD_SHADERS, false );
-	s_assImporter->SetPropertyString( AI_CONFIG_IMPORT_MD3_SHADER_SRC, "scripts/" );
-	s_assImporter->SetPropertyBool( AI_CONFIG_IMPORT_MD3_HANDLE_MULTIPART, false );
-	s_assImporter->SetPropertyInteger( AI_CONFIG_PP_RVC_FLAGS, aiComponent_TANGENTS_AND_BITANGENTS ); // varying tangents prevent aiProcess_JoinIdenticalVertices
-
 	Assimp::DefaultLogger::set( new AssLogger );
-
-	s_assImporter->SetIOHandler( new AssIOSystem );
 }
 
 struct ModelNameFrame
@@ -193,10 +251,15 @@ struct AssModel
 {
 	struct AssModelMesh final : public AssMeshWalker
 	{
-		const aiMesh *m_mesh;
 		CopiedString m_shader;
-
-		AssModelMesh( const aiScene *scene, const aiMesh *mesh, const char *rootPath ) : m_mesh( mesh ){
+		std::vector<Vector3> m_xyz;
+		std::vector<Vector3> m_normals; // empty if the mesh has none
+		std::vector<Vector2> m_st;      // empty if the mesh has none
+		std::vector<Vector4> m_colors;  // empty if the mesh has none
+		std::vector<int> m_indexes;     // triangles
+
+		AssModelMesh() = default;
+		AssModelMesh( const aiScene *scene, const aiMesh *mesh, const char *rootPath ){
 			aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
 
 			aiString matname = material->GetName();
@@ -239,18 +302,42 @@ struct AssModel
 
 			if( oldShader != m_shader )
 				Sys_FPrintf( SYS_VRB, "substituting: %s -> %s\n", oldShader.c_str(), m_shader.c_str() );
+
+			/* copy the triangle soup, so the scene may be freed and the model cached */
+			m_xyz.reserve( mesh->mNumVertices );
+			for ( const aiVector3D& v : Span( mesh->mVertices, mesh->mNumVertices ) )
+				m_xyz.emplace_back( v.x, v.y, v.z );
+			if( mesh->HasNormals() ){
+				m_normals.reserve( mesh->mNumVertices );
+				for ( const aiVector3D& n : Span( mesh->mNormals, mesh->mNumVertices ) )
+					m_normals.emplace_back( n.x, n.y, n.z );
+			}
+			if( mesh->HasTextureCoords( 0 ) ){
+				m_st.reserve( mesh->mNumVertices );
+				for ( const aiVector3D& st : Span( mesh->mTextureCoords[0], mesh->mNumVertices ) )
+					m_st.emplace_back( st.x, st.y );
+			}
+			if( mesh->HasVertexColors( 0 ) ){
+				m_colors.reserve( mesh->mNumVertices );
+				for ( const aiColor4D& c : Span( mesh->mColors[0], mesh->mNumVertices ) )
+					m_colors.emplace_back( c.r, c.g, c.b, c.a );
+			}
+			m_indexes.reserve( mesh->mNumFaces * 3 );
+			for ( const aiFace& face : Span( mesh->mFaces, mesh->mNumFaces ) ){
+				// if( face.mNumIndices == 3 )
+				m_indexes.insert( m_indexes.end(), face.mIndices, face.mIndices + 3 );
+			}
 		}
 
 		void forEachFace( std::function<void( const Vector3 ( &xyz )[3], const Vector2 ( &st )[3])> visitor ) const override {
-			for ( const aiFace& face : Span( m_mesh->mFaces, m_mesh->mNumFaces ) ){
-				// if( face.mNumIndices == 3 )
+			for ( size_t f = 0; f < m_indexes.size(); f += 3 ){
 				Vector3 xyz[3];
 				Vector2 st[3];
 				for( size_t n = 0; n < 3; ++n ){
-					const auto i = face.mIndices[n];
-					xyz[n] = { m_mesh->mVertices[i].x, m_mesh->mVertices[i].y, m_mesh->mVertices[i].z };
-					if( m_mesh->HasTextureCoords( 0 ) )
-						st[n] = { m_mesh->mTextureCoords[0][i].x, m_mesh->mTextureCoords[0][i].y };
+					const int i = m_indexes[f + n];
+					xyz[n] = m_xyz[i];
+					if( !m_st.empty() )
+						st[n] = m_st[i];
 					else
 						st[n] = Vector2( 0 );
 				}
@@ -262,10 +349,10 @@ struct AssModel
 		}
 	};
 
-	aiScene *m_scene;
 	std::vector<AssModelMesh> m_meshes;
 
-	AssModel( aiScene *scene, const char *modelname ) : m_scene( scene ){
+	AssModel() = default;
+	AssModel( const aiScene *scene, const char *modelname ){
 		m_meshes.reserve( scene->mNumMeshes );
 		const auto rootPath = StringStream<64>( PathCleaned( PathFilenameless( modelname ) ) );
 		const auto traverse = [&]( const auto& self, const aiNode* node ) -> void {
@@ -286,7 +373,297 @@ struct AssModel
 	}
 };
 
-static std::map<ModelNameFrame, AssModel> s_assModels;
+/* nullptr for models failing to load, to only warn once */
+static std::map<ModelNameFrame, std::unique_ptr<AssModel>> s_assModels;
+static std::mutex s_assModelsLock;
+
+
+
+/*
+   ImportModel()
+   reads a model with assimp, returns nullptr if that fails
+ */
+
+static std::unique_ptr<AssModel> ImportModel( const char *name, int frame ){
+	Assimp::Importer& importer = AssImporter();
+	importer.SetPropertyInteger( AI_CONFIG_PP_SLM_VERTEX_LIMIT, maxSurfaceVerts ); // TODO this optimal and with respect to lightmapped/not
+	importer.SetPropertyInteger( AI_CONFIG_IMPORT_GLOBAL_KEYFRAME, frame );
+
+	t_importedFiles.clear();
+	const aiScene *scene = importer.ReadFile( name, c_assImportFlags );
+	if( scene == nullptr ){
+		return nullptr;
+	}
+
+	if( scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE )
+		Sys_Warning( "AI_SCENE_FLAGS_INCOMPLETE\n" );
+	auto model = std::make_unique<AssModel>( scene, name );
+	importer.FreeScene();
+	return model;
+}
+
+
+
+/*
+   -modelcache
+   keeps imported models in <mapname>.modelcache, an entry is reused
+   while the files it was read from and the import settings are unchanged
+   and the files the import probed for and did not find are still missing
+ */
+
+#define MODELCACHE_IDENT    ( ( 'C' << 24 ) + ( 'L' << 16 ) + ( 'D' << 8 ) + 'M' )
+#define MODELCACHE_VERSION  2
+
+struct modelCacheHeader_t
+{
+	int ident;
+	int version;
+	int numEntries;
+	int compressedSize;
+	int uncompressedSize;
+};
+
+struct ModelCacheEntry
+{
+	uint32_t flags;
+	std::vector<ModelCacheFile> files;
+	std::vector<byte> model; // serialized AssModel
+};
+
+/* by model and AI_CONFIG_PP_SLM_VERTEX_LIMIT, that differs for -bsp and -light */
+static std::map<std::pair<ModelNameFrame, int>, ModelCacheEntry> s_modelCache;
+static std::mutex s_modelCacheLock;
+static bool s_modelCacheLoaded;
+static bool s_modelCacheDirty;
+
+static auto ModelCacheFilename(){
+	return StringStream( PathExtensionless( source ), ".modelcache" );
+}
+
+template<typename T>
+static void ModelCachePut( std::vector<byte>& data, const T& value ){
+	const byte *bytes = reinterpret_cast<const byte*>( &value );
+	data.insert( data.end(), bytes, bytes + sizeof( T ) );
+}
+template<typename T>
+static void ModelCachePut( std::vector<byte>& data, const std::vector<T>& values ){
+	ModelCachePut( data, uint32_t( values.size() ) );
+	const byte *bytes = reinterpret_cast<const byte*>( values.data() );
+	data.insert( data.end(), bytes, bytes + values.size() * sizeof( T ) );
+}
+static void ModelCachePut( std::vector<byte>& data, const CopiedString& string ){
+	ModelCachePut( data, uint32_t( strlen( string.c_str() ) ) );
+	data.insert( data.end(), string.c_str(), string.c_str() + strlen( string.c_str() ) );
+}
+
+class ModelCacheReader
+{
+	const byte *m_data;
+	const byte *m_end;
+public:
+	ModelCacheReader( const std::vector<byte>& data ) : m_data( data.data() ), m_end( data.data() + data.size() ){
+	}
+	bool atEnd() const {
+		return m_data == m_end;
+	}
+	template<typename T>
+	bool get( T& value ){
+		if( size_t( m_end - m_data ) < sizeof( T ) )
+			return false;
+		memcpy( &value, m_data, sizeof( T ) );
+		m_data += sizeof( T );
+		return true;
+	}
+	template<typename T>
+	bool get( std::vector<T>& values ){
+		uint32_t count;
+		if( !get( count ) || size_t( m_end - m_data ) / sizeof( T ) < count )
+			return false;
+		values.resize( count );
+		memcpy( values.data(), m_data, count * sizeof( T ) );
+		m_data += count * sizeof( T );
+		return true;
+	}
+	bool get( CopiedString& string ){
+		uint32_t length;
+		if( !get( length ) || size_t( m_end - m_data ) < length )
+			return false;
+		string = StringRange( reinterpret_cast<const char*>( m_data ), length );
+		m_data += length;
+		return true;
+	}
+	bool get( std::vector<ModelCacheFile>& files ){
+		uint32_t count;
+		if( !get( count ) )
+			return false;
+		for( ; count != 0; --count ){
+			ModelCacheFile& file = files.emplace_back();
+			if( !get( file.m_name ) || !get( file.m_checksum ) || !get( file.m_missing ) )
+				return false;
+		}
+		return true;
+	}
+	bool get( AssModel& model ){
+		uint32_t count;
+		if( !get( count ) )
+			return false;
+		for( ; count != 0; --count ){
+			auto& mesh = model.m_meshes.emplace_back();
+			if( !get( mesh.m_shader ) || !get( mesh.m_xyz ) || !get( mesh.m_normals ) || !get( mesh.m_st ) || !get( mesh.m_colors ) || !get( mesh.m_indexes ) )
+				return false;
+		}
+		return true;
+	}
+};
+
+static std::vector<byte> ModelCacheSerialize( const AssModel& model ){
+	std::vector<byte> data;
+	ModelCachePut( data, uint32_t( model.m_meshes.size() ) );
+	for( const auto& mesh : model.m_meshes ){
+		ModelCachePut( data, mesh.m_shader );
+		ModelCachePut( data, mesh.m_xyz );
+		ModelCachePut( data, mesh.m_normals );
+		ModelCachePut( data, mesh.m_st );
+		ModelCachePut( data, mesh.m_colors );
+		ModelCachePut( data, mesh.m_indexes );
+	}
+	return data;
+}
+
+/* called with s_modelCacheLock held */
+static void LoadModelCache(){
+	if( s_modelCacheLoaded )
+		return;
+	s_modelCacheLoaded = true;
+
+	const auto filename = ModelCacheFilename();
+	if ( !FileExists( filename ) ) {
+		Sys_Printf( "No model cache %s\n", filename.c_str() );
+		return;
+	}
+
+	Sys_Printf( "Loading %s\n", filename.c_str() );
+	MemBuffer file = LoadFile( filename );
+	modelCacheHeader_t header;
+	if ( file.size() < sizeof( header ) ) {
+		Sys_Warning( "Model cache is truncated, ignoring it\n" );
+		return;
+	}
+	memcpy( &header, file.data(), sizeof( header ) );
+	std::vector<byte> data;
+	mz_ulong size = 0;
+	if ( header.ident != MODELCACHE_IDENT || header.version != MODELCACHE_VERSION
+	  || file.size() != sizeof( header ) + header.compressedSize || header.uncompressedSize < 0
+	  || ( data.resize( header.uncompressedSize ), size = data.size(),
+	       mz_uncompress( data.data(), &size, (const byte *)file.data() + sizeof( header ), header.compressedSize ) != MZ_OK )
+	  || size != data.size() ) {
+		Sys_Warning( "Model cache is invalid, ignoring it\n" );
+		return;
+	}
+
+	ModelCacheReader reader( data );
+	for ( int i = 0; i < header.numEntries; ++i )
+	{
+		std::pair<ModelNameFrame, int> key;
+		ModelCacheEntry entry;
+		if ( !reader.get( key.first.m_name ) || !reader.get( key.first.m_frame ) || !reader.get( key.second ) || !reader.get( entry.flags )
+		  || !reader.get( entry.files ) || !reader.get( entry.model ) ) {
+			Sys_Warning( "Model cache is invalid, ignoring it\n" );
+			s_modelCache.clear();
+			return;
+		}
+		s_modelCache.insert_or_assign( std::move( key ), std::move( entry ) );
+	}
+}
+
+/*
+   SaveModelCache()
+   writes -modelcache back, if models were imported
+ */
+
+void SaveModelCache(){
+	if ( !s_modelCacheDirty ) {
+		return;
+	}
+	s_modelCacheDirty = false;
+
+	std::vector<byte> data;
+	for ( const auto& [key, entry] : s_modelCache )
+	{
+		ModelCachePut( data, key.first.m_name );
+		ModelCachePut( data, key.first.m_frame );
+		ModelCachePut( data, key.second );
+		ModelCachePut( data, entry.flags );
+		ModelCachePut( data, uint32_t( entry.files.size() ) );
+		for ( const ModelCacheFile& file : entry.files )
+		{
+			ModelCachePut( data, file.m_name );
+			ModelCachePut( data, file.m_checksum );
+			ModelCachePut( data, file.m_missing );
+		}
+		ModelCachePut( data, entry.model );
+	}
+
+	mz_ulong size = mz_compressBound( data.size() );
+	std::vector<byte> buffer( sizeof( modelCacheHeader_t ) + size );
+	if ( mz_compress2( buffer.data() + sizeof( modelCacheHeader_t ), &size, data.data(), data.size(), MZ_BEST_SPEED ) != MZ_OK ) {
+		Sys_Warning( "Failed to compress model cache\n" );
+		return;
+	}
+	const modelCacheHeader_t header{ MODELCACHE_IDENT, MODELCACHE_VERSION, int( s_modelCache.size() ), int( size ), int( data.size() ) };
+	memcpy( buffer.data(), &header, sizeof( header ) );
+
+	const auto filename = ModelCacheFilename();
+	Sys_Printf( "Writing %s\n", filename.c_str() );
+	SaveFile( filename, buffer.data(), sizeof( header ) + size );
+}
+
+/*
+   ImportModelCached()
+   ImportModel() via -modelcache
+ */
+
+static std::unique_ptr<AssModel> ImportModelCached( const char *name, int frame ){
+	const std::pair key{ ModelNameFrame{ name, frame }, maxSurfaceVerts };
+
+	std::optional<ModelCacheEntry> cached;
+	{
+		const std::lock_guard lock( s_modelCacheLock );
+		LoadModelCache();
+		if ( const auto it = s_modelCache.find( key ); it != s_modelCache.end()
+		  && it->second.flags == c_assImportFlags ) {
+			cached = it->second;
+		}
+	}
+
+	if ( cached ) {
+		const bool unchanged = std::ranges::all_of( cached->files, []( const ModelCacheFile& file ){
+			if ( file.m_missing ) {
+				return vfsGetFileCount( file.m_name.c_str() ) == 0;
+			}
+			std::array<byte, 16> checksum;
+			if ( MemBuffer buffer = vfsLoadFile( file.m_name.c_str() ) ) {
+				Com_BlockFullChecksum( buffer.data(), buffer.size(), checksum.data() );
+				return checksum == file.m_checksum;
+			}
+			return false;
+		} );
+		if ( auto model = std::make_unique<AssModel>(); unchanged && ModelCacheReader( cached->model ).get( *model ) ) {
+			return model;
+		}
+	}
+
+	t_importedFiles.clear();
+	auto model = ImportModel( name, frame );
+	if ( model != nullptr ) {
+		ModelCacheEntry entry{ c_assImportFlags, std::move( t_importedFiles ), ModelCacheSerialize( *model ) };
+		t_importedFiles.clear();
+		const std::lock_guard lock( s_modelCacheLock );
+		s_modelCache.insert_or_assign( key, std::move( entry ) );
+		s_modelCacheDirty = true;
+	}
+	return model;
+}
 
 
 
@@ -302,45 +679,17 @@ static AssModel *LoadModel( const char *name, int frame ){
 	}
 
 	/* try to find existing picoModel */
-	auto it = s_assModels.find( ModelNameFrame{ name, frame } );
-	if( it != s_assModels.end() ){
-		return &it->second;
-	}
-
-	unsigned flags = //aiProcessPreset_TargetRealtime_Fast
-	            //    | aiProcess_FixInfacingNormals
-	                 aiProcess_GenNormals
-	               | aiProcess_JoinIdenticalVertices
-	               | aiProcess_Triangulate
-	               | aiProcess_GenUVCoords
-	               | aiProcess_SortByPType
-	               | aiProcess_FindDegenerates
-	               | aiProcess_FindInvalidData
-	               | aiProcess_ValidateDataStructure
-	               | aiProcess_FlipUVs
-	               | aiProcess_FlipWindingOrder
-	               | aiProcess_PreTransformVertices
-	               | aiProcess_RemoveComponent
-	               | aiProcess_SplitLargeMeshes;
-	// rotate the whole scene 90 degrees around the x axis to convert assimp's Y = UP to Quakes's Z = UP
-	s_assImporter->SetPropertyMatrix( AI_CONFIG_PP_PTV_ROOT_TRANSFORMATION, aiMatrix4x4( 1, 0, 0, 0,
-	                                                                                     0, 0, -1, 0,
-	                                                                                     0, 1, 0, 0,
-	                                                                                     0, 0, 0, 1 ) ); // aiMatrix4x4::RotationX( c_half_pi )
-
-	s_assImporter->SetPropertyInteger( AI_CONFIG_PP_SLM_VERTEX_LIMIT, maxSurfaceVerts ); // TODO this optimal and with respect to lightmapped/not
-	s_assImporter->SetPropertyInteger( AI_CONFIG_IMPORT_GLOBAL_KEYFRAME, frame );
-
-	const aiScene *scene = s_assImporter->ReadFile( name, flags );
-
-	if( scene != nullptr ){
-		if( scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE )
-			Sys_Warning( "AI_SCENE_FLAGS_INCOMPLETE\n" );
-		return &s_assModels.emplace( ModelNameFrame{ name, frame }, AssModel( s_assImporter->GetOrphanedScene(), name ) ).first->second;
-	}
-	else{
-		return nullptr; // TODO /* if loading failed, make a bogus model to silence the rest of the warnings */
+	{
+		const std::lock_guard lock( s_assModelsLock );
+		if( const auto it = s_assModels.find( ModelNameFrame{ name, frame } ); it != s_assModels.end() ){
+			return it->second.get();
+		}
 	}
+
+	auto model = modelCache? ImportModelCached( name, frame ) : ImportModel( name, frame );
+
+	const std::lock_guard lock( s_assModelsLock );
+	return s_assModels.try_emplace( ModelNameFrame{ name, frame }, std::move( model ) ).first->second.get();
 }
 
 std::vector<const AssMeshWalker*> LoadModelWalker( const char *name, int frame ){
@@ -1284,7 +1633,6 @@ void InsertModel( const char *name, const char *skin, int frame, const Matrix4&
 	//%	Sys_FPrintf( SYS_VRB, "Model %s has %d surfaces\n", name, numSurfaces );
 	for ( const auto& surface : model->m_meshes )
 	{
-		const aiMesh *mesh = surface.m_mesh;
 		/* only handle triangle surfaces initially (fixme: support patches) */
 
 		/* get shader name */
@@ -1366,8 +1714,8 @@ void InsertModel( const char *name, const char *skin, int frame, const Matrix4&
 		}
 
 		/* set particulars */
-		ds.verts.resize( mesh->mNumVertices, c_bspDrawVert_t0 );
-		ds.indexes.resize( mesh->mNumFaces * 3 );
+		ds.verts.resize( surface.m_xyz.size(), c_bspDrawVert_t0 );
+		ds.indexes.resize( surface.m_indexes.size() );
 // Sys_Printf( "verts %zu idx %zu\n", ds.verts.size(), ds.indexes.size() );
 		/* copy vertexes */
 		for ( size_t i = 0; i < ds.verts.size(); ++i )
@@ -1376,11 +1724,11 @@ void InsertModel( const char *name, const char *skin, int frame, const Matrix4&
 			bspDrawVert_t& dv = ds.verts[ i ];
 
 			/* xyz and normal */
-			dv.xyz = { mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z };
+			dv.xyz = surface.m_xyz[i];
 			matrix4_transform_point( transform, dv.xyz );
 
-			if( mesh->HasNormals() ){
-				dv.normal = { mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z };
+			if( !surface.m_normals.empty() ){
+				dv.normal = surface.m_normals[i];
 				matrix4_transform_direction( nTransform, dv.normal );
 				VectorNormalize( dv.normal );
 			}
@@ -1400,13 +1748,13 @@ void InsertModel( const char *name, const char *skin, int frame, const Matrix4&
 			/* normal texture coordinates */
 			else
 			{
-				if( mesh->HasTextureCoords( 0 ) )
-					dv.st = { mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y };
+				if( !surface.m_st.empty() )
+					dv.st = surface.m_st[i];
 			}
 
 			/* set lightmap/color bits */
 			{
-				const aiColor4D color = mesh->HasVertexColors( 0 )? mesh->mColors[0][i] : aiColor4D( 1 );
+				const Vector4 color = !surface.m_colors.empty()? surface.m_colors[i] : Vector4( 1 );
 				if ( spawnFlags & eColorToAlpha ) { // spawnflag 32: model color -> alpha hack
 					dv.color[ 0 ] = { 255, 255, 255, color_to_byte( RGBTOGRAY( color ) * 255 ) };
 				}
@@ -1422,13 +1770,12 @@ void InsertModel( const char *name, const char *skin, int frame, const Matrix4&
 		}
 
 		/* copy indexes */
-		for ( size_t idCopied = 0; const aiFace& face : Span( mesh->mFaces, mesh->mNumFaces ) ){
-			// if( face.mNumIndices == 3 )
-			for ( size_t i = 0; i < 3; ++i ){
-				ds.indexes[idCopied++] = face.mIndices[i];
-			}
+		for ( size_t i = 0; i < ds.indexes.size(); i += 3 ){
+			ds.indexes[i] = surface.m_indexes[i];
+			ds.indexes[i + 1] = surface.m_indexes[i + 1];
+			ds.indexes[i + 2] = surface.m_indexes[i + 2];
 			if( transform_lefthanded ){
-				std::swap( ds.indexes[idCopied - 1], ds.indexes[idCopied - 2] );
+				std::swap( ds.indexes[i + 1], ds.indexes[i + 2] );
 			}
 		}
 
@@ -1436,12 +1783,11 @@ void InsertModel( const char *name, const char *skin, int frame, const Matrix4&
 			auto& triangles = clipTriangles.triangleSets[ std::tuple{ ds.shaderInfo->surfaceFlags,
 			                                                          ds.shaderInfo->contentFlags,
 			                                                          ds.shaderInfo->compileFlags } ];
-			for ( const aiFace& face : Span( mesh->mFaces, mesh->mNumFaces ) )
+			for ( size_t f = 0; f < surface.m_indexes.size(); f += 3 )
 			{
 				winding_accu_t points( 3 );
 				for( size_t i = 0; i < 3; ++i ){
-					auto& v = mesh->mVertices[face.mIndices[i]];
-					points[i] = matrix4_transformed_point( transform, DoubleVector3( v.x, v.y, v.z ) );
+					points[i] = matrix4_transformed_point( transform, DoubleVector3( surface.m_xyz[surface.m_indexes[f + i]] ) );
 				}
 				if( transform_lefthanded ){
 					std::swap( points[1], points[2] );
@@ -1480,6 +1826,36 @@ Matrix4 ModelGetTransform( const entity_t& e, const Vector3& parent_origin /* =
 }
 
 
+/*
+   PrefetchModels()
+   loads the models of all misc_model entities in threads ahead of AddTriangleModels()
+ */
+
+static std::vector<ModelNameFrame> prefetchModels;
+
+static void PrefetchModel( int i ){
+	LoadModel( prefetchModels[ i ].m_name.c_str(), prefetchModels[ i ].m_frame );
+}
+
+void PrefetchModels(){
+	std::set<ModelNameFrame> models;
+	for ( std::size_t i = 1; i < entities.size(); ++i )
+	{
+		const entity_t& e = entities[ i ];
+		if ( const char *model; e.classname_is( "misc_model" ) && e.read_keyvalue( model, "model" ) ) {
+			models.insert( ModelNameFrame{ model, e.intForKey( "_frame", "frame" ) } );
+		}
+	}
+	prefetchModels.assign( models.begin(), models.end() );
+
+	Sys_FPrintf( SYS_VRB, "--- PrefetchModels ---\n" );
+	ProfileStage stage( "PrefetchModels" );
+	RunThreadsOnIndividualStealing( prefetchModels.size(), false, PrefetchModel );
+	Sys_FPrintf( SYS_VRB, "%9zu models\n", prefetchModels.size() );
+	prefetchModels.clear();
+}
+
+
 /*
    AddTriangleModels()
    adds misc_model surfaces to the bsp
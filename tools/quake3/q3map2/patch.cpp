@@ -220,6 +220,8 @@ void ParsePatch( bool onlyLights, entity_t& mapEnt, int mapPrimitiveNum ){
 		MatchToken( "(" );
 		for ( int i = 0; i < m.height; ++i )
 		{
+			/* lightmap coords and normal are not stored in the map, keep them deterministic */
+			m[ i ][ j ] = c_bspDrawVert_t0;
 			Parse1DMatrix( 5, m[ i ][ j ].xyz.data() );
 
 			/* ydnar: fix colors */
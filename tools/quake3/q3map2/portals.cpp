@@ -441,6 +441,7 @@ static void MakeTreePortals_r( node_t *node ){
    ==================
  */
 void MakeTreePortals( tree_t& tree ){
+	ProfileStage stage( "MakeTreePortals" );
 	Sys_FPrintf( SYS_VRB, "--- MakeTreePortals ---\n" );
 	MakeHeadnodePortals( tree );
 	MakeTreePortals_r( tree.headnode );
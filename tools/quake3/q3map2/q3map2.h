@@ -57,6 +57,7 @@
 #include "polylib.h"
 #include "qimagelib.h"
 #include "qthreads.h"
+#include "profile.h"
 #include "inout.h"
 #include "inout_xml.h"
 #include "vfs.h"
@@ -74,6 +75,7 @@
 #include <cstddef>
 #include <cstdlib>
 #include <cstdint>
+#include <atomic>
 
 #include "maxworld.h"
 #include "games.h"
@@ -153,10 +155,12 @@ enum class EBrushType
 #define MAX_SEPERATORS          MAX_POINTS_ON_WINDING
 #define MAX_POINTS_ON_FIXED_WINDING 24  /* ydnar: increased this from 12 at the expense of more memory */
 #define MAX_PORTALS_ON_LEAF     1024
+#define SPHERE_EPSILON          0.1f    /* slack for portal bounding sphere tests, origin and radius are rounded to float */
 
 
 /* light */
 #define MAX_TRACE_TEST_NODES    256
+#define TRACE_PACKET_SIZE       8       /* traces walked together by TraceLines() */
 #define DEFAULT_INHIBIT_RADIUS  1.5f
 
 #define LUXEL_EPSILON           0.125f
@@ -1730,6 +1734,8 @@ void                        assimp_init();
 void                        InsertModel( const char *name, const char *skin, int frame, const Matrix4& transform, const std::list<remap_t> *remaps,
                                          entity_t& entity, int spawnFlags, float clipDepth, const EntityCompileParams& params );
 void                        AddTriangleModels( entity_t& eparent );
+void                        PrefetchModels();
+void                        SaveModelCache();
 
 
 /* surface.c */
@@ -1793,6 +1799,7 @@ int                         VisMain( Args& args );
 /* light.c  */
 float                       PointToPolygonFormFactor( const Vector3& point, const Vector3& normal, const winding_t& w );
 int                         LightContributionToSample( trace_t *trace );
+void                        LightContributionToSamples( trace_t *traces, int numTraces );
 void                        LightingAtSample( trace_t * trace, Array4<byte>& styles, Array4<Vector3>& colors, const Vector3& ambientColor );
 int                         LightMain( Args& args );
 
@@ -1800,6 +1807,7 @@ int                         LightMain( Args& args );
 /* light_trace.c */
 void                        SetupTraceNodes();
 void                        TraceLine( trace_t *trace );
+void                        TraceLines( trace_t *const *traces, int numTraces );
 float                       SetupTrace( trace_t *trace );
 
 
@@ -1814,6 +1822,7 @@ void                        RadCreateDiffuseLights();
 Vector3b                    ColorToBytes( const Vector3& color, float scale = 1, float lmscale = 1 );
 void                        SmoothNormals();
 
+std::vector<int>            RawLightmapsByCost();
 void                        MapRawLightmap( int num );
 
 void                        SetupDirt();
@@ -1887,6 +1896,7 @@ void                        EmitVertexRemapShader( char *from, char *to );
 void                        LoadShaderInfo();
 shaderInfo_t                &ShaderInfoForShader( const char *shader );
 shaderInfo_t                *ShaderInfoForShaderNull( const char *shader );
+void                        PrefetchShaderImages( const std::vector<const char*>& shaderNames );
 
 
 /* bspfile_abstract.c */
@@ -1988,6 +1998,7 @@ inline int g_globalSurfaceFlags;
 inline String64 globalCelShader;
 inline bool keepLights;
 inline bool keepModels;
+inline bool modelCache;                    /* -modelcache */
 
 #if Q3MAP2_EXPERIMENTAL_SNAP_NORMAL_FIX
 // Increasing the normalEpsilon to compensate for new logic in SnapNormal(), where
@@ -2096,6 +2107,12 @@ inline bool noGridLighting;
 
 inline bool noTrace;
 inline bool noSurfaces;
+enum class ETracer
+{
+	Bsp,                        /* axial bsp of trace nodes */
+	Flat                        /* flattened copy of the trace nodes */
+};
+inline ETracer g_tracer = ETracer::Bsp;
 inline bool patchShadows;
 inline bool cpmaHack;
 
@@ -2129,6 +2146,7 @@ inline bool g_oneSky; /* fallback to old behavior: any sky emits total of all su
 inline int approximateTolerance;
 inline bool noCollapse;
 inline int lightmapSearchBlockSize;
+inline bool rectAllocate;
 inline bool exportLightmaps;
 inline bool externalLightmaps;
 inline int lmCustomSizeW = LIGHTMAP_WIDTH;
@@ -2282,6 +2300,7 @@ inline int numLuxelsMapped;
 inline int numLuxelsOccluded;
 inline int numLuxelsIlluminated;
 inline int numVertsIlluminated;
+inline std::atomic<std::int64_t> numProfiledTraces; /* counted with -profile only */
 
 /* lightgrid */
 inline Vector3 gridMins;
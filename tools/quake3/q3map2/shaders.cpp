@@ -728,7 +728,12 @@ shaderInfo_t *ShaderInfoForShaderNull( const char *shaderName ){
 	return &ShaderInfoForShader( shaderName );
 }
 
-shaderInfo_t& ShaderInfoForShader( const char *shaderName ){
+/*
+   ShaderInfoForShaderUnfinished()
+   finds or allocates a shaderinfo for a named shader without loading its images
+ */
+
+static shaderInfo_t& ShaderInfoForShaderUnfinished( const char *shaderName ){
 	/* dummy check */
 	if ( strEmptyOrNull( shaderName ) ) {
 		Sys_Warning( "Null or empty shader name\n" );
@@ -756,12 +761,6 @@ shaderInfo_t& ShaderInfoForShader( const char *shaderName ){
 				continue;
 			}
 
-			/* load image if necessary */
-			if ( !si->finished ) {
-				LoadShaderImages( *si );
-				FinishShader( *si );
-			}
-
 			/* return it */
 			return *si;
 		}
@@ -769,9 +768,17 @@ shaderInfo_t& ShaderInfoForShader( const char *shaderName ){
 	}
 
 	/* allocate a default shader */
-	shaderInfo_t& si = AllocShaderInfo( shader );
-	LoadShaderImages( si );
-	FinishShader( si );
+	return AllocShaderInfo( shader );
+}
+
+shaderInfo_t& ShaderInfoForShader( const char *shaderName ){
+	shaderInfo_t& si = ShaderInfoForShaderUnfinished( shaderName );
+
+	/* load image if necessary */
+	if ( !si.finished ) {
+		LoadShaderImages( si );
+		FinishShader( si );
+	}
 
 	/* return it */
 	return si;
@@ -779,6 +786,40 @@ shaderInfo_t& ShaderInfoForShader( const char *shaderName ){
 
 
 
+/*
+   PrefetchShaderImages()
+   loads images of the named shaders in threads ahead of ShaderInfoForShader()
+ */
+
+static std::vector<shaderInfo_t*> prefetchShaders;
+
+static void PrefetchShaderImage( int i ){
+	LoadShaderImages( *prefetchShaders[ i ] );
+	FinishShader( *prefetchShaders[ i ] );
+}
+
+void PrefetchShaderImages( const std::vector<const char*>& shaderNames ){
+	/* find or allocate the shaderinfos first, that isn't thread safe */
+	for ( const char *name : shaderNames )
+	{
+		if ( strEqual( name, "noshader" ) ) {
+			continue;
+		}
+		shaderInfo_t& si = ShaderInfoForShaderUnfinished( name );
+		if ( !si.finished && std::ranges::find( prefetchShaders, &si ) == prefetchShaders.end() ) {
+			prefetchShaders.push_back( &si );
+		}
+	}
+
+	Sys_FPrintf( SYS_VRB, "--- PrefetchShaderImages ---\n" );
+	ProfileStage stage( "PrefetchShaderImages" );
+	RunThreadsOnIndividualStealing( prefetchShaders.size(), false, PrefetchShaderImage );
+	Sys_FPrintf( SYS_VRB, "%9zu shaders\n", prefetchShaders.size() );
+	prefetchShaders.clear();
+}
+
+
+
 static void Parse1DMatrixAppend( ShaderTextCollector& text, int x, float *m ){
 
 	if ( !text.GetToken( true ) || !strEqual( token, "(" ) ) {
@@ -1376,6 +1376,7 @@ static void CullSides( entity_t& e ){
  */
 
 void ClipSidesIntoTree( entity_t& e, const tree_t& tree ){
+	ProfileStage stage( "ClipSidesIntoTree" );
 	/* ydnar: cull brush sides */
 	CullSides( e );
 
@@ -34,6 +34,9 @@
 #include "qspatial.h"
 #include "timer.h"
 #include <map>
+#include <deque>
+#include <numeric>
+#include <unordered_map>
 
 
 struct metaTriangle_t;
@@ -46,9 +49,71 @@ struct metaVertex_t : public bspDrawVert_t
 	metaVertex_t( const bspDrawVert_t& vert ) : bspDrawVert_t( vert ){}
 };
 
-using MetaVertexGroups = std::multimap
-<float, // spatial_distance( std::list<metaVertex_t>>.front().xyz )
-std::list<metaVertex_t>>; // must be maintained non empty
+/* groups of metaverts with equal .xyz position, hashed to a grid of cells for welding */
+class MetaVertexGroups
+{
+public:
+	struct Group
+	{
+		float distance; // spatial_distance( vertices.front().xyz ) on creation, orders matching groups
+		std::list<metaVertex_t> vertices; // must be maintained non empty
+	};
+private:
+	static constexpr float c_cellSize = 4;
+	static constexpr float c_cellOffset = 0.371f; // keeps cell borders off the usual grid, so points rarely probe neighbour cells
+	std::deque<Group> m_groups;
+	std::unordered_map<std::uint64_t, std::vector<int>> m_cells; // cell key -> indices of m_groups
+	static int cell( float value ){
+		return std::floor( ( value + c_cellOffset ) / c_cellSize );
+	}
+	static std::uint64_t cellKey( int x, int y, int z ){ // wraps far away coordinates, collisions only cost a compare
+		return ( std::uint64_t( x & 0x1fffff ) << 42 ) | ( std::uint64_t( y & 0x1fffff ) << 21 ) | std::uint64_t( z & 0x1fffff );
+	}
+public:
+	size_t size() const {
+		return m_groups.size();
+	}
+	auto begin(){
+		return m_groups.begin();
+	}
+	auto end(){
+		return m_groups.end();
+	}
+	void clear(){
+		m_groups.clear();
+		m_cells.clear();
+	}
+	/* returns first group matching the predicate of ones, which may be within c_spatial_EQUAL_EPSILON of point;
+	   ordered by spatial distance, later added first for equal distances */
+	template<typename Functor>
+	Group *find( const Vector3& point, Functor&& matches ){
+		const float distance = spatial_distance( point );
+		Group *best = nullptr;
+		int bestIndex = -1;
+		const float e = c_spatial_EQUAL_EPSILON;
+		const BasicVector3<int> mins( cell( point.x() - e ), cell( point.y() - e ), cell( point.z() - e ) );
+		const BasicVector3<int> maxs( cell( point.x() + e ), cell( point.y() + e ), cell( point.z() + e ) );
+		for ( int x = mins.x(); x <= maxs.x(); ++x )
+			for ( int y = mins.y(); y <= maxs.y(); ++y )
+				for ( int z = mins.z(); z <= maxs.z(); ++z )
+					if ( const auto it = m_cells.find( cellKey( x, y, z ) ); it != m_cells.end() )
+						for ( const int index : it->second )
+						{
+							Group& group = m_groups[index];
+							if ( std::fabs( group.distance - distance ) <= c_spatial_EQUAL_EPSILON
+							  && ( best == nullptr || group.distance < best->distance || ( group.distance == best->distance && index > bestIndex ) )
+							  && matches( group ) ) {
+								best = &group;
+								bestIndex = index;
+							}
+						}
+		return best;
+	}
+	Group& insert( const Vector3& point ){
+		m_cells[cellKey( cell( point.x() ), cell( point.y() ), cell( point.z() ) )].push_back( m_groups.size() );
+		return m_groups.emplace_back( Group{ spatial_distance( point ), {} } );
+	}
+};
 
 /* ydnar: metasurfaces are constructed from lists of metatriangles so they can be merged in the best way */
 struct metaTriangle_t
@@ -62,6 +127,7 @@ struct metaTriangle_t
 	Vector3 lightmapAxis;
 	std::array<metaVertex_t*, 3> m_vertices;
 	MinMax1D minmax;
+	int mergeGroup; // index of MetaMergeGroup, set by MergeMetaTriangles()
 };
 
 
@@ -102,26 +168,25 @@ inline bool bspDrawVert_equal( const bspDrawVert_t& a, const bspDrawVert_t& b ){
 
 static metaVertex_t* metaVertex_findOrInsert( const bspDrawVert_t& src ){
 	/* try to find an existing drawvert */
-	const auto begin = metaVerts.lower_bound( spatial_distance( src.xyz ) - c_spatial_EQUAL_EPSILON );
-	const auto end = metaVerts.upper_bound( spatial_distance( src.xyz ) + c_spatial_EQUAL_EPSILON );
-
-	for( auto it = begin; it != end; ++it ){
-		for( auto& vertex : it->second )
-			if( bspDrawVert_equal( src, vertex ) )
-				return &vertex;
+	const auto equal = [&src]( const metaVertex_t& vertex ){ return bspDrawVert_equal( src, vertex ); };
+	if( auto *group = metaVerts.find( src.xyz, [&equal]( const MetaVertexGroups::Group& group ){
+		return std::ranges::any_of( group.vertices, equal );
+	} ) ){
+		return &*std::ranges::find_if( group->vertices, equal );
 	}
+
 	/* try to put to exisitng group */
-	for( auto it = begin; it != end; ++it ){
-		auto& list = it->second;
-		if( VectorCompare( src.xyz, list.front().xyz ) ){
-			auto& newVertex = list.emplace_back( src );
-			newVertex.m_metaVertexGroup = &list;
-			return &newVertex;
-		}
+	if( auto *group = metaVerts.find( src.xyz, [&src]( const MetaVertexGroups::Group& group ){
+		return VectorCompare( src.xyz, group.vertices.front().xyz );
+	} ) ){
+		auto& list = group->vertices;
+		auto& newVertex = list.emplace_back( src );
+		newVertex.m_metaVertexGroup = &list;
+		return &newVertex;
 	}
 
 	/* add new vertex group */
-	auto& list = metaVerts.emplace_hint( begin, spatial_distance( src.xyz ), decltype( metaVerts )::mapped_type() )->second;
+	auto& list = metaVerts.insert( src.xyz ).vertices;
 	auto& newVertex = list.emplace_back( src );
 	newVertex.m_metaVertexGroup = &list;
 	/* return the vertex */
@@ -784,6 +849,7 @@ void EmitMetaStats(){
  */
 
 void MakeEntityMetaTriangles( const entity_t& e ){
+	ProfileStage stage( "MakeEntityMetaTriangles" );
 	/* note it */
 	Sys_FPrintf( SYS_VRB, "--- MakeEntityMetaTriangles ---\n" );
 
@@ -1079,6 +1145,7 @@ void FixMetaTJunctions(){
 #define EQUAL_NORMAL_EPSILON    0.01f
 
 void SmoothMetaTriangles(){
+	ProfileStage stage( "SmoothMetaTriangles" );
 	Timer timer;
 	int numSmoothed = 0;
 
@@ -1222,7 +1289,7 @@ int>;   // index of bspDrawVert_t in mapDrawSurface_t::verts array
    returns the index of that vert (or < 0 on failure)
  */
 
-static int AddMetaVertToSurface( const mapDrawSurface_t& ds, const bspDrawVert_t& dv1, DrawVerts& verts, const Sorted_indices& sorted_indices, int *coincident ){
+static int AddMetaVertToSurface( const mapDrawSurface_t& ds, const bspDrawVert_t& dv1, DrawVerts& verts, const Sorted_indices& sorted_indices, int *coincident, int *merged ){
 	/* go through the verts and find a suitable candidate */
 	const auto begin = sorted_indices.lower_bound( spatial_distance( dv1.xyz ) - c_spatial_EQUAL_EPSILON );
 	const auto end = sorted_indices.upper_bound( spatial_distance( dv1.xyz ) + c_spatial_EQUAL_EPSILON );
@@ -1250,7 +1317,7 @@ static int AddMetaVertToSurface( const mapDrawSurface_t& ds, const bspDrawVert_t
 		}
 
 		/* found a winner */
-		numMergedVerts++;
+		( *merged )++;
 		return it->second;
 	}
 
@@ -1287,7 +1354,7 @@ static int AddMetaVertToSurface( const mapDrawSurface_t& ds, const bspDrawVert_t
 #define ADEQUATE_SCORE          ( metaAdequateScore >= 0 ? metaAdequateScore : DEFAULT_ADEQUATE_SCORE )
 #define GOOD_SCORE              ( metaGoodScore     >= 0 ? metaGoodScore     : DEFAULT_GOOD_SCORE )
 
-static int AddMetaTriangleToSurface( mapDrawSurface_t& ds, const metaTriangle_t& tri, DrawVerts& verts, DrawIndexes& indexes, MinMax& texMinMax, Sorted_indices& sorted_indices, bool testAdd ){
+static int AddMetaTriangleToSurface( mapDrawSurface_t& ds, const metaTriangle_t& tri, DrawVerts& verts, DrawIndexes& indexes, MinMax& texMinMax, Sorted_indices& sorted_indices, int *merged, bool testAdd ){
 	int score;
 
 
@@ -1325,9 +1392,9 @@ static int AddMetaTriangleToSurface( mapDrawSurface_t& ds, const metaTriangle_t&
 	/* preserve size if this fails */
 	const int numVerts_original = verts.size();
 	int coincident = 0;
-	const int ai = AddMetaVertToSurface( ds, *tri.m_vertices[ 0 ], verts, sorted_indices, &coincident );
-	const int bi = AddMetaVertToSurface( ds, *tri.m_vertices[ 1 ], verts, sorted_indices, &coincident );
-	const int ci = AddMetaVertToSurface( ds, *tri.m_vertices[ 2 ], verts, sorted_indices, &coincident );
+	const int ai = AddMetaVertToSurface( ds, *tri.m_vertices[ 0 ], verts, sorted_indices, &coincident, merged );
+	const int bi = AddMetaVertToSurface( ds, *tri.m_vertices[ 1 ], verts, sorted_indices, &coincident, merged );
+	const int ci = AddMetaVertToSurface( ds, *tri.m_vertices[ 2 ], verts, sorted_indices, &coincident, merged );
 
 	/* check vertex underflow */
 	if ( ai < 0 || bi < 0 || ci < 0 ) {
@@ -1433,21 +1500,34 @@ static int AddMetaTriangleToSurface( mapDrawSurface_t& ds, const metaTriangle_t&
 
 
 
+/* triangles of equal CompareMetaTriangles<false> key; only ever merged with each other, so groups are processed in parallel */
+struct MetaMergeGroup
+{
+	std::vector<metaTriangle_t*> triangles; // in sorted order
+	std::vector<mapDrawSurface_t> surfaces; // merged, in order of seed triangles
+	int mergedVerts = 0;
+};
+
+static std::vector<MetaMergeGroup> metaMergeGroups;
+
+
+
 /*
-   MetaTrianglesToSurface()
-   creates map drawsurface(s) from the list of possibles
+   MergeMetaTriangleGroup()
+   creates drawsurface(s) from the list of possibles in a group of mergeable triangles
  */
 
-static void MetaTrianglesToSurface(){
+static void MergeMetaTriangleGroup( int groupNum ){
+	MetaMergeGroup& group = metaMergeGroups[ groupNum ];
+
 	/* allocate arrays */
 	DrawVerts verts;
 	DrawIndexes indexes;
 
-	Pacifier<SYS_VRB> pacifier( metaTriangles.size() );
-
 	/* walk the list of triangles */
-	for ( auto& seed : metaTriangles )
+	for ( metaTriangle_t *triangle : group.triangles )
 	{
+		metaTriangle_t& seed = *triangle;
 		/* skip this triangle if it has already been merged */
 		if ( seed.si == nullptr ) {
 			continue;
@@ -1457,8 +1537,10 @@ static void MetaTrianglesToSurface(){
 		   initial drawsurf construction
 		   ----------------------------------------------------------------- */
 
-		/* start a new drawsurface */
-		mapDrawSurface_t& ds = AllocDrawSurface( ESurfaceType::Meta, *seed.si );
+		/* start a new drawsurface, gets allocated in MetaTrianglesToSurface() */
+		mapDrawSurface_t& ds = group.surfaces.emplace_back();
+		ds.type              = ESurfaceType::Meta;
+		ds.shaderInfo        = seed.si;
 		ds.entityNum         = seed.entityNum;
 		ds.surfaceNum        = seed.surfaceNum;
 		ds.castShadows       = seed.castShadows;
@@ -1493,8 +1575,8 @@ static void MetaTrianglesToSurface(){
 			for( metaVertex_t *trivert : triangle.m_vertices ){
 				for( metaVertex_t& groupvert : *trivert->m_metaVertexGroup ){
 					for( metaTriangle_t *tri : groupvert.m_triangles ){
-						if( tri->si != nullptr
-						&& CompareMetaTriangles<false>::equal( *tri, triangle )    // note: triangle.si must be still there for comparison
+						if( tri->mergeGroup == triangle.mergeGroup    // note: test group first, other groups are being merged concurrently
+						&& tri->si != nullptr
 						&& std::ranges::find( testCloud, tri ) == testCloud.cend() ){
 							testCloud.push_back( tri );
 						}
@@ -1516,9 +1598,7 @@ static void MetaTrianglesToSurface(){
 		};
 
 		/* add the first triangle */
-		if ( AddMetaTriangleToSurface( ds, seed, verts, indexes, texMinMax, sorted_indices, false ) ) {
-			++pacifier;
-		}
+		AddMetaTriangleToSurface( ds, seed, verts, indexes, texMinMax, sorted_indices, &group.mergedVerts, false );
 		expand_cloud( seed );
 
 		/* -----------------------------------------------------------------
@@ -1542,7 +1622,7 @@ static void MetaTrianglesToSurface(){
 				}
 
 				/* score this triangle */
-				const int score = AddMetaTriangleToSurface( ds, *test, verts, indexes, texMinMax, sorted_indices, true );
+				const int score = AddMetaTriangleToSurface( ds, *test, verts, indexes, texMinMax, sorted_indices, &group.mergedVerts, true );
 				if ( score > bestScore ) {
 					best = test;
 					bestScore = score;
@@ -1557,8 +1637,7 @@ static void MetaTrianglesToSurface(){
 
 			/* add best candidate */
 			if ( best != nullptr && bestScore > ADEQUATE_SCORE ) {
-				if ( AddMetaTriangleToSurface( ds, *best, verts, indexes, texMinMax, sorted_indices, false ) ) {
-					++pacifier;
+				if ( AddMetaTriangleToSurface( ds, *best, verts, indexes, texMinMax, sorted_indices, &group.mergedVerts, false ) ) {
 					expand_cloud( *best );
 				}
 
@@ -1570,18 +1649,61 @@ static void MetaTrianglesToSurface(){
 		/* copy the verts and indexes to the new surface */
 		ds.verts = verts;
 		ds.indexes = indexes;
+	}
+}
 
-		/* classify the surface */
-		ClassifySurface( ds );
-		//% Sys_Warning( "numV: %d numIdx: %d\n", ds.numVerts, ds.numIndexes );
-		/* ClassifySurface() sets axis from vertex normals
-		   method is very questionable and axis actually happens to be wrong after normals passed through SmoothMetaTriangles()
-		   use metaTriangle_t::lightmapAxis which is guaranteedly set and used as main factor for triangles merge */
-		ds.lightmapAxis = seed.lightmapAxis;
 
-		/* add to count */
-		numMergedSurfaces++;
+
+/*
+   MetaTrianglesToSurface()
+   creates map drawsurface(s) from the list of possibles
+ */
+
+static void MetaTrianglesToSurface(){
+	/* split sorted triangles to groups of mergeable ones */
+	metaMergeGroups.clear();
+	const metaTriangle_t *previous = nullptr;
+	for ( metaTriangle_t& tri : metaTriangles )
+	{
+		if ( previous == nullptr || !CompareMetaTriangles<false>::equal( *previous, tri ) ) {
+			metaMergeGroups.emplace_back();
+		}
+		tri.mergeGroup = metaMergeGroups.size() - 1;
+		metaMergeGroups.back().triangles.push_back( &tri );
+		previous = &tri;
+	}
+
+	/* merge largest groups first */
+	std::vector<int> order( metaMergeGroups.size() );
+	std::iota( order.begin(), order.end(), 0 );
+	std::stable_sort( order.begin(), order.end(), []( int a, int b ){
+		return metaMergeGroups[ a ].triangles.size() > metaMergeGroups[ b ].triangles.size();
+	} );
+	RunThreadsOnIndividualStealing( metaMergeGroups.size(), false, MergeMetaTriangleGroup, order.data() );
+
+	/* emit surfaces in the order of the single threaded merge */
+	for ( MetaMergeGroup& group : metaMergeGroups )
+	{
+		for ( mapDrawSurface_t& merged : group.surfaces )
+		{
+			mapDrawSurface_t& ds = AllocDrawSurface( ESurfaceType::Meta, *merged.shaderInfo );
+			ds = std::move( merged );
+
+			/* classify the surface */
+			const Vector3 lightmapAxis = ds.lightmapAxis;
+			ClassifySurface( ds );
+			//% Sys_Warning( "numV: %d numIdx: %d\n", ds.numVerts, ds.numIndexes );
+			/* ClassifySurface() sets axis from vertex normals
+			   method is very questionable and axis actually happens to be wrong after normals passed through SmoothMetaTriangles()
+			   use metaTriangle_t::lightmapAxis which is guaranteedly set and used as main factor for triangles merge */
+			ds.lightmapAxis = lightmapAxis;
+
+			/* add to count */
+			numMergedSurfaces++;
+		}
+		numMergedVerts += group.mergedVerts;
 	}
+	metaMergeGroups.clear();
 }
 
 
@@ -1597,6 +1719,8 @@ void MergeMetaTriangles(){
 		return;
 	}
 
+	ProfileStage stage( "MergeMetaTriangles" );
+
 	/* note it */
 	Sys_FPrintf( SYS_VRB, "--- MergeMetaTriangles ---\n" );
 
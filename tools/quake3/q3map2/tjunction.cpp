@@ -487,6 +487,7 @@ static bool FixBrokenSurface( mapDrawSurface_t& ds ){
  */
 
 void FixTJunctions( const entity_t& ent ){
+	ProfileStage stage( "FixTJunctions" );
 	/* meta mode has its own t-junction code (currently not as good as this code) */
 	//%	if( meta )
 	//%		return;
@@ -32,9 +32,14 @@
 #include "q3map2.h"
 #include "vis.h"
 #include "visflow.h"
+#include "visbits.h"
+#include "miniz.h"
+#include <unordered_map>
 
 vportal_t          *sorted_portals[ MAX_MAP_PORTALS * 2 ];
 
+static char viscachefile[1024];
+
 
 static visPlane_t PlaneFromWinding( const fixedWinding_t *w ){
 	// calc plane
@@ -125,7 +130,7 @@ static int LeafVectorFromPortalVector( byte *portalbits, byte *leafbits ){
 static int clustersizehistogram[MAX_MAP_LEAFS] = {0};
 
 static void ClusterMerge( int leafnum ){
-	byte portalvector[MAX_PORTALS / 8];
+	alignas( 32 ) byte portalvector[MAX_PORTALS / 8];
 	byte uncompressed[MAX_MAP_LEAFS / 8];
 	int numvis, mergedleafnum;
 
@@ -146,8 +151,8 @@ static void ClusterMerge( int leafnum ){
 		if ( p->status != EVStatus::Done ) {
 			Error( "portal not done" );
 		}
-		for ( int j = 0; j < portallongs; ++j )
-			( (long *)portalvector )[j] |= ( (long *)p->portalvis )[j];
+		for ( int j = 0; j < portalwords; ++j )
+			( (uint64_t *)portalvector )[j] |= ( (const uint64_t *)p->portalvis )[j];
 		bit_enable( portalvector, p - portals );
 	}
 
@@ -179,9 +184,10 @@ static void CalcPortalVis(){
 #ifdef MREDEBUG
 	Sys_Printf( "%6d portals out of %d", 0, numportals * 2 );
 	//get rid of the counter
-	RunThreadsOnIndividual( numportals * 2, false, PortalFlow );
+	RunThreadsOnIndividualStealing( numportals * 2, false, PortalFlow );
 #else
-	RunThreadsOnIndividual( numportals * 2, true, PortalFlow );
+	ProfileStage stage( "PortalFlow" );
+	RunThreadsOnIndividualStealing( numportals * 2, true, PortalFlow );
 #endif
 }
 
@@ -195,17 +201,21 @@ static void CalcPassageVis(){
 
 #ifdef MREDEBUG
 	_printf( "%6d portals out of %d", 0, numportals * 2 );
-	RunThreadsOnIndividual( numportals * 2, false, CreatePassages );
+	RunThreadsOnIndividualStealing( numportals * 2, false, CreatePassages );
 	_printf( "\n" );
 	_printf( "%6d portals out of %d", 0, numportals * 2 );
-	RunThreadsOnIndividual( numportals * 2, false, PassageFlow );
+	RunThreadsOnIndividualStealing( numportals * 2, false, PassageFlow );
 	_printf( "\n" );
 #else
 	Sys_Printf( "\n--- CreatePassages (%d) ---\n", numportals * 2 );
-	RunThreadsOnIndividual( numportals * 2, true, CreatePassages );
+	{
+		ProfileStage stage( "CreatePassages" );
+		RunThreadsOnIndividualStealing( numportals * 2, true, CreatePassages );
+	}
 
 	Sys_Printf( "\n--- PassageFlow (%d) ---\n", numportals * 2 );
-	RunThreadsOnIndividual( numportals * 2, true, PassageFlow );
+	ProfileStage stage( "PassageFlow" );
+	RunThreadsOnIndividualStealing( numportals * 2, true, PassageFlow );
 #endif
 }
 
@@ -219,20 +229,301 @@ static void CalcPassagePortalVis(){
 
 #ifdef MREDEBUG
 	Sys_Printf( "%6d portals out of %d", 0, numportals * 2 );
-	RunThreadsOnIndividual( numportals * 2, false, CreatePassages );
+	RunThreadsOnIndividualStealing( numportals * 2, false, CreatePassages );
 	Sys_Printf( "\n" );
 	Sys_Printf( "%6d portals out of %d", 0, numportals * 2 );
-	RunThreadsOnIndividual( numportals * 2, false, PassagePortalFlow );
+	RunThreadsOnIndividualStealing( numportals * 2, false, PassagePortalFlow );
 	Sys_Printf( "\n" );
 #else
 	Sys_Printf( "\n--- CreatePassages (%d) ---\n", numportals * 2 );
-	RunThreadsOnIndividual( numportals * 2, true, CreatePassages );
+	{
+		ProfileStage stage( "CreatePassages" );
+		RunThreadsOnIndividualStealing( numportals * 2, true, CreatePassages );
+	}
 
 	Sys_Printf( "\n--- PassagePortalFlow (%d) ---\n", numportals * 2 );
-	RunThreadsOnIndividual( numportals * 2, true, PassagePortalFlow );
+	ProfileStage stage( "PassagePortalFlow" );
+	RunThreadsOnIndividualStealing( numportals * 2, true, PassagePortalFlow );
 #endif
 }
 
+/*
+   ==============================================================================
+
+   incremental vis cache (-incremental)
+
+   The cache next to the portal file keeps the portalvis of every portal with
+   a key that hashes everything its flow depends on: its winding, the leafs
+   it may flow through, their portals and their mightsee sets. Portals with an
+   unchanged key copy the cached portalvis instead of being flowed again.
+   The portalvis rows are stored row compressed and run length encoded (VisBitRows).
+
+   ==============================================================================
+ */
+
+#define VISCACHE_IDENT      ( ( 'C' << 24 ) + ( 'S' << 16 ) + ( 'I' << 8 ) + 'V' )
+#define VISCACHE_VERSION    2
+
+struct visCacheHeader_t
+{
+	int ident;
+	int version;
+	uint64_t settings;                  /* hash of the options that change the vis result */
+	int numportals;                     /* memory portals, numportals * 2 */
+	int portalbytes;
+	int compressedSize;
+	int uncompressedSize;
+};
+
+static std::vector<uint64_t> portalHashes;      /* [portals] winding hash, identifies the portal between compiles */
+static std::vector<uint64_t> portalKeys;        /* [portals] hash of everything the flow of the portal depends on */
+
+
+static uint64_t VisHashMix( uint64_t h ){
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+static uint64_t VisHashFloat( uint64_t h, float f ){
+	uint32_t bits;
+	memcpy( &bits, &f, sizeof( bits ) );
+	return VisHashMix( h ^ bits );
+}
+
+/* order independent hash of the portals set in a portal bit vector */
+static uint64_t VisHashPortalSet( const byte *bits, const std::vector<uint64_t>& values ){
+	uint64_t h = 0;
+	for ( int word = 0; word < portalwords; ++word )
+	{
+		if ( ( (const uint64_t *)bits )[word] == 0 ) {
+			continue;
+		}
+		for ( int i = word * 64; i < word * 64 + 64 && i < numportals * 2; ++i )
+			if ( bit_is_enabled( bits, i ) ) {
+				h += VisHashMix( values[i] );
+			}
+	}
+	return h;
+}
+
+static uint64_t VisCacheSettings(){
+	uint64_t h = VisHashMix( VISCACHE_VERSION );
+	h = VisHashMix( h ^ ( noPassageVis << 0 | passageVisOnly << 1 | mergevis << 2 | mergevisportals << 3 | hint << 4 | nosort << 5 ) );
+	h = VisHashFloat( h, farPlaneDist );
+	return VisHashMix( h ^ farPlaneDistMode );
+}
+
+/*
+   ==================
+   SetupVisCacheKeys
+
+   runs after BasePortalVis, needs the portalflood sets
+   ==================
+ */
+static void SetupVisCacheKeys(){
+	const visPortalArrays_t& pa = portalArrays;
+	const int count = numportals * 2;
+
+	// the winding identifies a portal between compiles
+	portalHashes.assign( count, 0 );
+	for ( int i = 0; i < count; ++i )
+	{
+		const vportal_t& p = portals[i];
+		if ( p.removed ) {
+			continue;
+		}
+		uint64_t h = VisHashMix( p.hint << 1 | p.sky );
+		h = VisHashFloat( h, p.plane.a );
+		h = VisHashFloat( h, p.plane.b );
+		h = VisHashFloat( h, p.plane.c );
+		h = VisHashFloat( h, p.plane.d );
+		for ( const Vector3& point : Span( p.winding->points, p.winding->numpoints ) )
+			for ( int j = 0; j < 3; ++j )
+				h = VisHashFloat( h, point[j] );
+		portalHashes[i] = h;
+	}
+
+	// the leaf a portal leads into, seen as the portals leaving it
+	std::vector<uint64_t> links( count, 0 );
+	for ( int i = 0; i < count; ++i )
+	{
+		if ( portals[i].removed ) {
+			continue;
+		}
+		uint64_t h = 0;
+		for ( int k = pa.leafFirst[pa.leaf[i]]; k < pa.leafFirst[pa.leaf[i] + 1]; ++k )
+			h += VisHashMix( portalHashes[pa.leafPortals[k]] );
+		links[i] = VisHashMix( portalHashes[i] ^ h );
+	}
+
+	// a portal and its leaf together with its mightsee set
+	std::vector<uint64_t> floods( count, 0 );
+	for ( int i = 0; i < count; ++i )
+		if ( !portals[i].removed ) {
+			floods[i] = VisHashMix( links[i] ^ VisHashPortalSet( portals[i].portalflood, portalHashes ) );
+		}
+
+	// the flow of a portal only passes through its mightsee set
+	portalKeys.assign( count, 0 );
+	for ( int i = 0; i < count; ++i )
+		if ( !portals[i].removed ) {
+			portalKeys[i] = VisHashMix( floods[i] ^ VisHashPortalSet( portals[i].portalflood, floods ) );
+		}
+}
+
+/*
+   ==================
+   LoadVisCache
+
+   copies the cached portalvis of all portals with an unchanged key
+   and marks the portals the remaining flows need passages for
+   ==================
+ */
+static void LoadVisCache(){
+	if ( !FileExists( viscachefile ) ) {
+		Sys_Printf( "No vis cache %s\n", viscachefile );
+		return;
+	}
+
+	Sys_Printf( "Loading %s\n", viscachefile );
+	MemBuffer file = LoadFile( viscachefile );
+	visCacheHeader_t header;
+	if ( file.size() < sizeof( header ) ) {
+		Sys_Warning( "Vis cache is truncated, ignoring it\n" );
+		return;
+	}
+	memcpy( &header, file.data(), sizeof( header ) );
+	if ( header.ident != VISCACHE_IDENT || header.version != VISCACHE_VERSION
+	  || file.size() != sizeof( header ) + header.compressedSize ) {
+		Sys_Warning( "Vis cache is invalid, ignoring it\n" );
+		return;
+	}
+	if ( header.settings != VisCacheSettings() ) {
+		Sys_Printf( "Vis options changed, ignoring vis cache\n" );
+		return;
+	}
+
+	// bound the sizes before allocating: hashes and keys, then rows of at most rowWords literal words,
+	// each with its varint first word, word count, zero run and literal count; deflate expands at most 1032:1
+	const int oldCount = header.numportals;
+	const int64_t rowWords = ( int64_t( oldCount ) + 63 ) / 64;
+	const int64_t keysSize = int64_t( oldCount ) * 2 * sizeof( uint64_t );
+	const int64_t maxSize = keysSize + 10 + oldCount * ( 10 + rowWords * ( 10 + sizeof( uint64_t ) ) );
+	if ( oldCount < 0 || header.portalbytes != rowWords * 8 || header.compressedSize < 0
+	  || header.uncompressedSize < keysSize || header.uncompressedSize > maxSize
+	  || header.uncompressedSize > int64_t( header.compressedSize ) * 1032 ) {
+		Sys_Warning( "Vis cache is invalid, ignoring it\n" );
+		return;
+	}
+
+	std::vector<byte> data( header.uncompressedSize );
+	mz_ulong size = data.size();
+	VisBitRows oldVis;
+	if ( mz_uncompress( data.data(), &size, (const byte *)file.data() + sizeof( header ), header.compressedSize ) != MZ_OK
+	  || size != data.size() ) {
+		Sys_Warning( "Vis cache is invalid, ignoring it\n" );
+		return;
+	}
+	const byte *rows = data.data() + keysSize;
+	if ( !oldVis.read( rows, data.data() + data.size(), rowWords )
+	  || rows != data.data() + data.size() || oldVis.numRows() != oldCount ) {
+		Sys_Warning( "Vis cache is invalid, ignoring it\n" );
+		return;
+	}
+	const uint64_t *oldHashes = (const uint64_t *)data.data();
+	const uint64_t *oldKeys = oldHashes + oldCount;
+
+	// match portals by winding, -1 for ambiguous ones
+	const int count = numportals * 2;
+	std::unordered_map<uint64_t, int> portalForHash;
+	for ( int i = 0; i < count; ++i )
+	{
+		if ( portals[i].removed ) {
+			continue;
+		}
+		if ( const auto [it, inserted] = portalForHash.emplace( portalHashes[i], i ); !inserted ) {
+			it->second = -1;
+		}
+	}
+	std::vector<int> remap( oldCount, -1 );
+	for ( int i = 0; i < oldCount; ++i )
+		if ( const auto it = portalForHash.find( oldHashes[i] ); it != portalForHash.end() ) {
+			remap[i] = it->second;
+		}
+
+	int reused = 0;
+	std::vector<byte> vis( portalbytes );
+	for ( int i = 0; i < oldCount; ++i )
+	{
+		const int n = remap[i];
+		if ( n < 0 || portalKeys[n] != oldKeys[i] || portals[n].status == EVStatus::Done ) {
+			continue;
+		}
+		std::fill( vis.begin(), vis.end(), 0 );
+		bool valid = true;
+		oldVis.forEachBit( i, [&]( int j ){
+			valid = valid && j < oldCount && remap[j] >= 0;
+			if ( valid ) {
+				bit_enable( vis.data(), remap[j] );
+			}
+		} );
+		if ( valid ) {
+			memcpy( portals[n].portalvis, vis.data(), portalbytes );
+			portals[n].status = EVStatus::Done;
+			reused++;
+		}
+	}
+
+	// remaining flows only chain through their mightsee sets
+	std::vector<byte> needed( portalbytes, 0 );
+	for ( int i = 0; i < count; ++i )
+	{
+		if ( portals[i].removed || portals[i].status == EVStatus::Done ) {
+			continue;
+		}
+		bit_enable( needed.data(), i );
+		for ( int j = 0; j < portalwords; ++j )
+			( (uint64_t *)needed.data() )[j] |= ( (const uint64_t *)portals[i].portalflood )[j];
+	}
+	for ( int i = 0; i < count; ++i )
+		portals[i].skipPassages = !bit_is_enabled( needed.data(), i );
+
+	Sys_Printf( "%9d of %d portals reused from vis cache\n", reused, count );
+}
+
+/*
+   ==================
+   SaveVisCache
+   ==================
+ */
+static void SaveVisCache(){
+	const int count = numportals * 2;
+	VisBitRows vis;
+	for ( const vportal_t& p : Span( portals, count ) )
+		vis.addRow( p.removed ? nullptr : p.portalvis, p.removed ? 0 : portalbytes );
+
+	std::vector<byte> data( count * 2 * sizeof( uint64_t ) );
+	memcpy( data.data(), portalHashes.data(), count * sizeof( uint64_t ) );
+	memcpy( data.data() + count * sizeof( uint64_t ), portalKeys.data(), count * sizeof( uint64_t ) );
+	vis.write( data );
+
+	mz_ulong size = mz_compressBound( data.size() );
+	std::vector<byte> buffer( sizeof( visCacheHeader_t ) + size );
+	if ( mz_compress2( buffer.data() + sizeof( visCacheHeader_t ), &size, data.data(), data.size(), MZ_BEST_SPEED ) != MZ_OK ) {
+		Sys_Warning( "Failed to compress vis cache\n" );
+		return;
+	}
+	const visCacheHeader_t header{ VISCACHE_IDENT, VISCACHE_VERSION, VisCacheSettings(), count, portalbytes, int( size ), int( data.size() ) };
+	memcpy( buffer.data(), &header, sizeof( header ) );
+
+	Sys_Printf( "Writing %s\n", viscachefile );
+	SaveFile( viscachefile, buffer.data(), sizeof( header ) + size );
+}
+
 /*
    ==================
    CalcFastVis
@@ -275,11 +566,21 @@ static void CalcVis(){
 		}
 	}
 
+	SetupPortalArrays();
+
 	Sys_Printf( "\n--- BasePortalVis (%d) ---\n", numportals * 2 );
-	RunThreadsOnIndividual( numportals * 2, true, BasePortalVis );
+	{
+		ProfileStage stage( "BasePortalVis" );
+		RunThreadsOnIndividualStealing( numportals * 2, true, BasePortalVis );
+	}
 
 //	RunThreadsOnIndividual( numportals * 2, true, BetterPortalVis );
 
+	if ( incrementalVis && !fastvis ) {
+		SetupVisCacheKeys();
+		LoadVisCache();
+	}
+
 	SortPortals();
 
 	if ( fastvis ) {
@@ -294,12 +595,19 @@ static void CalcVis(){
 	else {
 		CalcPassagePortalVis();
 	}
+
+	if ( incrementalVis && !fastvis ) {
+		SaveVisCache();
+	}
 	//
 	// assemble the leaf vis lists by oring and compressing the portal lists
 	//
 	Sys_Printf( "creating leaf vis...\n" );
-	for ( i = 0; i < portalclusters; ++i )
-		ClusterMerge( i );
+	{
+		ProfileStage stage( "ClusterMerge" );
+		for ( i = 0; i < portalclusters; ++i )
+			ClusterMerge( i );
+	}
 
 	totalvis = 0;
 	totalvis2 = 0;
@@ -718,7 +1026,7 @@ static void LoadPortals( char *name ){
 	leafbytes = ( ( portalclusters + 63 ) & ~63 ) >> 3;
 
 	portalbytes = ( ( numportals * 2 + 63 ) & ~63 ) >> 3;
-	portallongs = portalbytes / sizeof( long );
+	portalwords = portalbytes / sizeof( uint64_t );
 
 	// each file portal is split into two memory portals
 	portals = safe_calloc( 2 * numportals * sizeof( vportal_t ) );
@@ -898,6 +1206,10 @@ int VisMain( Args& args ){
 			Sys_Printf( "nosort = true\n" );
 			nosort = true;
 		}
+		while ( args.takeArg( "-incremental" ) ) {
+			Sys_Printf( "incremental = true\n" );
+			incrementalVis = true;
+		}
 		while ( args.takeArg( "-saveprt" ) ) {
 			Sys_Printf( "saveprt = true\n" );
 			saveprt = true;
@@ -932,6 +1244,9 @@ int VisMain( Args& args ){
 	Sys_Printf( "Loading %s\n", portalfile );
 	LoadPortals( portalfile );
 
+	strcpy( viscachefile, portalfile );
+	path_set_extension( viscachefile, ".viscache" );
+
 	/* ydnar: exit if no portals, hence no vis */
 	if ( numportals == 0 ) {
 		Sys_Printf( "No portals means no vis, exiting.\n" );
@@ -56,6 +56,7 @@ struct vportal_t
 	bool hint;                          /* true if this portal was created from a hint splitter */
 	bool sky;                           /* true if this portal belongs to a sky leaf */
 	bool removed;
+	bool skipPassages;                  /* incremental vis: no portal left to flow can pass through this one */
 	visPlane_t plane;                   /* normal pointing into neighbor */
 	int leaf;                           /* neighbor */
 
@@ -84,7 +85,8 @@ struct leaf_t
 
 struct pstack_t
 {
-	byte mightsee[ MAX_PORTALS / 8 ];
+	alignas( 32 ) byte mightsee[ MAX_PORTALS / 8 ];
+	int mightFirst, mightLast;          /* range of 64 bit words in mightsee that may be nonzero, words outside it are stale */
 	pstack_t            *next;
 	leaf_t              *leaf;
 	vportal_t           *portal;        /* portal exiting */
@@ -119,6 +121,7 @@ inline bool mergevis;
 inline bool mergevisportals;
 inline bool nosort;
 inline bool saveprt;
+inline bool incrementalVis;
 inline bool hint;             /* ydnar */
 
 inline float farPlaneDist;                /* rr2do2, rf, mre, ydnar all contributed to this one... */
@@ -137,7 +140,18 @@ inline leaf_t             *faceleafs;
 
 inline int numfaces;
 
+/* SoA copies of the portal spheres and planes and compact leaf portal lists, see SetupPortalArrays() */
+struct visPortalArrays_t
+{
+	std::vector<float> originX, originY, originZ, radius;
+	std::vector<float> normalX, normalY, normalZ, dist;
+	std::vector<int> leaf;                                  /* [portals] leaf the portal leads into */
+	std::vector<int> leafFirst;                             /* [portalclusters + 1] start of each leaf in leafPortals */
+	std::vector<int> leafPortals;                           /* not removed portals of each leaf */
+};
+inline visPortalArrays_t portalArrays;
+
 inline int leafbytes;
-inline int portalbytes, portallongs;
+inline int portalbytes, portalwords;       /* portal bit vectors are padded to whole 64 bit words */
 
 extern vportal_t          *sorted_portals[ MAX_MAP_PORTALS * 2 ];
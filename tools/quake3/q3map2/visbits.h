@@ -0,0 +1,213 @@
+/*
+   This file is part of GtkRadiant.
+
+   GtkRadiant is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   GtkRadiant is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GtkRadiant; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <bit>
+#include "bytebool.h"
+
+
+/*
+   sparse set of bits (e.g. the clusters of a surface),
+   kept as sorted nonzero 64 bit words, tested against
+   dense little endian bit vectors like the bsp pvs
+ */
+class VisBitSet
+{
+	std::vector<std::pair<int, uint64_t>> m_words;
+public:
+	/* sets the bits, negative ones are ignored */
+	void assign( const int *bits, int count ){
+		m_words.clear();
+		for ( int i = 0; i < count; ++i )
+			if ( bits[i] >= 0 ) {
+				m_words.emplace_back( bits[i] >> 6, uint64_t( 1 ) << ( bits[i] & 63 ) );
+			}
+		std::sort( m_words.begin(), m_words.end() );
+		auto out = m_words.begin();
+		for ( auto in = m_words.begin(); in != m_words.end(); ++in )
+		{
+			if ( out != m_words.begin() && ( out - 1 )->first == in->first ) {
+				( out - 1 )->second |= in->second;
+			}
+			else{
+				*out++ = *in;
+			}
+		}
+		m_words.erase( out, m_words.end() );
+	}
+	bool empty() const {
+		return m_words.empty();
+	}
+	bool test( int bit ) const {
+		const auto it = std::lower_bound( m_words.begin(), m_words.end(), std::pair<int, uint64_t>( bit >> 6, 0 ) );
+		return it != m_words.end() && it->first == bit >> 6 && ( it->second >> ( bit & 63 ) & 1 );
+	}
+	/* true if any bit of the set is enabled in a dense bit vector of numBytes bytes, tested a word at a time */
+	bool anyEnabled( const byte *bits, int numBytes ) const {
+		for ( const auto& [w, mask] : m_words )
+		{
+			if ( w * 8 >= numBytes ) {
+				break;
+			}
+			uint64_t word = 0;
+			memcpy( &word, bits + w * 8, std::min( 8, numBytes - w * 8 ) );
+			if ( word & mask ) {
+				return true;
+			}
+		}
+		return false;
+	}
+};
+
+
+/*
+   row compressed bit matrix, used for the portalvis rows of the vis cache file
+   each row only keeps the 64 bit words from its first to its last nonzero word
+
+   the serialized form run length encodes the zero words inside a row:
+   per row varint first word, varint word count, then pairs of
+   varint zero word run, varint literal word count, literal words
+ */
+class VisBitRows
+{
+	struct Row
+	{
+		int first, last;    /* nonzero word range */
+		size_t offset;      /* into m_words */
+	};
+	std::vector<Row> m_rows;
+	std::vector<uint64_t> m_words;
+
+	static void writeVarint( std::vector<byte>& out, uint64_t value ){
+		while ( value >= 0x80 ) {
+			out.push_back( byte( value | 0x80 ) );
+			value >>= 7;
+		}
+		out.push_back( byte( value ) );
+	}
+	static bool readVarint( const byte *& data, const byte *end, uint64_t& value ){
+		value = 0;
+		for ( int shift = 0; data != end && shift < 64; shift += 7 )
+		{
+			const byte b = *data++;
+			value |= uint64_t( b & 0x7f ) << shift;
+			if ( !( b & 0x80 ) ) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+public:
+	void clear(){
+		m_rows.clear();
+		m_words.clear();
+	}
+	int numRows() const {
+		return m_rows.size();
+	}
+
+	/* appends a row from a dense bit vector of numBytes bytes */
+	void addRow( const byte *bits, int numBytes ){
+		const int numWords = ( numBytes + 7 ) / 8;
+		const auto word = [bits, numBytes]( int i ){
+			uint64_t w = 0;
+			memcpy( &w, bits + i * 8, std::min( 8, numBytes - i * 8 ) );
+			return w;
+		};
+		Row row{ 0, 0, m_words.size() };
+		while ( row.first < numWords && word( row.first ) == 0 )
+			++row.first;
+		row.last = numWords;
+		while ( row.last > row.first && word( row.last - 1 ) == 0 )
+			--row.last;
+		if ( row.first == row.last ) {
+			row.first = row.last = 0;
+		}
+		for ( int i = row.first; i < row.last; ++i )
+			m_words.push_back( word( i ) );
+		m_rows.push_back( row );
+	}
+
+	template<typename Functor>
+	void forEachBit( int row, Functor&& functor ) const {
+		const Row& r = m_rows[row];
+		for ( int w = r.first; w < r.last; ++w )
+			for ( uint64_t bits = m_words[r.offset + w - r.first]; bits != 0; bits &= bits - 1 )
+				functor( w * 64 + std::countr_zero( bits ) );
+	}
+
+	void write( std::vector<byte>& out ) const {
+		writeVarint( out, m_rows.size() );
+		for ( const Row& r : m_rows )
+		{
+			writeVarint( out, r.first );
+			writeVarint( out, r.last - r.first );
+			const uint64_t *words = m_words.data() + r.offset;
+			for ( int i = 0, n = r.last - r.first; i < n; )
+			{
+				int zeros = 0, literals = 0;
+				while ( i + zeros < n && words[i + zeros] == 0 )
+					++zeros;
+				while ( i + zeros + literals < n && words[i + zeros + literals] != 0 )
+					++literals;
+				writeVarint( out, zeros );
+				writeVarint( out, literals );
+				const size_t size = out.size();
+				out.resize( size + literals * sizeof( uint64_t ) );
+				memcpy( out.data() + size, words + i + zeros, literals * sizeof( uint64_t ) );
+				i += zeros + literals;
+			}
+		}
+	}
+	/* reads rows of at most rowWords words written by write(), advances data, false if malformed */
+	bool read( const byte *& data, const byte *end, int rowWords ){
+		clear();
+		uint64_t numRows, first, count, zeros, literals;
+		if ( !readVarint( data, end, numRows ) || numRows > uint64_t( end - data ) ) {
+			return false;
+		}
+		m_rows.reserve( numRows );
+		for ( uint64_t row = 0; row < numRows; ++row )
+		{
+			if ( !readVarint( data, end, first ) || !readVarint( data, end, count ) || first > uint64_t( rowWords ) || count > uint64_t( rowWords ) - first ) {
+				return false;
+			}
+			m_rows.push_back( Row{ int( first ), int( first + count ), m_words.size() } );
+			for ( uint64_t i = 0; i < count; )
+			{
+				if ( !readVarint( data, end, zeros ) || !readVarint( data, end, literals )
+				  || zeros + literals == 0 || zeros + literals > count - i || literals * sizeof( uint64_t ) > uint64_t( end - data ) ) {
+					return false;
+				}
+				m_words.resize( m_words.size() + zeros, 0 );
+				const size_t size = m_words.size();
+				m_words.resize( size + literals );
+				memcpy( m_words.data() + size, data, literals * sizeof( uint64_t ) );
+				data += literals * sizeof( uint64_t );
+				i += zeros + literals;
+			}
+		}
+		return true;
+	}
+};
@@ -31,6 +31,7 @@
 /* dependencies */
 #include "q3map2.h"
 #include "vis.h"
+#include <bit>
 
 
 
@@ -56,7 +57,14 @@
 
 int CountBits( const byte *bits, int numbits ){
 	int c = 0;
-	for ( int i = 0; i < numbits; ++i )
+	int i = 0;
+	for ( ; i + 64 <= numbits; i += 64 )
+	{
+		uint64_t word;
+		memcpy( &word, bits + ( i >> 3 ), sizeof( word ) );
+		c += std::popcount( word );
+	}
+	for ( ; i < numbits; ++i )
 		if ( bit_is_enabled( bits, i ) ) {
 			c++;
 		}
@@ -65,6 +73,76 @@ int CountBits( const byte *bits, int numbits ){
 }
 
 
+/*
+   ==============
+   MightSee
+
+   portal bit vectors are processed in 64 bit words; a stack's mightsee
+   vector is only valid inside [mightFirst, mightLast), the flow narrows
+   that range as it recurses so deep chains only touch the few words
+   that still have bits set
+   ==============
+ */
+static bool MightSee( const pstack_t *stack, int pnum ){
+	const int word = pnum >> 6;
+	return word >= stack->mightFirst && word < stack->mightLast && bit_is_enabled( stack->mightsee, pnum );
+}
+
+static void MightSeeTrim( pstack_t *stack ){
+	const uint64_t *might = (const uint64_t *)stack->mightsee;
+	while ( stack->mightFirst < stack->mightLast && might[stack->mightFirst] == 0 )
+		++stack->mightFirst;
+	while ( stack->mightLast > stack->mightFirst && might[stack->mightLast - 1] == 0 )
+		--stack->mightLast;
+}
+
+static void MightSeeInit( pstack_t *stack, const byte *portalflood ){
+	memcpy( stack->mightsee, portalflood, portalbytes );
+	stack->mightFirst = 0;
+	stack->mightLast = portalwords;
+	MightSeeTrim( stack );
+}
+
+/*
+   ==============
+   MightSeeFlow
+
+   stack->mightsee = prevstack->mightsee & test [& cansee]
+   returns true if the result has bits that are not in vis yet
+   ==============
+ */
+static bool MightSeeFlow( pstack_t *stack, const pstack_t *prevstack, const byte *test, const byte *cansee, const byte *vis ){
+	uint64_t *might = (uint64_t *)stack->mightsee;
+	const uint64_t *prevmight = (const uint64_t *)prevstack->mightsee;
+	const uint64_t *test64 = (const uint64_t *)test;
+	const uint64_t *vis64 = (const uint64_t *)vis;
+	uint64_t more = 0;
+
+	if ( cansee != nullptr ) {
+		const uint64_t *cansee64 = (const uint64_t *)cansee;
+		for ( int j = prevstack->mightFirst; j < prevstack->mightLast; ++j )
+		{
+			might[j] = prevmight[j] & cansee64[j] & test64[j];
+			more |= might[j] & ~vis64[j];
+		}
+	}
+	else
+	{
+		for ( int j = prevstack->mightFirst; j < prevstack->mightLast; ++j )
+		{
+			might[j] = prevmight[j] & test64[j];
+			more |= might[j] & ~vis64[j];
+		}
+	}
+
+	stack->mightFirst = prevstack->mightFirst;
+	stack->mightLast = prevstack->mightLast;
+	MightSeeTrim( stack );
+
+	return more != 0;
+}
+
+
 static void CheckStack( leaf_t *leaf, threaddata_t *thread ){
 	for ( pstack_t *p = thread->pstack_head.next; p; p = p->next )
 	{
@@ -375,8 +453,7 @@ static void RecursiveLeafFlow( int leafnum, threaddata_t *thread, pstack_t *prev
 	pstack_t stack;
 	visPlane_t backplane;
 	leaf_t      *leaf;
-	int j, n;
-	long        *test, *might, *prevmight, *vis, more;
+	int n;
 
 	thread->c_chains++;
 
@@ -395,9 +472,6 @@ static void RecursiveLeafFlow( int leafnum, threaddata_t *thread, pstack_t *prev
 	stack.numseperators[1] = 0;
 #endif
 
-	might = (long *)stack.mightsee;
-	vis = (long *)thread->base->portalvis;
-
 	// check all portals for flowing into other leafs
 	for ( vportal_t *p : Span( leaf->portals, leaf->numportals ) )
 	{
@@ -425,26 +499,13 @@ static void RecursiveLeafFlow( int leafnum, threaddata_t *thread, pstack_t *prev
 		   }
 		 */
 
-		if ( !bit_is_enabled( prevstack->mightsee, pnum ) ) {
+		if ( !MightSee( prevstack, pnum ) ) {
 			continue;   // can't possibly see it
 		}
 
 		// if the portal can't see anything we haven't already seen, skip it
-		if ( p->status == EVStatus::Done ) {
-			test = (long *)p->portalvis;
-		}
-		else
-		{
-			test = (long *)p->portalflood;
-		}
-
-		more = 0;
-		prevmight = (long *)prevstack->mightsee;
-		for ( j = 0; j < portallongs; ++j )
-		{
-			might[j] = prevmight[j] & test[j];
-			more |= ( might[j] & ~vis[j] );
-		}
+		const byte *test = p->status == EVStatus::Done? p->portalvis : p->portalflood;
+		const bool more = MightSeeFlow( &stack, prevstack, test, nullptr, thread->base->portalvis );
 
 		if ( !more &&
 		     bit_is_enabled( thread->base->portalvis, pnum ) ) { // can't see anything new
@@ -601,6 +662,9 @@ void PortalFlow( int portalnum ){
 		p->status = EVStatus::Done;
 		return;
 	}
+	if ( p->status == EVStatus::Done ) {
+		return;     // copied from the vis cache
+	}
 
 	p->status = EVStatus::Working;
 
@@ -613,7 +677,7 @@ void PortalFlow( int portalnum ){
 	data.pstack_head.source = p->winding;
 	data.pstack_head.portalplane = p->plane;
 	data.pstack_head.depth = 0;
-	memcpy( data.pstack_head.mightsee, p->portalflood, portalbytes );
+	MightSeeInit( &data.pstack_head, p->portalflood );
 
 	RecursiveLeafFlow( p->leaf, &data, &data.pstack_head );
 
@@ -635,8 +699,7 @@ static void RecursivePassageFlow( vportal_t *portal, threaddata_t *thread, pstac
 	vportal_t   *p;
 	leaf_t      *leaf;
 	passage_t   *passage, *nextpassage;
-	int i, j;
-	long        *might, *vis, *prevmight, *cansee, *portalvis, more;
+	int i;
 
 	leaf = &leafs[portal->leaf];
 
@@ -645,8 +708,6 @@ static void RecursivePassageFlow( vportal_t *portal, threaddata_t *thread, pstac
 	stack.next = nullptr;
 	stack.depth = prevstack->depth + 1;
 
-	vis = (long *)thread->base->portalvis;
-
 	passage = portal->passages;
 	nextpassage = passage;
 	// check all portals for flowing into other leafs
@@ -659,34 +720,15 @@ static void RecursivePassageFlow( vportal_t *portal, threaddata_t *thread, pstac
 		nextpassage = passage->next;
 		const int pnum = p - portals;
 
-		if ( !bit_is_enabled( prevstack->mightsee, pnum ) ) {
+		if ( !MightSee( prevstack, pnum ) ) {
 			continue;   // can't possibly see it
 		}
 
 		// mark the portal as visible
 		bit_enable( thread->base->portalvis, pnum );
 
-		prevmight = (long *)prevstack->mightsee;
-		cansee = (long *)passage->cansee;
-		might = (long *)stack.mightsee;
-		memcpy( might, prevmight, portalbytes );
-		if ( p->status == EVStatus::Done ) {
-			portalvis = (long *) p->portalvis;
-		}
-		else{
-			portalvis = (long *) p->portalflood;
-		}
-		more = 0;
-		for ( j = 0; j < portallongs; ++j )
-		{
-			if ( *might ) {
-				*might &= *cansee & *portalvis;
-				more |= ( *might & ~vis[j] );
-			}
-			cansee++;
-			portalvis++;
-			might++;
-		}
+		const byte *portalvis = p->status == EVStatus::Done? p->portalvis : p->portalflood;
+		const bool more = MightSeeFlow( &stack, prevstack, portalvis, passage->cansee, thread->base->portalvis );
 
 		if ( !more ) {
 			// can't see anything new
@@ -720,6 +762,9 @@ void PassageFlow( int portalnum ){
 		p->status = EVStatus::Done;
 		return;
 	}
+	if ( p->status == EVStatus::Done ) {
+		return;     // copied from the vis cache
+	}
 
 	p->status = EVStatus::Working;
 
@@ -732,7 +777,7 @@ void PassageFlow( int portalnum ){
 	data.pstack_head.source = p->winding;
 	data.pstack_head.portalplane = p->plane;
 	data.pstack_head.depth = 0;
-	memcpy( data.pstack_head.mightsee, p->portalflood, portalbytes );
+	MightSeeInit( &data.pstack_head, p->portalflood );
 
 	RecursivePassageFlow( p, &data, &data.pstack_head );
 
@@ -757,8 +802,7 @@ static void RecursivePassagePortalFlow( vportal_t *portal, threaddata_t *thread,
 	leaf_t      *leaf;
 	visPlane_t backplane;
 	passage_t   *passage, *nextpassage;
-	int i, j, n;
-	long        *might, *vis, *prevmight, *cansee, *portalvis, more;
+	int i, n;
 
 //	thread->c_chains++;
 
@@ -777,8 +821,6 @@ static void RecursivePassagePortalFlow( vportal_t *portal, threaddata_t *thread,
 	stack.numseperators[1] = 0;
 #endif
 
-	vis = (long *)thread->base->portalvis;
-
 	passage = portal->passages;
 	nextpassage = passage;
 	// check all portals for flowing into other leafs
@@ -791,30 +833,11 @@ static void RecursivePassagePortalFlow( vportal_t *portal, threaddata_t *thread,
 		nextpassage = passage->next;
 		const int pnum = p - portals;
 
-		if ( !bit_is_enabled( prevstack->mightsee, pnum ) ) {
+		if ( !MightSee( prevstack, pnum ) ) {
 			continue;   // can't possibly see it
 		}
-		prevmight = (long *)prevstack->mightsee;
-		cansee = (long *)passage->cansee;
-		might = (long *)stack.mightsee;
-		memcpy( might, prevmight, portalbytes );
-		if ( p->status == EVStatus::Done ) {
-			portalvis = (long *) p->portalvis;
-		}
-		else{
-			portalvis = (long *) p->portalflood;
-		}
-		more = 0;
-		for ( j = 0; j < portallongs; ++j )
-		{
-			if ( *might ) {
-				*might &= *cansee & *portalvis;
-				more |= ( *might & ~vis[j] );
-			}
-			cansee++;
-			portalvis++;
-			might++;
-		}
+		const byte *portalvis = p->status == EVStatus::Done? p->portalvis : p->portalflood;
+		const bool more = MightSeeFlow( &stack, prevstack, portalvis, passage->cansee, thread->base->portalvis );
 
 		if ( !more && bit_is_enabled( thread->base->portalvis, pnum ) ) { // can't see anything new
 			continue;
@@ -968,6 +991,9 @@ void PassagePortalFlow( int portalnum ){
 		p->status = EVStatus::Done;
 		return;
 	}
+	if ( p->status == EVStatus::Done ) {
+		return;     // copied from the vis cache
+	}
 
 	p->status = EVStatus::Working;
 
@@ -980,7 +1006,7 @@ void PassagePortalFlow( int portalnum ){
 	data.pstack_head.source = p->winding;
 	data.pstack_head.portalplane = p->plane;
 	data.pstack_head.depth = 0;
-	memcpy( data.pstack_head.mightsee, p->portalflood, portalbytes );
+	MightSeeInit( &data.pstack_head, p->portalflood );
 
 	RecursivePassagePortalFlow( p, &data, &data.pstack_head );
 
@@ -1235,6 +1261,9 @@ void CreatePassages( int portalnum ){
 		portal->status = EVStatus::Done;
 		return;
 	}
+	if ( portal->skipPassages ) {
+		return;
+	}
 
 	lastpassage = nullptr;
 	for ( const vportal_t *target : Span( leafs[portal->leaf].portals, leafs[portal->leaf].numportals ) )
@@ -1258,10 +1287,13 @@ void CreatePassages( int portalnum ){
 
 		numsee = 0;
 		//create the passage->cansee
+		const uint64_t *portalflood = (const uint64_t *)portal->portalflood;
+		const uint64_t *targetflood = (const uint64_t *)target->portalflood;
 		for ( j = 0; j < numportals * 2; ++j )
 		{
-			p = &portals[j];
-			if ( p->removed ) {
+			// skip whole words of portals that neither side might see
+			if ( ( j & 63 ) == 0 && ( portalflood[j >> 6] & targetflood[j >> 6] ) == 0 ) {
+				j += 63;
 				continue;
 			}
 			if ( !bit_is_enabled( target->portalflood, j ) ) {
@@ -1270,12 +1302,26 @@ void CreatePassages( int portalnum ){
 			if ( !bit_is_enabled( portal->portalflood, j ) ) {
 				continue;
 			}
+			// removed portals are never flooded, so the portal itself is only touched for its winding
+			p = &portals[j];
+			const Vector3 origin( portalArrays.originX[j], portalArrays.originY[j], portalArrays.originZ[j] );
+			const float radius = portalArrays.radius[j];
+			bool clipped = false;
 			for ( k = 0; k < numseperators; ++k )
 			{
+				const float d = plane3_distance_to_point( seperators[k], origin );
 				//if completely at the back of the separator plane
-				if ( plane3_distance_to_point( seperators[k], p->origin ) < -p->radius + ON_EPSILON ) {
+				if ( d < -radius + ON_EPSILON ) {
 					break;
 				}
+				//if the separator may cut the winding
+				if ( d - radius <= -ON_EPSILON + SPHERE_EPSILON ) {
+					clipped = true;
+				}
+				//if completely at the front of the separator
+				if ( d - radius > ON_EPSILON + SPHERE_EPSILON ) {
+					continue;
+				}
 				w = p->winding;
 				for ( n = 0; n < w->numpoints; ++n )
 				{
@@ -1293,6 +1339,13 @@ void CreatePassages( int portalnum ){
 				continue;
 			}
 
+			// no separator reaches the winding, chopping would leave it untouched
+			if ( !clipped ) {
+				bit_enable( passage->cansee, j );
+				numsee++;
+				continue;
+			}
+
 			/* explitive deleted */
 
 
@@ -1396,19 +1449,73 @@ void PassageMemory(){
 
 
 
+/*
+   ==============
+   SetupPortalArrays
+
+   packs the portal data read by the all pairs loops of BasePortalVis() and
+   CreatePassages() into SoA arrays, and the leaf portal lists walked by
+   SimpleFlood() into one index array; vportal_t and leaf_t are too large
+   to stream through the cache
+   ==============
+ */
+void SetupPortalArrays(){
+	visPortalArrays_t& pa = portalArrays;
+	const int count = numportals * 2;
+
+	pa.originX.resize( count );
+	pa.originY.resize( count );
+	pa.originZ.resize( count );
+	pa.radius.resize( count );
+	pa.normalX.resize( count );
+	pa.normalY.resize( count );
+	pa.normalZ.resize( count );
+	pa.dist.resize( count );
+	pa.leaf.resize( count );
+
+	for ( int i = 0; i < count; ++i )
+	{
+		const vportal_t& p = portals[i];
+		pa.originX[i] = p.origin.x();
+		pa.originY[i] = p.origin.y();
+		pa.originZ[i] = p.origin.z();
+		pa.radius[i] = p.radius;
+		pa.normalX[i] = p.plane.a;
+		pa.normalY[i] = p.plane.b;
+		pa.normalZ[i] = p.plane.c;
+		pa.dist[i] = p.plane.d;
+		pa.leaf[i] = p.leaf;
+	}
+
+	pa.leafFirst.clear();
+	pa.leafPortals.clear();
+	for ( const leaf_t& leaf : Span( leafs, portalclusters ) )
+	{
+		pa.leafFirst.push_back( pa.leafPortals.size() );
+		for ( const vportal_t *p : Span( leaf.portals, leaf.numportals ) )
+			if ( !p->removed )
+				pa.leafPortals.push_back( p - portals );
+	}
+	pa.leafFirst.push_back( pa.leafPortals.size() );
+}
+
 /*
    ==================
    SimpleFlood
 
    ==================
  */
-static void SimpleFlood( vportal_t *srcportal, int leafnum ){
-	for ( const vportal_t *p : Span( leafs[leafnum].portals, leafs[leafnum].numportals ) )
+static void SimpleFlood( vportal_t *srcportal, int leafnum, byte *leafflood ){
+	// the portals leading out of a leaf are all flooded on the first visit, entering it again can't add any
+	if ( bit_is_enabled( leafflood, leafnum ) ) {
+		return;
+	}
+	bit_enable( leafflood, leafnum );
+
+	const visPortalArrays_t& pa = portalArrays;
+	for ( int i = pa.leafFirst[leafnum]; i < pa.leafFirst[leafnum + 1]; ++i )
 	{
-		if ( p->removed ) {
-			continue;
-		}
-		const int pnum = p - portals;
+		const int pnum = pa.leafPortals[i];
 		if ( !bit_is_enabled( srcportal->portalfront, pnum ) ) {
 			continue;
 		}
@@ -1419,7 +1526,7 @@ static void SimpleFlood( vportal_t *srcportal, int leafnum ){
 
 		bit_enable( srcportal->portalflood, pnum );
 
-		SimpleFlood( srcportal, p->leaf );
+		SimpleFlood( srcportal, pa.leaf[pnum], leafflood );
 	}
 }
 
@@ -1444,11 +1551,28 @@ void BasePortalVis( int portalnum ){
 	p->portalflood = safe_calloc( portalbytes );
 	p->portalvis = safe_calloc( portalbytes );
 
-	for ( j = 0, tp = portals; j < numportals * 2; ++j, ++tp )
+	// bounding sphere tests settle most pairs without walking the windings,
+	// the sphere distances are taken from the SoA arrays in vectorizable loops
+	const visPortalArrays_t& pa = portalArrays;
+	const int count = numportals * 2;
+	std::vector<float> front( count ), back( count );
+	for ( j = 0; j < count; ++j )
+		front[j] = p->plane.a * pa.originX[j] + p->plane.b * pa.originY[j] + p->plane.c * pa.originZ[j] - p->plane.d;
+	for ( j = 0; j < count; ++j )
+		back[j] = pa.normalX[j] * p->origin.x() + pa.normalY[j] * p->origin.y() + pa.normalZ[j] * p->origin.z() - pa.dist[j];
+
+	for ( j = 0; j < count; ++j )
 	{
 		if ( j == portalnum ) {
 			continue;
 		}
+		if ( front[j] + pa.radius[j] < ON_EPSILON - SPHERE_EPSILON ) {
+			continue;   // no points on front
+		}
+		if ( back[j] - p->radius > -ON_EPSILON + SPHERE_EPSILON ) {
+			continue;   // no points on back
+		}
+		tp = portals + j;
 		if ( tp->removed ) {
 			continue;
 		}
@@ -1484,30 +1608,35 @@ void BasePortalVis( int portalnum ){
 		}
 
 
-		w = tp->winding;
-		for ( k = 0; k < w->numpoints; ++k )
-		{
-			if ( plane3_distance_to_point( p->plane, w->points[k] ) > ON_EPSILON ) {
-				break;
+		if ( front[j] - tp->radius <= ON_EPSILON + SPHERE_EPSILON ) {
+			w = tp->winding;
+			for ( k = 0; k < w->numpoints; ++k )
+			{
+				if ( plane3_distance_to_point( p->plane, w->points[k] ) > ON_EPSILON ) {
+					break;
+				}
 			}
-		}
-		if ( k == w->numpoints ) {
-			continue;   // no points on front
-		}
-		w = p->winding;
-		for ( k = 0; k < w->numpoints; ++k )
-		{
-			if ( plane3_distance_to_point( tp->plane, w->points[k] ) < -ON_EPSILON ) {
-				break;
+			if ( k == w->numpoints ) {
+				continue;   // no points on front
 			}
 		}
-		if ( k == w->numpoints ) {
-			continue;   // no points on front
+		if ( back[j] + p->radius >= -ON_EPSILON - SPHERE_EPSILON ) {
+			w = p->winding;
+			for ( k = 0; k < w->numpoints; ++k )
+			{
+				if ( plane3_distance_to_point( tp->plane, w->points[k] ) < -ON_EPSILON ) {
+					break;
+				}
+			}
+			if ( k == w->numpoints ) {
+				continue;   // no points on back
+			}
 		}
 		bit_enable( p->portalfront, j );
 	}
 
-	SimpleFlood( p, p->leaf );
+	std::vector<byte> leafflood( leafbytes );
+	SimpleFlood( p, p->leaf, leafflood.data() );
 
 	p->nummightsee = CountBits( p->portalflood, numportals * 2 );
 //	Sys_Printf( "portal %i: %i mightsee\n", portalnum, p->nummightsee );
@@ -1536,7 +1665,7 @@ void BasePortalVis( int portalnum ){
    ==================
  */
 static void RecursiveLeafBitFlow( int leafnum, byte *mightsee, byte *cansee ){
-	byte newmight[MAX_PORTALS / 8];
+	alignas( 32 ) byte newmight[MAX_PORTALS / 8];
 
 
 	// check all portals for flowing into other leafs
@@ -1553,12 +1682,12 @@ static void RecursiveLeafBitFlow( int leafnum, byte *mightsee, byte *cansee ){
 		}
 
 		// if this portal can see some portals we mightsee, recurse
-		long more = 0;
-		for ( int i = 0; i < portallongs; ++i )
+		uint64_t more = 0;
+		for ( int i = 0; i < portalwords; ++i )
 		{
-			( (long *)newmight )[i] = ( (long *)mightsee )[i]
-			                          & ( (long *)p->portalflood )[i];
-			more |= ( (long *)newmight )[i] & ~( (long *)cansee )[i];
+			( (uint64_t *)newmight )[i] = ( (const uint64_t *)mightsee )[i]
+			                              & ( (const uint64_t *)p->portalflood )[i];
+			more |= ( (uint64_t *)newmight )[i] & ~( (const uint64_t *)cansee )[i];
 		}
 
 		if ( !more ) {